@@ -48,9 +48,13 @@ struct VkSha256Result {
     uint data[SHA256_WC];
 };
 
+// Gives where an input starts in its batch, and how big it is, and the index of its leaf among
+// those of the batch (i.e. where its hash goes), which differs from that of its metadata if the
+// batch's inputs were sorted (e.g. by size) before being mapped
 struct VkSha256Metadata {
     uint start;
     uint size;
+    uint index;
 };
 
 #endif // _SHA256_DEFS_H_
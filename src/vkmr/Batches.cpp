@@ -25,7 +25,15 @@ namespace vkmr {
 Batch::Batch(Batch&& batch):
     m_data( ::std::move( batch.m_data ) ),
     m_metadata( ::std::move( batch.m_metadata ) ),
+    m_deviceData( ::std::move( batch.m_deviceData ) ),
+    m_deviceMetadata( ::std::move( batch.m_deviceMetadata ) ),
     m_count( batch.m_count ),
+    m_end( batch.m_end ),
+    m_base( batch.m_base ),
+    m_lanes( batch.m_lanes ),
+    m_bound( batch.m_bound ),
+    m_buckets( ::std::move( batch.m_buckets ) ),
+    m_hashed( batch.m_hashed ),
     m_number( batch.m_number ) {
 
     batch.Reset( );
@@ -38,7 +46,15 @@ Batch& Batch::operator=(Batch&& batch) {
 
         m_data = ::std::move( batch.m_data );
         m_metadata = ::std::move( batch.m_metadata );
+        m_deviceData = ::std::move( batch.m_deviceData );
+        m_deviceMetadata = ::std::move( batch.m_deviceMetadata );
         m_count = batch.m_count;
+        m_end = batch.m_end;
+        m_base = batch.m_base;
+        m_lanes = batch.m_lanes;
+        m_bound = batch.m_bound;
+        m_buckets = ::std::move( batch.m_buckets );
+        m_hashed = batch.m_hashed;
         m_number = batch.m_number;
 
         batch.Reset( );
@@ -48,6 +64,11 @@ Batch& Batch::operator=(Batch&& batch) {
 
 Batch::size_type Batch::Size(void) const {
 
+    // Leaves are all the same size
+    if (m_hashed){
+        return m_count * sizeof( VkSha256Result );
+    }
+
     size_type size = 0;
     for (size_type s = 0; s < m_count; s++){
         VkSha256Metadata metadata;
@@ -61,83 +82,208 @@ Batch::size_type Batch::Size(void) const {
     return size;
 }
 
-bool Batch::Push(const ::std::vector<::std::string>& strings) {
+bool Batch::Push(const char* data, size_t size) {
 
     // Look for an early out
-    if (!(*this)){
+    if (!(*this) || m_hashed){
         return false;
     }
-    if (strings.empty( )){
-        return true;
-    }
 
     // Is there space for the metadata
-    const auto new_metadata_size = (sizeof( VkSha256Metadata ) * (m_count + strings.size( )));
+    const auto new_metadata_size = (sizeof( VkSha256Metadata ) * (m_count + 1U));
     if (new_metadata_size > m_metadata.vkSize){
         // Nope
         return false;
     }
 
-    // Is there space for the strings themselves
-    auto back = this->Back( );
-    uint32_t wc = 0;
-    ::std::for_each( strings.cbegin( ), strings.cend( ), [&wc](const ::std::string& str) {
-        wc += WordCount( str.size( ) );
-    } );
-    if (wc == 0){
-        // Just pretend..
-        return true;
+    // Strings too big to be interleaved have the batch lay them all out back to back instead
+    const auto wc = WordCount( size );
+    if ((m_lanes > 1U) && (wc > m_bound) && !this->Deinterleave( )){
+        return false;
     }
-    const auto new_data_size = sizeof( uint ) * (back.start + WordCount( back.size ) + wc);
+
+    // Is there space for the string itself; strings are laid out in groups (of one, unless
+    // interleaved), each as many words long for each string as the longest string in it
+    const auto lane = static_cast<uint32_t>( m_count % m_lanes );
+    const auto base = (lane == 0U) ? m_end : m_base;
+    const auto end = ::std::max( m_end, base + (m_lanes * wc) );
+    const auto new_data_size = sizeof( uint ) * end;
     if (new_data_size > m_data.vkSize){
         // Nope
         return false;
     }
 
-    // If we get here, then we're good to go
-    ::std::for_each( strings.cbegin( ), strings.cend( ), [&](const ::std::string& str) {
-        const auto len = str.size( );
+    // If we get here, then we're good to go; append the metadata
+    VkSha256Metadata back = { 0 };
+    back.start = base + lane;
+    back.size = static_cast<uint>( size );
+    back.index = static_cast<uint>( m_count );
+    memcpy(
+        reinterpret_cast<uint8_t*>( m_metadata.pData ) + (sizeof( VkSha256Metadata ) * m_count),
+        &back,
+        sizeof( VkSha256Metadata )
+    );
 
-        // Append the metadata
-        back.start = (back.start + WordCount( back.size ));
-        back.size = static_cast<uint>( len );
-        memcpy(
-            reinterpret_cast<uint8_t*>( m_metadata.pData ) + (sizeof( VkSha256Metadata ) * m_count),
-            &back,
-            sizeof( VkSha256Metadata )
-        );
+    // Append the string
+    this->Write( back.start, data, size );
 
-        // Append the string
-        memcpy(
-            reinterpret_cast<uint8_t*>( m_data.pData ) + (back.start * sizeof( uint )),
-            str.c_str( ),
-            sizeof( char ) * len
-        );
+    // Update our state and give the caller the happy news
+    m_count += 1;
+    m_end = end;
+    m_base = base;
+    return true;
+}
+
+bool Batch::Push(const VkSha256Result* leaves, size_t count) {
+
+    // Leaves can't be mixed in with inputs
+    if (!(*this) || (!m_hashed && (m_count > 0U))){
+        return false;
+    }
+
+    // Is there space for them
+    const auto offset = (sizeof( VkSha256Result ) * m_count);
+    if ((offset + (sizeof( VkSha256Result ) * count)) > m_data.vkSize){
+        // Nope
+        return false;
+    }
 
-        // Update our state and give the caller the happy news
-        m_count += 1;
-    } );
+    // Append them, back to back, as they will be laid out in the slice
+    ::std::memcpy(
+        reinterpret_cast<uint8_t*>( m_data.pData ) + offset,
+        leaves,
+        sizeof( VkSha256Result ) * count
+    );
+    m_count += count;
+    m_hashed = true;
     return true;
 }
 
 void Batch::Pop(size_t count) {
     m_count -= ::std::min( m_count, count );
+    if (m_count == 0U){
+        m_hashed = false;
+    }
+
+    // Find the (new) end of the last input, or rather of the group it's interleaved into
+    const auto back = this->Back( );
+    const auto lane = (m_count > 0U) ? static_cast<uint32_t>( (m_count - 1U) % m_lanes ) : 0U;
+    uint32_t words = 0U;
+    for (auto s = (m_count - ::std::min( m_count, size_t( lane + 1U ) )); s < m_count; s++){
+        VkSha256Metadata metadata;
+        ::std::memcpy(
+            &metadata,
+            static_cast<unsigned char*>( m_metadata.pData ) + (s * sizeof( VkSha256Metadata )),
+            sizeof( VkSha256Metadata )
+        );
+        words = ::std::max( words, WordCount( metadata.size ) );
+    }
+    m_base = back.start - lane;
+    m_end = m_base + (m_lanes * words);
 }
 
-Batch::VkBufferDescriptors Batch::BufferDescriptors(void) const {
+bool Batch::Carry(size_t count, Batch& batch) {
 
-    // Get the last metadata element, if any
-    const auto back = this->Back( );
+    if ((count > m_count) || !batch){
+        return false;
+    }
+
+    const auto first = m_count - count;
+    ::std::vector<char> input;
+    if (m_hashed){
+        const auto leaves = reinterpret_cast<const VkSha256Result*>( m_data.pData );
+        if (!batch.Push( leaves + first, count )){
+            return false;
+        }
+    }else{
+        for (auto s = first; s < m_count; s++){
+            VkSha256Metadata metadata;
+            ::std::memcpy(
+                &metadata,
+                static_cast<unsigned char*>( m_metadata.pData ) + (s * sizeof( VkSha256Metadata )),
+                sizeof( VkSha256Metadata )
+            );
+            auto data = static_cast<const char*>( m_data.pData ) + (metadata.start * sizeof( uint ));
+            if (m_lanes > 1U){
+                // Gather it up from across the group first
+                input.resize( metadata.size );
+                this->Read( metadata, input.data( ) );
+                data = input.data( );
+            }
+            if (!batch.Push( data, metadata.size )){
+                batch.Pop( s - first );
+                return false;
+            }
+        }
+    }
+    this->Pop( count );
+    return true;
+}
+
+void Batch::Sort(void) {
+
+    // Look for an early out
+    m_buckets.clear( );
+    if (m_hashed || (m_lanes > 1U) || (m_count == 0U)){
+        return;
+    }
+
+    // Copy the metadata out, and count the inputs in each bucket, by the log2 of their block counts
+    const size_t c_maxBuckets = 32U;
+    ::std::vector<VkSha256Metadata> metadata( m_count );
+    ::std::vector<uint8_t> buckets( m_count );
+    uint32_t counts[c_maxBuckets] = { 0U };
+    for (size_t s = 0U; s < m_count; s++){
+        ::std::memcpy(
+            &metadata[s],
+            static_cast<unsigned char*>( m_metadata.pData ) + (s * sizeof( VkSha256Metadata )),
+            sizeof( VkSha256Metadata )
+        );
+        const auto blocks = BlockCount( metadata[s].size );
+        uint8_t b = 0U;
+        while ((blocks >> (b + 1U)) != 0U){
+            b++;
+        }
+        buckets[s] = b;
+        counts[b]++;
+    }
+
+    // Figure out where each bucket starts
+    uint32_t starts[c_maxBuckets] = { 0U };
+    for (uint32_t b = 0U, start = 0U; b < c_maxBuckets; start += counts[b], b++){
+        starts[b] = start;
+        if (counts[b] > 0U){
+            Bucket bucket = { start, counts[b], (2U << b) - 1U };
+            m_buckets.push_back( bucket );
+        }
+    }
+    if (m_buckets.size( ) < 2U){
+        // They're all in the one bucket already
+        return;
+    }
+
+    // Write the metadata back out, bucket by bucket
+    for (size_t s = 0U; s < m_count; s++){
+        ::std::memcpy(
+            static_cast<unsigned char*>( m_metadata.pData ) + (starts[buckets[s]]++ * sizeof( VkSha256Metadata )),
+            &metadata[s],
+            sizeof( VkSha256Metadata )
+        );
+    }
+}
 
-    // Generate
+Batch::VkBufferDescriptors Batch::BufferDescriptors(void) const {
+
+    // Generate (leaves have no metadata)
+    const auto uploads = this->Uploads( );
     VkDescriptorBufferInfo vkDescriptorBufferInputs = {};
-    vkDescriptorBufferInputs.buffer = m_data.vkBuffer;
+    vkDescriptorBufferInputs.buffer = uploads ? m_deviceData.vkBuffer : m_data.vkBuffer;
     vkDescriptorBufferInputs.offset = 0U;
-    vkDescriptorBufferInputs.range = ((back.start + WordCount( back.size )) * sizeof( uint32_t ));
+    vkDescriptorBufferInputs.range = this->DataSize( );
     VkDescriptorBufferInfo vkDescriptorBufferMetadata = {};
-    vkDescriptorBufferMetadata.buffer = m_metadata.vkBuffer;
+    vkDescriptorBufferMetadata.buffer = uploads ? m_deviceMetadata.vkBuffer : m_metadata.vkBuffer;
     vkDescriptorBufferMetadata.offset = 0U;
-    vkDescriptorBufferMetadata.range = (sizeof( VkSha256Metadata ) * m_count);
+    vkDescriptorBufferMetadata.range = this->MetadataSize( );
 
     // Wrap up and return
     VkBufferDescriptors vkBufferDescriptors = {
@@ -147,24 +293,61 @@ Batch::VkBufferDescriptors Batch::BufferDescriptors(void) const {
     return vkBufferDescriptors;
 }
 
+void Batch::CmdUpload(VkCommandBuffer vkCommandBuffer) const {
+
+    // Copy only as much as the batch holds (if anything)
+    VkBufferCopy vkBufferCopy = {};
+    vkBufferCopy.size = this->DataSize( );
+    if (vkBufferCopy.size > 0U){
+        ::vkCmdCopyBuffer( vkCommandBuffer, m_data.vkBuffer, m_deviceData.vkBuffer, 1, &vkBufferCopy );
+    }
+    vkBufferCopy.size = this->MetadataSize( );
+    if (vkBufferCopy.size > 0U){
+        ::vkCmdCopyBuffer( vkCommandBuffer, m_metadata.vkBuffer, m_deviceMetadata.vkBuffer, 1, &vkBufferCopy );
+    }
+}
+
 Batch::Batch(Batch::number_type number, Buffer&& data, Buffer&& metadata):
     m_data( ::std::move( data ) ),
     m_metadata( ::std::move( metadata ) ),
     m_count( 0U ),
+    m_end( 0U ),
+    m_base( 0U ),
+    m_lanes( 1U ),
+    m_bound( 0U ),
+    m_hashed( false ),
     m_number( number ) {
 }
 
 void Batch::Reset(void) {
     m_count = 0U;
+    m_end = 0U;
+    m_base = 0U;
+    m_lanes = 1U;
+    m_bound = 0U;
+    m_buckets.clear( );
+    m_hashed = false;
     m_number = 0xFFFFFFFF;
 }
 
 void Batch::Release(void) {
     m_data = Buffer( );
     m_metadata = Buffer( );
+    m_deviceData = Buffer( );
+    m_deviceMetadata = Buffer( );
     Reset( );
 }
 
+VkDeviceSize Batch::DataSize(void) const {
+    return m_hashed
+        ? this->Size( )
+        : (m_end * sizeof( uint32_t ));
+}
+
+VkDeviceSize Batch::MetadataSize(void) const {
+    return m_hashed ? 0U : (sizeof( VkSha256Metadata ) * m_count);
+}
+
 VkSha256Metadata Batch::Back(void) const {
 
     VkSha256Metadata back = { 0 };
@@ -179,6 +362,73 @@ VkSha256Metadata Batch::Back(void) const {
     return back;
 }
 
+void Batch::Write(uint32_t start, const char* data, size_t size) {
+
+    auto words = reinterpret_cast<uint32_t*>( m_data.pData ) + start;
+    const auto whole = (size / sizeof( uint32_t ));
+    if (m_lanes == 1U){
+        // Copy the whole words straight in
+        ::std::memcpy( words, data, whole * sizeof( uint32_t ) );
+    }else{
+        // Spread them across every m_lanes'th word, from the string's own lane in the group,
+        // so that the mapping of the strings in the group reads the same word of each of
+        // them from consecutive addresses
+        for (size_t w = 0U; w < whole; ++w){
+            ::std::memcpy( &words[w * m_lanes], data + (w * sizeof( uint32_t )), sizeof( uint32_t ) );
+        }
+    }
+
+    // The batch's memory isn't zeroed again when it's recycled (or laid out again), and the mapping
+    // hashes the whole of the last word, so pad that out with zeroes over whatever was there before
+    const auto tail = (whole * sizeof( uint32_t ));
+    if (tail < size){
+        uint32_t word = 0U;
+        ::std::memcpy( &word, data + tail, size - tail );
+        words[whole * m_lanes] = word;
+    }
+}
+
+void Batch::Read(const VkSha256Metadata& metadata, char* data) const {
+
+    const auto words = static_cast<const uint32_t*>( m_data.pData ) + metadata.start;
+    const size_t size = metadata.size;
+    for (size_t offset = 0U, w = 0U; offset < size; offset += sizeof( uint32_t ), w += m_lanes){
+        ::std::memcpy( data + offset, words + w, ::std::min( sizeof( uint32_t ), size - offset ) );
+    }
+}
+
+bool Batch::Deinterleave(void) {
+
+    // Copy the inputs out of the batch
+    ::std::vector<VkSha256Metadata> metadata( m_count );
+    ::std::vector<char> inputs;
+    for (size_t s = 0U; s < m_count; s++){
+        ::std::memcpy(
+            &metadata[s],
+            static_cast<unsigned char*>( m_metadata.pData ) + (s * sizeof( VkSha256Metadata )),
+            sizeof( VkSha256Metadata )
+        );
+        const auto offset = inputs.size( );
+        inputs.resize( offset + metadata[s].size );
+        this->Read( metadata[s], inputs.data( ) + offset );
+    }
+
+    // Then push them back in, back to back (in which they take up no more space than before), over
+    // the interleaved words; each's last word is padded out again, so none of those are hashed
+    m_count = 0U;
+    m_end = 0U;
+    m_base = 0U;
+    m_lanes = 1U;
+    size_t offset = 0U;
+    for (auto it = metadata.cbegin( ), end = metadata.cend( ); it != end; ++it){
+        if (!this->Push( inputs.data( ) + offset, it->size )){
+            return false;
+        }
+        offset += it->size;
+    }
+    return true;
+}
+
 uint32_t Batch::WordCount(size_t len) {
     const size_t words = len / sizeof( uint32_t );
     return ((len % sizeof( uint32_t )) == 0)
@@ -186,27 +436,40 @@ uint32_t Batch::WordCount(size_t len) {
         : (words + 1);
 }
 
+uint32_t Batch::BlockCount(size_t len) {
+    // The padding takes at least 9 bytes: the leading bit, and the length
+    return static_cast<uint32_t>( ((len + 8U) / SHA256_MESSAGE_BLOCK_BYTE_SIZE) + 1U );
+}
+
 Batch::Buffer::Buffer(Buffer&& buffer) noexcept:
     vkDevice( buffer.vkDevice ),
     vkBuffer( buffer.vkBuffer ),
-    vkDeviceMemory( buffer.vkDeviceMemory ),
+    memory( ::std::move( buffer.memory ) ),
     pData( buffer.pData ),
     vkSize( buffer.vkSize) {
 
     buffer.Reset( );        
 }
 
-Batch::Buffer::Buffer(VkDevice p_vkDevice, VkDeviceMemory p_vkDeviceMemory, VkDeviceSize p_vkSize) noexcept:
+Batch::Buffer::Buffer(VkDevice p_vkDevice, MemoryRange&& p_memory, VkBufferUsageFlags vkBufferUsageFlags, const ::std::vector<uint32_t>& queueFamilies) noexcept:
     vkDevice( p_vkDevice ),
-    vkDeviceMemory( p_vkDeviceMemory ),
-    vkSize( p_vkSize ) {
+    vkBuffer( VK_NULL_HANDLE ),
+    memory( ::std::move( p_memory ) ),
+    vkSize( memory.Size( ) ),
+    pData( nullptr ) {
 
     // Create a buffer
     VkBufferCreateInfo vkBufferCreateInfo = {};
     vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     vkBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    vkBufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    vkBufferCreateInfo.usage = vkBufferUsageFlags;
     vkBufferCreateInfo.size = vkSize;
+    if (queueFamilies.size( ) > 1U){
+        // Shared between the queue families, rather than handed over from one to the other
+        vkBufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        vkBufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>( queueFamilies.size( ) );
+        vkBufferCreateInfo.pQueueFamilyIndices = queueFamilies.data( );
+    }
     VkResult vkResult = ::vkCreateBuffer(
         vkDevice,
         &vkBufferCreateInfo,
@@ -219,21 +482,14 @@ Batch::Buffer::Buffer(VkDevice p_vkDevice, VkDeviceMemory p_vkDeviceMemory, VkDe
     }
 
     // Bind the buffer to the device memory
-    vkResult = ::vkBindBufferMemory( vkDevice, vkBuffer, vkDeviceMemory, 0U );
-    if (vkResult != VK_SUCCESS){
-        Release( );
-        return;
-    }
-    
-    // Map in the memory
-    vkResult = ::vkMapMemory( vkDevice, vkDeviceMemory, 0U, VK_WHOLE_SIZE, 0, &pData );
+    vkResult = ::vkBindBufferMemory( vkDevice, vkBuffer, *memory, memory.Offset( ) );
     if (vkResult != VK_SUCCESS){
         Release( );
         return;
     }
 
-    // Apparently important on Steam Deck..?
-    ::std::memset( pData, 0, vkSize ); 
+    // The memory is kept mapped in (and was zeroed once) by the pool
+    pData = memory.Data( );
 }
 
 Batch::Buffer& Batch::Buffer::operator=(Buffer&& buffer) noexcept {
@@ -243,7 +499,7 @@ Batch::Buffer& Batch::Buffer::operator=(Buffer&& buffer) noexcept {
 
         vkDevice = buffer.vkDevice;
         vkBuffer = buffer.vkBuffer;
-        vkDeviceMemory = buffer.vkDeviceMemory;
+        memory = ::std::move( buffer.memory );
         vkSize = buffer.vkSize;
         pData = buffer.pData;
 
@@ -256,7 +512,7 @@ void Batch::Buffer::Reset(void) {
 
     vkDevice = VK_NULL_HANDLE;
     vkBuffer = VK_NULL_HANDLE;
-    vkDeviceMemory = VK_NULL_HANDLE;
+    memory = MemoryRange( );
     vkSize = 0U;
     pData = nullptr;
 }
@@ -266,19 +522,19 @@ void Batch::Buffer::Release(void) {
     if (vkBuffer != VK_NULL_HANDLE){
         ::vkDestroyBuffer( vkDevice, vkBuffer, c_pAllocator );
     }
-    if (pData){
-        ::vkUnmapMemory( vkDevice, vkDeviceMemory );
-    }
-    if (vkDeviceMemory != VK_NULL_HANDLE){
-        ::vkFreeMemory( vkDevice, vkDeviceMemory, c_pAllocator );
-    }
     Reset( );
 }
 
 Batches::Batches(Batches&& batches) noexcept:
     m_vkDataSize( batches.m_vkDataSize ),
     m_vkMetadataSize( batches.m_vkMetadataSize ),
-    m_count( batches.m_count ) {    
+    m_count( batches.m_count ),
+    m_allocated( batches.m_allocated ),
+    m_cap( batches.m_cap ),
+    m_lanes( batches.m_lanes ),
+    m_bound( batches.m_bound ),
+    m_upload( batches.m_upload ),
+    m_recycled( ::std::move( batches.m_recycled ) ) {
 }
 
 Batches& Batches::operator=(Batches&& batches) noexcept {
@@ -287,6 +543,12 @@ Batches& Batches::operator=(Batches&& batches) noexcept {
         m_vkDataSize = batches.m_vkDataSize;
         m_vkMetadataSize = batches.m_vkMetadataSize;
         m_count = batches.m_count;
+        m_allocated = batches.m_allocated;
+        m_cap = batches.m_cap;
+        m_lanes = batches.m_lanes;
+        m_bound = batches.m_bound;
+        m_upload = batches.m_upload;
+        m_recycled = ::std::move( batches.m_recycled );
     }
     return (*this);
 }
@@ -300,34 +562,39 @@ uint32_t Batches::MaxBatchCount(const ComputeDevice& device) const {
     const auto dataRequirements = device.StorageBufferRequirements( m_vkDataSize );
     const auto metadataRequirements = device.StorageBufferRequirements( m_vkMetadataSize );
 
-    // Get the memory budgets for compatible memory types
-    const auto deviceMemoryBudgets = device.AvailableMemoryTypes(
-        dataRequirements,
-        (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
-    );
+    const auto countFor = [&](VkMemoryPropertyFlags vkMemoryPropertyFlags) -> uint32_t {
+        // Get the memory budgets for compatible memory types
+        const auto deviceMemoryBudgets = device.AvailableMemoryTypes( dataRequirements, vkMemoryPropertyFlags );
 
-    // Reduce down to the max per heap
-    ::std::unordered_map<uint32_t, VkDeviceSize> heaped;
-    for (auto it = deviceMemoryBudgets.cbegin( ), end = deviceMemoryBudgets.cend( ); it != end; it++){
-        const auto& deviceMemoryBudget = *it;
+        // Reduce down to the max per heap
+        ::std::unordered_map<uint32_t, VkDeviceSize> heaped;
+        for (auto it = deviceMemoryBudgets.cbegin( ), end = deviceMemoryBudgets.cend( ); it != end; it++){
+            const auto& deviceMemoryBudget = *it;
 
-        // Look for the heap
-        const auto found = heaped.find( deviceMemoryBudget.heapIndex );
-        if (found == heaped.end( )){
-            heaped.insert( { deviceMemoryBudget.heapIndex, deviceMemoryBudget.vkMemorySize } );
-            continue;
+            // Look for the heap
+            const auto found = heaped.find( deviceMemoryBudget.heapIndex );
+            if (found == heaped.end( )){
+                heaped.insert( { deviceMemoryBudget.heapIndex, deviceMemoryBudget.vkMemorySize } );
+                continue;
+            }
+            found->second = ::std::max( found->second, deviceMemoryBudget.vkMemorySize );
         }
-        found->second = ::std::max( found->second, deviceMemoryBudget.vkMemorySize );
-    }
 
-    // Now iterate the heaps and sum up
-    uint32_t result = 0U;
-    const auto vkSize = dataRequirements.size + metadataRequirements.size;
-    for (auto it = heaped.cbegin( ), end = heaped.cend( ); it != end; ++it){
-        const auto count = static_cast<uint32_t>( it->second / vkSize );
-        result += count;
-    }
-    return result;
+        // Now iterate the heaps and sum up
+        uint32_t result = 0U;
+        const auto vkSize = dataRequirements.size + metadataRequirements.size;
+        for (auto it = heaped.cbegin( ), end = heaped.cend( ); it != end; ++it){
+            const auto count = static_cast<uint32_t>( it->second / vkSize );
+            result += count;
+        }
+        return result;
+    };
+
+    // Uploaded batches need as much again in device-local memory
+    const auto result = countFor( VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+    return m_upload
+        ? ::std::min( result, countFor( VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT ) )
+        : result;
 }
 
 Batch Batches::New(ComputeDevice& device) {
@@ -336,17 +603,42 @@ Batch Batches::New(ComputeDevice& device) {
     if (!(*this)){
         return Batch( );
     }
+
+    // Prefer to reuse a batch which has been handed back
+    if (!m_recycled.empty( )){
+        auto batch = ::std::move( m_recycled.back( ) );
+        m_recycled.pop_back( );
+        batch.m_number = ++m_count;
+        batch.m_lanes = m_lanes;
+        batch.m_bound = m_bound;
+        return batch;
+    }
+    if ((m_cap > 0U) && (m_allocated >= m_cap)){
+        // Wait for one to be handed back
+        return Batch( );
+    }
     
-    const auto allocateBuffer = [&](VkDeviceSize vkSize) -> Batch::Buffer {
+    const auto allocateBuffer = [&](VkDeviceSize vkSize, bool deviceLocal) -> Batch::Buffer {
         // Start with an empty buffer
         Batch::Buffer buffer;
 
+        // Device-local buffers are uploaded into (on the transfer queue) and read by the
+        // mapping (on the compute queue), so are shared between the queue families
+        const auto vkMemoryPropertyFlags = deviceLocal
+            ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            : (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        const auto vkBufferUsageFlags = deviceLocal
+            ? (Batch::c_vkBufferUsageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+            : Batch::c_vkBufferUsageFlags;
+        ::std::vector<uint32_t> queueFamilies;
+        if (deviceLocal && (device.TransferQueueFamily( ) != device.QueueFamily( ))){
+            queueFamilies.push_back( device.QueueFamily( ) );
+            queueFamilies.push_back( device.TransferQueueFamily( ) );
+        }
+
         // Get the (approx) memory requirements and look fro some corresponding memory types
         const VkMemoryRequirements vkMemoryRequirements = device.StorageBufferRequirements( vkSize );
-        const auto deviceMemoryBudgets = device.AvailableMemoryTypes(
-            vkMemoryRequirements,
-            (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
-        );
+        const auto deviceMemoryBudgets = device.AvailableMemoryTypes( vkMemoryRequirements, vkMemoryPropertyFlags );
 
         // Iterate, trying to allocate
         for (auto it = deviceMemoryBudgets.cbegin( ), end = deviceMemoryBudgets.cend( ); it != end; it++){
@@ -357,39 +649,69 @@ Batch Batches::New(ComputeDevice& device) {
             }
 
             // Try and allocate
-            auto vkDeviceMemory = device.Allocate( deviceMemoryBudget, vkSize );
-            if (vkDeviceMemory == VK_NULL_HANDLE){
+            auto memory = device.Allocate( deviceMemoryBudget, vkSize, vkMemoryRequirements.alignment );
+            if (!memory){
                 continue;
             }
 
             // Wrap it up
-            buffer = Batch::Buffer( *device, vkDeviceMemory, vkSize );
+            buffer = Batch::Buffer( *device, ::std::move( memory ), vkBufferUsageFlags, queueFamilies );
             break;
         }
-        if (!buffer){
+        if (!buffer && !deviceLocal){
             // Iterate again, but this time accept a potentially smaller size
             for (auto it = deviceMemoryBudgets.cbegin( ), end = deviceMemoryBudgets.cend( ); it != end; it++){
                 const auto& deviceMemoryBudget = *it;
 
                 // Try and allocate
                 const auto allocationSize = ::std::min( deviceMemoryBudget.vkMemoryBudget, vkSize );
-                auto vkDeviceMemory = device.Allocate( deviceMemoryBudget, allocationSize );
-                if (vkDeviceMemory == VK_NULL_HANDLE){
+                auto memory = device.Allocate( deviceMemoryBudget, allocationSize, vkMemoryRequirements.alignment );
+                if (!memory){
                     continue;
                 }
 
                 // Wrap it up
-                buffer = Batch::Buffer( *device, vkDeviceMemory, allocationSize );
+                buffer = Batch::Buffer( *device, ::std::move( memory ) );
                 break;
             }
         }
         return buffer;
     };
-    return Batch(
+    auto batch = Batch(
         ++m_count, 
-        allocateBuffer( m_vkDataSize ),
-        allocateBuffer( m_vkMetadataSize )
+        allocateBuffer( m_vkDataSize, false ),
+        allocateBuffer( m_vkMetadataSize, false )
     );
+    if (batch){
+        m_allocated++;
+        batch.m_lanes = m_lanes;
+        batch.m_bound = m_bound;
+
+        // The device-local buffers must match the (possibly smaller) host-visible ones; if
+        // they can't be had, then the batch is just read from host memory, as usual
+        if (m_upload){
+            auto deviceData = allocateBuffer( batch.m_data.vkSize, true );
+            auto deviceMetadata = allocateBuffer( batch.m_metadata.vkSize, true );
+            if (deviceData && deviceMetadata){
+                batch.m_deviceData = ::std::move( deviceData );
+                batch.m_deviceMetadata = ::std::move( deviceMetadata );
+            }
+        }
+    }
+    return batch;
+}
+
+void Batches::Recycle(Batch&& batch) {
+
+    if (batch){
+        // Empty it, but keep the memory (there's no need to zero it again)
+        batch.m_count = 0U;
+        batch.m_end = 0U;
+        batch.m_base = 0U;
+        batch.m_buckets.clear( );
+        batch.m_hashed = false;
+        m_recycled.push_back( ::std::move( batch ) );
+    }
 }
 
 } // namespace vkmr
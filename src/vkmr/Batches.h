@@ -12,6 +12,8 @@
 
 // C++ Standard Library Headers
 #include <memory>
+#include <vector>
+#include <algorithm>
 
 // Local Project Headers
 #include "Devices.h"
@@ -42,6 +44,12 @@ public:
     typedef uint32_t number_type;
     typedef size_t size_type;
 
+    // Gives a run of (sorted) inputs in the batch which span about as many message blocks as each
+    // other, i.e. up to the given number but more than half as many
+    struct Bucket {
+        uint32_t start, count, blocks;
+    };
+
     Batch(Batch&&);
     Batch(Batch const&) = delete;
     Batch(void) { Reset( ); }
@@ -69,30 +77,64 @@ public:
     // Returns the batch number
     number_type Number(void) const { return m_number; }
 
-    // Pushes the given strings onto the batch
-    bool Push(const ::std::vector<::std::string>&);
+    // Returns true if the batch holds leaves which are already hashed,
+    // to be copied into a slice as-is, rather than inputs to be mapped
+    bool Hashed(void) const { return m_hashed; }
+
+    // Returns true if the batch is uploaded into device-local memory
+    // before being mapped (i.e. rather than read from host memory)
+    bool Uploads(void) const { return static_cast<bool>( m_deviceData ); }
+
+    // Returns the number of inputs whose words are interleaved with each other, i.e. the
+    // stride (in words) between consecutive words of an input; 1 if laid out back to back
+    uint32_t Lanes(void) const { return m_lanes; }
+
+    // Pushes the given input onto the batch, writing it (and its metadata)
+    // straight into the batch's memory
+    bool Push(const char*, size_t);
+
+    // Pushes the given number of (already hashed) leaves onto the batch
+    bool Push(const VkSha256Result*, size_t);
 
     // Pops the a given number of strings off the back of the batch
     void Pop(size_t);
 
-    // Returns the buffer descriptors
+    // Moves the given number of inputs (or leaves) off the back of
+    // the batch onto the back of the given one
+    bool Carry(size_t, Batch&);
+
+    // Sorts the inputs into buckets by the number of message blocks they span (in powers of 2),
+    // keeping to the order they were pushed in within each; only their metadata is moved, with
+    // the index of each's leaf. This is for once the batch is full, just before it's mapped,
+    // and leaves hashed or interleaved inputs as they are (i.e. in no buckets)
+    void Sort(void);
+
+    // Returns the buckets which the inputs were sorted into, if any
+    const ::std::vector<Bucket>& Buckets(void) const { return m_buckets; }
+
+    // Returns the buffer descriptors, of the device-local buffers if uploaded
     VkBufferDescriptors BufferDescriptors(void) const;
 
+    // Records the commands to upload the batch into its device-local buffers
+    void CmdUpload(VkCommandBuffer) const;
+
 private:
+    static const VkBufferUsageFlags c_vkBufferUsageFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
     struct Buffer {
         VkDevice vkDevice;
         VkBuffer vkBuffer;
-        VkDeviceMemory vkDeviceMemory;
+        MemoryRange memory;
         VkDeviceSize vkSize;
         void* pData;
 
         Buffer(Buffer const&) = delete;
         Buffer(Buffer&&) noexcept;
-        Buffer(VkDevice, VkDeviceMemory, VkDeviceSize) noexcept;
+        Buffer(VkDevice, MemoryRange&&, VkBufferUsageFlags = c_vkBufferUsageFlags, const ::std::vector<uint32_t>& = ::std::vector<uint32_t>( )) noexcept;
         Buffer() noexcept { Reset( ); }
         ~Buffer() noexcept { Release( ); }
 
-        operator bool() const { return (pData != nullptr); }
+        operator bool() const { return (vkBuffer != VK_NULL_HANDLE); }
         Buffer& operator=(Buffer const&) = delete;
         Buffer& operator=(Buffer&&) noexcept;
 
@@ -105,20 +147,54 @@ private:
     void Reset(void);
     void Release(void);
 
+    // Return the sizes, in bytes, of the data and metadata in the batch
+    VkDeviceSize DataSize(void) const;
+    VkDeviceSize MetadataSize(void) const;
+
     // Returns the metadata of the last string in the batch
     VkSha256Metadata Back() const;
 
+    // Writes the given input into the batch from the given offset (in words), a word every
+    // m_lanes words, padding out its last word with zeroes
+    void Write(uint32_t, const char*, size_t);
+
+    // Copies the input with the given metadata out of the batch into the given buffer
+    void Read(const VkSha256Metadata&, char*) const;
+
+    // Lays the inputs in the batch out again back to back, rather than interleaved
+    bool Deinterleave(void);
+
     // Counts the number of 32-bit words
     // needed to hold a string of the given (byte)
     // length
     static uint32_t WordCount(size_t);
 
+    // Counts the number of message blocks which a string of the
+    // given (byte) length spans, once padded out for hashing
+    static uint32_t BlockCount(size_t);
+
     // Buffers to hold the batch data and metadata, respectively
     Buffer m_data, m_metadata;
 
+    // Device-local buffers to upload the data and metadata into, if any
+    Buffer m_deviceData, m_deviceMetadata;
+
     // Gives the number of inputs in the batch
     size_t m_count;
 
+    // Gives the offset (in words) of the end of the last input in the batch
+    uint32_t m_end;
+
+    // Gives the offset (in words) of the start of the last group of interleaved inputs, the
+    // number of inputs in each group, and the size (in words) of those which can be interleaved
+    uint32_t m_base, m_lanes, m_bound;
+
+    // Gives the buckets which the inputs were sorted into, if they were
+    ::std::vector<Bucket> m_buckets;
+
+    // Indicates whether the inputs are leaves
+    bool m_hashed;
+
     // Gives the batch number
     number_type m_number;
 };
@@ -131,7 +207,12 @@ public:
     Batches(VkDeviceSize vkDataSize):
         m_vkDataSize( vkDataSize ),
         m_vkMetadataSize( (vkDataSize / sizeof( VkSha256Result ) ) * sizeof( VkSha256Metadata ) ),
-        m_count( 0U ) { }
+        m_count( 0U ),
+        m_allocated( 0U ),
+        m_cap( 0U ),
+        m_lanes( 1U ),
+        m_bound( 0U ),
+        m_upload( false ) { }
 
     Batches& operator=(Batches&&) noexcept;
     Batches& operator=(Batches const&) = delete;
@@ -143,12 +224,32 @@ public:
     // be concurrently in flight for the given device
     uint32_t MaxBatchCount(const ComputeDevice&) const;
 
-    // Instantiates and returns a new batch
+    // Caps the number of batches which will be allocated (or 0 for no cap)
+    void Cap(uint32_t cap) { m_cap = cap; }
+
+    // Sets whether batches allocated from here on are uploaded into device-local memory
+    void Upload(bool upload) { m_upload = upload; }
+
+    // Has batches handed out from here on interleave the words of each group of the given
+    // number of inputs, so that the mapping reads them coalesced, where the inputs are no
+    // bigger than the given size (in bytes); 1 lane lays them out back to back, as usual
+    void Interleave(uint32_t lanes, uint32_t size) {
+        m_lanes = ::std::max( lanes, 1U );
+        m_bound = static_cast<uint32_t>( (size + sizeof( uint32_t ) - 1U) / sizeof( uint32_t ) );
+    }
+
+    // Instantiates and returns a new batch, reusing one which has been
+    // handed back, if any; returns an empty batch if at the cap
     Batch New(ComputeDevice&);
 
+    // Takes back the given batch, once it is no longer needed, for reuse
+    void Recycle(Batch&&);
+
 private:
     VkDeviceSize m_vkDataSize, m_vkMetadataSize;
-    uint32_t m_count;
+    uint32_t m_count, m_allocated, m_cap, m_lanes, m_bound;
+    bool m_upload;
+    ::std::vector<Batch> m_recycled;
 };
 
 } // namespace vkmr
@@ -9,6 +9,14 @@
 #include <cstring>
 #include <iostream>
 #include <algorithm>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iterator>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
 
 // Local Project Headers
 #include "Debug.h"
@@ -23,9 +31,31 @@
 extern PFN_vkCmdPipelineBarrier2KHR g_pVkCmdPipelineBarrier2KHR;
 extern PFN_vkGetPhysicalDeviceProperties2KHR g_pVkGetPhysicalDeviceProperties2KHR;
 extern PFN_vkGetPhysicalDeviceMemoryProperties2KHR g_pVkGetPhysicalDeviceMemoryProperties2KHR;
+extern PFN_vkWaitSemaphoresKHR g_pVkWaitSemaphoresKHR;
+extern PFN_vkGetSemaphoreCounterValueKHR g_pVkGetSemaphoreCounterValueKHR;
 
 namespace vkmr {
 
+// Functions
+//
+
+// Returns the directory in which to keep the files which persist from one run to the next
+// (i.e. pipeline caches and profiles), in order of preference
+static ::std::string cache_directory(void) {
+
+    for (const char* szName : { "VKMR_CACHE_DIR", "TMPDIR", "TEMP", "TMP" }){
+        const char* szValue = ::std::getenv( szName );
+        if (szValue && (*szValue)){
+            return ::std::string( szValue );
+        }
+    }
+#if defined (_WIN32)
+    return ::std::string( "." );
+#else
+    return ::std::string( "/tmp" );
+#endif // defined (_WIN32)
+}
+
 // Classes
 //
 
@@ -86,7 +116,7 @@ void DescriptorSet::Release(void) {
     Reset( );
 }
 
-CommandBuffer::CommandBuffer(VkDevice vkDevice, VkCommandPool vkCommandPool):
+CommandBuffer::CommandBuffer(VkDevice vkDevice, VkCommandPool vkCommandPool, VkCommandBufferLevel vkCommandBufferLevel):
     m_vkResult( VK_RESULT_MAX_ENUM ),
     m_vkDevice( vkDevice ),
     m_vkCommandPool( vkCommandPool ),
@@ -95,7 +125,7 @@ CommandBuffer::CommandBuffer(VkDevice vkDevice, VkCommandPool vkCommandPool):
     VkCommandBufferAllocateInfo vkCommandBufferAllocateInfo = {};
     vkCommandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     vkCommandBufferAllocateInfo.commandPool = m_vkCommandPool;
-    vkCommandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    vkCommandBufferAllocateInfo.level = vkCommandBufferLevel;
     vkCommandBufferAllocateInfo.commandBufferCount = 1;
     m_vkResult = ::vkAllocateCommandBuffers( m_vkDevice, &vkCommandBufferAllocateInfo, &m_vkCommandBuffer );
 }
@@ -174,8 +204,8 @@ CommandPool& CommandPool::operator=(CommandPool&& commandPool) {
     return (*this);
 }
 
-CommandBuffer CommandPool::AllocateCommandBuffer(void) {
-    return CommandBuffer( m_vkDevice, m_vkCommandPool );
+CommandBuffer CommandPool::AllocateCommandBuffer(VkCommandBufferLevel vkCommandBufferLevel) {
+    return CommandBuffer( m_vkDevice, m_vkCommandPool, vkCommandBufferLevel );
 }
 
 void CommandPool::Reset(void) {
@@ -206,7 +236,8 @@ Pipeline::Pipeline(
     VkDescriptorSetLayout vkDescriptorSetLayout,
     VkPipelineLayout vkPipelineLayout,
     ShaderModule&& shaderModule,
-    const WorkgroupSize* pWorkGroupSize):
+    const WorkgroupSize* pWorkGroupSize,
+    VkPipelineCache vkPipelineCache):
     m_vkDevice( vkDevice ),
     m_vkDescriptorSetLayout( vkDescriptorSetLayout ),
     m_vkPipelineLayout( vkPipelineLayout ),
@@ -271,7 +302,7 @@ Pipeline::Pipeline(
     vkComputePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
     vkComputePipelineCreateInfo.stage = vkPipelineShaderStageCreateInfo;
     vkComputePipelineCreateInfo.layout = m_vkPipelineLayout;
-    VkResult vkResult = ::vkCreateComputePipelines( m_vkDevice, 0, 1, &vkComputePipelineCreateInfo, VK_NULL_HANDLE, &m_vkPipeline );
+    VkResult vkResult = ::vkCreateComputePipelines( m_vkDevice, vkPipelineCache, 1, &vkComputePipelineCreateInfo, VK_NULL_HANDLE, &m_vkPipeline );
     if (vkResult != VK_SUCCESS){
         Release( );
         return;
@@ -405,11 +436,661 @@ void DescriptorPool::Release(void) {
     Reset( );
 }
 
-ComputeDevice::ComputeDevice(VkPhysicalDevice vkPhysicalDevice, uint32_t queueFamily, uint32_t queueCount):
+PipelineCache::PipelineCache(VkDevice vkDevice, VkPhysicalDevice vkPhysicalDevice):
+    m_vkResult( VK_RESULT_MAX_ENUM ),
+    m_vkDevice( vkDevice ),
+    m_vkPipelineCache( VK_NULL_HANDLE ),
+    m_loaded( 0U ) {
+
+    VkPhysicalDeviceProperties vkPhysicalDeviceProperties = {};
+    ::vkGetPhysicalDeviceProperties( vkPhysicalDevice, &vkPhysicalDeviceProperties );
+    m_path = Path( vkPhysicalDeviceProperties );
+
+    // Read in whatever was cached by a previous run, if anything
+    ::std::vector<char> data;
+    ::std::ifstream ifs( m_path, ::std::ios::binary );
+    if (ifs){
+        data.assign( ::std::istreambuf_iterator<char>( ifs ), ::std::istreambuf_iterator<char>( ) );
+        ifs.close( );
+    }
+
+    // Check that it came from this device (and driver); the implementation
+    // should do the same, but is not to be relied on to do so
+    const size_t headerSize = 16U + VK_UUID_SIZE;
+    bool valid = (data.size( ) >= headerSize);
+    if (valid){
+        uint32_t header[4] = {};
+        ::std::memcpy( header, data.data( ), sizeof( header ) );
+        valid = (header[0] >= headerSize) &&
+            (header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+            (header[2] == vkPhysicalDeviceProperties.vendorID) &&
+            (header[3] == vkPhysicalDeviceProperties.deviceID) &&
+            (::std::memcmp( data.data( ) + sizeof( header ), vkPhysicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE ) == 0);
+    }
+    if (valid){
+        m_loaded = data.size( );
+        ::std::cout << "Loaded " << m_loaded << " byte(s) of pipeline cache from " << m_path << ::std::endl;
+    }else if (!data.empty( )){
+        ::std::cerr << "Ignoring stale or foreign pipeline cache at " << m_path << ::std::endl;
+    }
+
+    VkPipelineCacheCreateInfo vkPipelineCacheCreateInfo = {};
+    vkPipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (valid){
+        vkPipelineCacheCreateInfo.initialDataSize = data.size( );
+        vkPipelineCacheCreateInfo.pInitialData = data.data( );
+    }
+    m_vkResult = ::vkCreatePipelineCache( m_vkDevice, &vkPipelineCacheCreateInfo, VK_NULL_HANDLE, &m_vkPipelineCache );
+    if ((m_vkResult != VK_SUCCESS) && valid){
+        // Start over, with an empty cache
+        m_loaded = 0U;
+        vkPipelineCacheCreateInfo.initialDataSize = 0U;
+        vkPipelineCacheCreateInfo.pInitialData = nullptr;
+        m_vkResult = ::vkCreatePipelineCache( m_vkDevice, &vkPipelineCacheCreateInfo, VK_NULL_HANDLE, &m_vkPipelineCache );
+    }
+}
+
+PipelineCache::PipelineCache(PipelineCache&& pipelineCache):
+    m_vkResult( pipelineCache.m_vkResult ),
+    m_vkDevice( pipelineCache.m_vkDevice ),
+    m_vkPipelineCache( pipelineCache.m_vkPipelineCache ),
+    m_path( ::std::move( pipelineCache.m_path ) ),
+    m_loaded( pipelineCache.m_loaded ) {
+
+    pipelineCache.Reset( );
+}
+
+PipelineCache& PipelineCache::operator=(PipelineCache&& pipelineCache) {
+
+    if (this != &pipelineCache){
+        this->Release( );
+
+        m_vkResult = pipelineCache.m_vkResult;
+        m_vkDevice = pipelineCache.m_vkDevice;
+        m_vkPipelineCache = pipelineCache.m_vkPipelineCache;
+        m_path = ::std::move( pipelineCache.m_path );
+        m_loaded = pipelineCache.m_loaded;
+
+        pipelineCache.Reset( );
+    }
+    return (*this);
+}
+
+::std::string PipelineCache::Path(const VkPhysicalDeviceProperties& vkPhysicalDeviceProperties) {
+
+    // Name the file for the device and for the driver's cache UUID,
+    // so that updating the latter leaves the old file behind
+    ::std::ostringstream oss;
+    oss << cache_directory( ) << "/vkmr-" << ::std::hex << ::std::setfill( '0' );
+    oss << ::std::setw( 4 ) << vkPhysicalDeviceProperties.vendorID << "-";
+    oss << ::std::setw( 4 ) << vkPhysicalDeviceProperties.deviceID << "-";
+    for (uint32_t u = 0U; u < VK_UUID_SIZE; ++u){
+        oss << ::std::setw( 2 ) << static_cast<uint32_t>( vkPhysicalDeviceProperties.pipelineCacheUUID[u] );
+    }
+    oss << ".cache";
+    return oss.str( );
+}
+
+void PipelineCache::Reset(void) {
+
+    m_vkResult = VK_RESULT_MAX_ENUM;
+    m_vkDevice = VK_NULL_HANDLE;
+    m_vkPipelineCache = VK_NULL_HANDLE;
+    m_path.clear( );
+    m_loaded = 0U;
+}
+
+void PipelineCache::Release(void) {
+
+    if (m_vkPipelineCache == VK_NULL_HANDLE){
+        Reset( );
+        return;
+    }
+
+    // Write the contents of the cache back out, if they've changed since they were
+    // loaded; via a temporary file, so that concurrent runs can't corrupt it
+    size_t dataSize = 0U;
+    VkResult vkResult = ::vkGetPipelineCacheData( m_vkDevice, m_vkPipelineCache, &dataSize, nullptr );
+    if ((vkResult == VK_SUCCESS) && (dataSize > 0U) && (dataSize != m_loaded)){
+        ::std::vector<char> data( dataSize );
+        vkResult = ::vkGetPipelineCacheData( m_vkDevice, m_vkPipelineCache, &dataSize, data.data( ) );
+        if (vkResult == VK_SUCCESS){
+            ::std::ostringstream oss;
+            oss << m_path << "." << ::std::chrono::steady_clock::now( ).time_since_epoch( ).count( ) << ".tmp";
+            const auto temp = oss.str( );
+
+            ::std::ofstream ofs( temp, ::std::ios::binary | ::std::ios::trunc );
+            ofs.write( data.data( ), dataSize );
+            ofs.close( );
+            if (!ofs){
+                ::std::remove( temp.c_str( ) );
+            }else if (::std::rename( temp.c_str( ), m_path.c_str( ) ) != 0){
+                // Renaming over an existing file fails on some platforms
+                ::std::remove( m_path.c_str( ) );
+                if (::std::rename( temp.c_str( ), m_path.c_str( ) ) != 0){
+                    ::std::remove( temp.c_str( ) );
+                }
+            }
+        }
+    }
+
+    ::vkDestroyPipelineCache( m_vkDevice, m_vkPipelineCache, VK_NULL_HANDLE );
+    Reset( );
+}
+
+bool Tuning::Load(const ::std::string& path) {
+
+    ::std::ifstream ifs( path );
+    if (!ifs){
+        return false;
+    }
+
+    // Read the choices in, one per line (as "<key>=<value>"), skipping any not recognised
+    Tuning tuning;
+    ::std::string line;
+    while (::std::getline( ifs, line )){
+        const auto equals = line.find( '=' );
+        if (equals == ::std::string::npos){
+            continue;
+        }
+        const auto key = line.substr( 0, equals ), value = line.substr( equals + 1U );
+        if (key == "mapping.workgroupSize"){
+            tuning.mappingWorkgroupSize = static_cast<uint32_t>( ::std::strtoul( value.c_str( ), nullptr, 10 ) );
+        }else if (key == "mapping.fused"){
+            tuning.fusedMapping = (value != "0");
+        }else if (key == "mapping.lanes"){
+            tuning.mappingLanes = static_cast<uint32_t>( ::std::strtoul( value.c_str( ), nullptr, 10 ) );
+        }else if (key == "reduction"){
+            if (value == "basic"){
+                tuning.reduction = ReductionBasic;
+            }else if (value == "subgroups"){
+                tuning.reduction = ReductionSubgroups;
+            }else if (value == "shared"){
+                tuning.reduction = ReductionShared;
+            }
+        }else if (key == "reduction.subgroupSize"){
+            tuning.subgroupSize = static_cast<uint32_t>( ::std::strtoul( value.c_str( ), nullptr, 10 ) );
+        }else if (key == "reduction.workgroupSize"){
+            tuning.reductionWorkgroupSize = static_cast<uint32_t>( ::std::strtoul( value.c_str( ), nullptr, 10 ) );
+        }
+    }
+    (*this) = tuning;
+    return true;
+}
+
+bool Tuning::Save(const ::std::string& path) const {
+
+    ::std::ofstream ofs( path, ::std::ios::trunc );
+    ofs << "mapping.workgroupSize=" << mappingWorkgroupSize << ::std::endl;
+    ofs << "mapping.fused=" << (fusedMapping ? 1 : 0) << ::std::endl;
+    ofs << "mapping.lanes=" << mappingLanes << ::std::endl;
+    ofs << "reduction=";
+    switch (reduction){
+        case ReductionBasic:
+            ofs << "basic";
+            break;
+
+        case ReductionSubgroups:
+            ofs << "subgroups";
+            break;
+
+        case ReductionShared:
+            ofs << "shared";
+            break;
+
+        default:
+            ofs << "auto";
+            break;
+    }
+    ofs << ::std::endl;
+    ofs << "reduction.subgroupSize=" << subgroupSize << ::std::endl;
+    ofs << "reduction.workgroupSize=" << reductionWorkgroupSize << ::std::endl;
+    ofs.close( );
+    return static_cast<bool>( ofs );
+}
+
+::std::string Tuning::Describe(void) const {
+
+    ::std::ostringstream oss;
+    oss << "mapping by workgroups of ";
+    if (mappingWorkgroupSize > 0U){
+        oss << mappingWorkgroupSize;
+    }else{
+        oss << "(default)";
+    }
+    oss << (fusedMapping ? ", fused" : ", not fused");
+    if (mappingLanes > 1U){
+        oss << ", inputs interleaved by " << mappingLanes;
+    }
+    oss << "; ";
+    switch (reduction){
+        case ReductionBasic:
+            oss << "basic reduction";
+            break;
+
+        case ReductionSubgroups:
+            oss << "reduction by subgroups of ";
+            if (subgroupSize > 0U){
+                oss << subgroupSize;
+            }else{
+                oss << "(default)";
+            }
+            break;
+
+        case ReductionShared:
+            oss << "reduction by workgroups of ";
+            if (reductionWorkgroupSize > 0U){
+                oss << reductionWorkgroupSize;
+            }else{
+                oss << "(default)";
+            }
+            oss << ", in shared memory";
+            break;
+
+        default:
+            oss << "(default) reduction";
+            break;
+    }
+    return oss.str( );
+}
+
+DeviceQueue::DeviceQueue(VkDevice vkDevice, VkQueue vkQueue):
+    m_vkResult( VK_RESULT_MAX_ENUM ),
+    m_vkDevice( vkDevice ),
+    m_vkQueue( vkQueue ),
+    m_vkSemaphore( VK_NULL_HANDLE ),
+    m_value( 0U ) {
+
+    // Create the timeline semaphore
+    VkSemaphoreTypeCreateInfo vkSemaphoreTypeCreateInfo = {};
+    vkSemaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    vkSemaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    vkSemaphoreTypeCreateInfo.initialValue = m_value;
+    VkSemaphoreCreateInfo vkSemaphoreCreateInfo = {};
+    vkSemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    vkSemaphoreCreateInfo.pNext = &vkSemaphoreTypeCreateInfo;
+    m_vkResult = ::vkCreateSemaphore( m_vkDevice, &vkSemaphoreCreateInfo, VK_NULL_HANDLE, &m_vkSemaphore );
+    if (m_vkResult != VK_SUCCESS){
+        m_vkSemaphore = VK_NULL_HANDLE;
+    }
+}
+
+DeviceQueue::DeviceQueue(DeviceQueue&& queue):
+    m_vkResult( queue.m_vkResult ),
+    m_vkDevice( queue.m_vkDevice ),
+    m_vkQueue( queue.m_vkQueue ),
+    m_vkSemaphore( queue.m_vkSemaphore ),
+    m_value( queue.m_value ) {
+
+    queue.Reset( );
+}
+
+DeviceQueue& DeviceQueue::operator=(DeviceQueue&& queue) {
+
+    if (this != &queue){
+        Release( );
+
+        m_vkResult = queue.m_vkResult;
+        m_vkDevice = queue.m_vkDevice;
+        m_vkQueue = queue.m_vkQueue;
+        m_vkSemaphore = queue.m_vkSemaphore;
+        m_value = queue.m_value;
+
+        queue.Reset( );
+    }
+    return (*this);
+}
+
+VkResult DeviceQueue::Submit(VkCommandBuffer vkCommandBuffer, const ::std::vector<TimelinePoint>& waits, TimelinePoint& point) {
+
+    // Look for an early out
+    if (m_vkSemaphore == VK_NULL_HANDLE){
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Wait on the given points, and signal the next one on our own timeline
+    ::std::vector<VkSemaphore> waitSemaphores;
+    ::std::vector<uint64_t> waitValues;
+    ::std::vector<VkPipelineStageFlags> waitStages;
+    for (auto it = waits.cbegin( ), end = waits.cend( ); it != end; ++it){
+        if (it->vkSemaphore == VK_NULL_HANDLE){
+            continue;
+        }
+        waitSemaphores.push_back( it->vkSemaphore );
+        waitValues.push_back( it->value );
+        waitStages.push_back( VK_PIPELINE_STAGE_ALL_COMMANDS_BIT );
+    }
+    const uint64_t value = m_value + 1U;
+    VkTimelineSemaphoreSubmitInfo vkTimelineSemaphoreSubmitInfo = {};
+    vkTimelineSemaphoreSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    vkTimelineSemaphoreSubmitInfo.waitSemaphoreValueCount = waitValues.size( );
+    vkTimelineSemaphoreSubmitInfo.pWaitSemaphoreValues = waitValues.data( );
+    vkTimelineSemaphoreSubmitInfo.signalSemaphoreValueCount = 1;
+    vkTimelineSemaphoreSubmitInfo.pSignalSemaphoreValues = &value;
+
+    VkCommandBuffer commandBuffers[] = { vkCommandBuffer };
+    VkSubmitInfo vkSubmitInfo = {};
+    vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    vkSubmitInfo.pNext = &vkTimelineSemaphoreSubmitInfo;
+    vkSubmitInfo.waitSemaphoreCount = waitSemaphores.size( );
+    vkSubmitInfo.pWaitSemaphores = waitSemaphores.data( );
+    vkSubmitInfo.pWaitDstStageMask = waitStages.data( );
+    vkSubmitInfo.commandBufferCount = 1;
+    vkSubmitInfo.pCommandBuffers = commandBuffers;
+    vkSubmitInfo.signalSemaphoreCount = 1;
+    vkSubmitInfo.pSignalSemaphores = &m_vkSemaphore;
+    m_vkResult = ::vkQueueSubmit( m_vkQueue, 1, &vkSubmitInfo, VK_NULL_HANDLE );
+    if (m_vkResult == VK_SUCCESS){
+        m_value = value;
+        point.vkSemaphore = m_vkSemaphore;
+        point.value = value;
+    }
+    return m_vkResult;
+}
+
+VkResult DeviceQueue::WaitFor(VkDevice vkDevice, const ::std::vector<TimelinePoint>& points, VkBool32 vkWaitAll) {
+
+    ::std::vector<VkSemaphore> semaphores;
+    ::std::vector<uint64_t> values;
+    for (auto it = points.cbegin( ), end = points.cend( ); it != end; ++it){
+        if (it->vkSemaphore == VK_NULL_HANDLE){
+            // Never submitted, so nothing to wait for
+            if (vkWaitAll){
+                continue;
+            }
+            return VK_SUCCESS;
+        }
+        semaphores.push_back( it->vkSemaphore );
+        values.push_back( it->value );
+    }
+    if (semaphores.empty( )){
+        return VK_SUCCESS;
+    }
+
+    VkSemaphoreWaitInfo vkSemaphoreWaitInfo = {};
+    vkSemaphoreWaitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    vkSemaphoreWaitInfo.flags = vkWaitAll ? 0 : VK_SEMAPHORE_WAIT_ANY_BIT;
+    vkSemaphoreWaitInfo.semaphoreCount = semaphores.size( );
+    vkSemaphoreWaitInfo.pSemaphores = semaphores.data( );
+    vkSemaphoreWaitInfo.pValues = values.data( );
+    return g_pVkWaitSemaphoresKHR( vkDevice, &vkSemaphoreWaitInfo, UINT64_MAX );
+}
+
+void DeviceQueue::Reset(void) {
+
+    m_vkResult = VK_RESULT_MAX_ENUM;
+    m_vkDevice = VK_NULL_HANDLE;
+    m_vkQueue = VK_NULL_HANDLE;
+    m_vkSemaphore = VK_NULL_HANDLE;
+    m_value = 0U;
+}
+
+void DeviceQueue::Release(void) {
+
+    if (m_vkSemaphore != VK_NULL_HANDLE){
+        // Don't pull the semaphore out from under anything still in flight
+        ::vkQueueWaitIdle( m_vkQueue );
+        ::vkDestroySemaphore( m_vkDevice, m_vkSemaphore, VK_NULL_HANDLE );
+    }
+    Reset( );
+}
+
+bool TimelineSnapshot::Reached(const TimelinePoint& point) {
+
+    if (point.vkSemaphore == VK_NULL_HANDLE){
+        // Never submitted
+        return true;
+    }
+
+    // Read the value of the timeline, unless we already have
+    auto found = ::std::find_if( m_values.begin( ), m_values.end( ), [&](const TimelinePoint& value) {
+        return (value.vkSemaphore == point.vkSemaphore);
+    } );
+    if (found == m_values.end( )){
+        TimelinePoint value = { point.vkSemaphore, 0U };
+        g_pVkGetSemaphoreCounterValueKHR( m_vkDevice, point.vkSemaphore, &(value.value) );
+        m_values.push_back( value );
+        found = m_values.end( ) - 1;
+    }
+    return (found->value >= point.value);
+}
+
+// Hands out aligned ranges of a few large blocks of device memory (per memory type),
+// and takes them back for re-use, rather than allocating (and freeing) as it goes
+class MemoryPool {
+public:
+    MemoryPool(VkDevice vkDevice): m_vkDevice( vkDevice ) {
+        m_stats.blockCount = m_stats.allocationCount = m_stats.freeCount = 0U;
+        m_stats.vkBlockSize = 0U;
+    }
+    MemoryPool(MemoryPool const&) = delete;
+    ~MemoryPool(void) { Release( ); }
+
+    MemoryPool& operator=(MemoryPool const&) = delete;
+
+    // Returns the block containing a range of the given size and alignment, and
+    // the offset (and, if host-visible, address) of the range within it
+    VkDeviceMemory Allocate(const MemoryTypeBudget&, VkDeviceSize, VkDeviceSize, VkDeviceSize&, void**);
+
+    // Takes back the range of the given block at the given offset
+    void Free(VkDeviceMemory, VkDeviceSize, VkDeviceSize);
+
+    // Frees all of the blocks
+    void Release(void);
+
+    const MemoryPoolStats& Stats(void) const { return m_stats; }
+
+private:
+    typedef ::std::pair<VkDeviceSize, VkDeviceSize> range_type;
+
+    struct Block {
+        VkDeviceMemory vkDeviceMemory;
+        VkDeviceSize vkSize;
+        uint32_t memoryTypeIndex;
+        void* pData;
+
+        // The free ranges of the block, as (offset, size) pairs in order of offset
+        ::std::vector<range_type> free;
+    };
+
+    // Carves a range of the given size and alignment out of the given
+    // block, if it has one free, and returns its offset
+    static bool Carve(Block&, VkDeviceSize, VkDeviceSize, VkDeviceSize&);
+
+    VkDevice m_vkDevice;
+    ::std::vector<Block> m_blocks;
+    MemoryPoolStats m_stats;
+
+    // The preferred size of each block
+    static const VkDeviceSize c_vkBlockSize = 1024U * 1024U * 1024U;
+};
+
+VkDeviceMemory MemoryPool::Allocate(const MemoryTypeBudget& deviceMemoryBudget, VkDeviceSize vkSize, VkDeviceSize vkAlignment, VkDeviceSize& vkOffset, void** ppData) {
+
+    const auto stamp = [&](Block& block) -> VkDeviceMemory {
+        m_stats.allocationCount++;
+        *ppData = block.pData ? (static_cast<uint8_t*>( block.pData ) + vkOffset) : nullptr;
+        return block.vkDeviceMemory;
+    };
+
+    // Look for a free range in the blocks we have of the given type
+    for (auto it = m_blocks.begin( ), end = m_blocks.end( ); it != end; ++it){
+        if ((it->memoryTypeIndex == deviceMemoryBudget.memoryTypeIndex) && Carve( *it, vkSize, vkAlignment, vkOffset )){
+            return stamp( *it );
+        }
+    }
+
+    // Allocate another block, as big as we'd prefer if the budget allows it, or else just big enough
+    VkDeviceSize vkBlockSizes[] = { ::std::max( c_vkBlockSize, vkSize ), vkSize };
+    if ((deviceMemoryBudget.vkMemoryBudget < vkBlockSizes[0]) || (vkBlockSizes[0] == vkSize)){
+        vkBlockSizes[0] = 0U;
+    }
+    Block block = { VK_NULL_HANDLE, 0U, deviceMemoryBudget.memoryTypeIndex, nullptr };
+    for (auto vkBlockSize : vkBlockSizes){
+        if (vkBlockSize == 0U){
+            // Not worth trying
+            continue;
+        }
+        VkMemoryAllocateInfo vkDeviceMemoryAllocateInfo = {};
+        vkDeviceMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        vkDeviceMemoryAllocateInfo.allocationSize = vkBlockSize;
+        vkDeviceMemoryAllocateInfo.memoryTypeIndex = deviceMemoryBudget.memoryTypeIndex;
+        if (::vkAllocateMemory( m_vkDevice, &vkDeviceMemoryAllocateInfo, VK_NULL_HANDLE, &(block.vkDeviceMemory) ) == VK_SUCCESS){
+            block.vkSize = vkBlockSize;
+            break;
+        }
+        block.vkDeviceMemory = VK_NULL_HANDLE;
+    }
+    if (block.vkDeviceMemory == VK_NULL_HANDLE){
+        return VK_NULL_HANDLE;
+    }
+
+    // Keep host-visible blocks mapped in for as long as we have them, and zero
+    // them the once (apparently important on Steam Deck..?) rather than per range
+    if ((deviceMemoryBudget.vkMemoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0){
+        if (::vkMapMemory( m_vkDevice, block.vkDeviceMemory, 0U, VK_WHOLE_SIZE, 0, &(block.pData) ) != VK_SUCCESS){
+            ::vkFreeMemory( m_vkDevice, block.vkDeviceMemory, VK_NULL_HANDLE );
+            return VK_NULL_HANDLE;
+        }
+        ::std::memset( block.pData, 0, block.vkSize );
+    }
+    block.free.push_back( range_type( 0U, block.vkSize ) );
+    m_stats.blockCount++;
+    m_stats.vkBlockSize += block.vkSize;
+    ::std::cout << "Allocated a block of " << block.vkSize << " bytes of memory type " << block.memoryTypeIndex << ".." << ::std::endl;
+
+    m_blocks.push_back( ::std::move( block ) );
+    auto& back = m_blocks.back( );
+    Carve( back, vkSize, vkAlignment, vkOffset );
+    return stamp( back );
+}
+
+void MemoryPool::Free(VkDeviceMemory vkDeviceMemory, VkDeviceSize vkOffset, VkDeviceSize vkSize) {
+
+    const auto found = ::std::find_if( m_blocks.begin( ), m_blocks.end( ), [=](const Block& block) {
+        return (block.vkDeviceMemory == vkDeviceMemory);
+    } );
+    if (found == m_blocks.end( )){
+        // Already released
+        return;
+    }
+    m_stats.freeCount++;
+
+    // Put the range back in order, and merge it with its neighbours
+    auto& free = found->free;
+    auto it = free.insert(
+        ::std::lower_bound( free.begin( ), free.end( ), range_type( vkOffset, vkSize ) ),
+        range_type( vkOffset, vkSize )
+    );
+    const auto next = it + 1;
+    if ((next != free.end( )) && ((it->first + it->second) == next->first)){
+        it->second += next->second;
+        free.erase( next );
+    }
+    if (it != free.begin( )){
+        const auto prev = it - 1;
+        if ((prev->first + prev->second) == it->first){
+            prev->second += it->second;
+            free.erase( it );
+        }
+    }
+}
+
+void MemoryPool::Release(void) {
+
+    for (auto it = m_blocks.cbegin( ), end = m_blocks.cend( ); it != end; ++it){
+        if (it->pData){
+            ::vkUnmapMemory( m_vkDevice, it->vkDeviceMemory );
+        }
+        ::vkFreeMemory( m_vkDevice, it->vkDeviceMemory, VK_NULL_HANDLE );
+    }
+    m_blocks.clear( );
+}
+
+bool MemoryPool::Carve(Block& block, VkDeviceSize vkSize, VkDeviceSize vkAlignment, VkDeviceSize& vkOffset) {
+
+    // Take the first free range with room enough, once aligned
+    auto& free = block.free;
+    for (auto it = free.begin( ), end = free.end( ); it != end; ++it){
+        const auto start = (vkAlignment > 1U)
+            ? (((it->first + vkAlignment - 1U) / vkAlignment) * vkAlignment)
+            : it->first;
+        const auto bound = it->first + it->second;
+        if ((start + vkSize) > bound){
+            continue;
+        }
+
+        // Leave whatever's either side of it free
+        const range_type before( it->first, start - it->first );
+        const range_type after( start + vkSize, bound - (start + vkSize) );
+        it = free.erase( it );
+        if (after.second > 0U){
+            it = free.insert( it, after );
+        }
+        if (before.second > 0U){
+            free.insert( it, before );
+        }
+        vkOffset = start;
+        return true;
+    }
+    return false;
+}
+
+MemoryRange::MemoryRange(const ::std::shared_ptr<MemoryPool>& pool, VkDeviceMemory vkDeviceMemory, VkDeviceSize vkOffset, VkDeviceSize vkSize, void* pData):
+    m_pool( pool ),
+    m_vkDeviceMemory( vkDeviceMemory ),
+    m_vkOffset( vkOffset ),
+    m_vkSize( vkSize ),
+    m_pData( pData ) { }
+
+MemoryRange::MemoryRange(MemoryRange&& range):
+    m_pool( ::std::move( range.m_pool ) ),
+    m_vkDeviceMemory( range.m_vkDeviceMemory ),
+    m_vkOffset( range.m_vkOffset ),
+    m_vkSize( range.m_vkSize ),
+    m_pData( range.m_pData ) {
+
+    range.Reset( );
+}
+
+MemoryRange& MemoryRange::operator=(MemoryRange&& range) {
+
+    if (this != &range){
+        Release( );
+
+        m_pool = ::std::move( range.m_pool );
+        m_vkDeviceMemory = range.m_vkDeviceMemory;
+        m_vkOffset = range.m_vkOffset;
+        m_vkSize = range.m_vkSize;
+        m_pData = range.m_pData;
+
+        range.Reset( );
+    }
+    return (*this);
+}
+
+void MemoryRange::Reset(void) {
+
+    m_pool.reset( );
+    m_vkDeviceMemory = VK_NULL_HANDLE;
+    m_vkOffset = m_vkSize = 0U;
+    m_pData = nullptr;
+}
+
+void MemoryRange::Release(void) {
+
+    if (m_pool && (m_vkDeviceMemory != VK_NULL_HANDLE)){
+        m_pool->Free( m_vkDeviceMemory, m_vkOffset, m_vkSize );
+    }
+    Reset( );
+}
+
+ComputeDevice::ComputeDevice(VkPhysicalDevice vkPhysicalDevice, uint32_t queueFamily, uint32_t queueCount, uint32_t transferFamily):
     m_vkPhysicalDevice( vkPhysicalDevice ),
     m_queueFamily( queueFamily ),
     m_queueCount( queueCount ),
     m_queueNext( 0U ),
+    m_transferFamily( (transferFamily == queueFamily) ? uint32_t(-1) : transferFamily ),
     m_vkResult( VK_RESULT_MAX_ENUM ),
     m_vkDevice( VK_NULL_HANDLE ) {
 
@@ -429,6 +1110,7 @@ ComputeDevice::ComputeDevice(VkPhysicalDevice vkPhysicalDevice, uint32_t queueFa
             decltype(deviceExtNames) requestedExtNames = {
                 (char*) VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
                 (char*) VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+                (char*) VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
                 (char*) VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME
             };
             vkEnumerateDeviceExtensionProperties( vkPhysicalDevice, VK_NULL_HANDLE, &uDeviceExtensionPropertyCount, pVkExtensionProperties );
@@ -461,29 +1143,90 @@ ComputeDevice::ComputeDevice(VkPhysicalDevice vkPhysicalDevice, uint32_t queueFa
     vkPhysicalDeviceSynchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
     vkPhysicalDeviceSynchronization2Features.synchronization2 = VK_TRUE;
 
+    // Enable the timeline semaphore feature
+    VkPhysicalDeviceTimelineSemaphoreFeatures vkPhysicalDeviceTimelineSemaphoreFeatures = {};
+    vkPhysicalDeviceTimelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    vkPhysicalDeviceTimelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+    vkPhysicalDeviceSynchronization2Features.pNext = &vkPhysicalDeviceTimelineSemaphoreFeatures;
+
     // Enable the subgroup size control features
     VkPhysicalDeviceSubgroupSizeControlFeatures subgroupSizeControlFeatures = {};
     subgroupSizeControlFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES;
     subgroupSizeControlFeatures.subgroupSizeControl = VK_TRUE;
     subgroupSizeControlFeatures.pNext = &vkPhysicalDeviceSynchronization2Features;
 
-    // Try and create the device along w/all the queues..
+    // Try and create the device along w/all the queues (plus one from the transfer family, if any)..
     vector<float> queuePriorities(queueCount, 1.0f);
-    VkDeviceQueueCreateInfo vkDeviceQueueCreateInfo = {};
-    vkDeviceQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    vkDeviceQueueCreateInfo.queueFamilyIndex = queueFamily;
-    vkDeviceQueueCreateInfo.queueCount = queuePriorities.size( );
-    vkDeviceQueueCreateInfo.pQueuePriorities = queuePriorities.data( );
+    VkDeviceQueueCreateInfo vkDeviceQueueCreateInfos[2] = {};
+    vkDeviceQueueCreateInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    vkDeviceQueueCreateInfos[0].queueFamilyIndex = queueFamily;
+    vkDeviceQueueCreateInfos[0].queueCount = queuePriorities.size( );
+    vkDeviceQueueCreateInfos[0].pQueuePriorities = queuePriorities.data( );
+    vkDeviceQueueCreateInfos[1] = vkDeviceQueueCreateInfos[0];
+    vkDeviceQueueCreateInfos[1].queueFamilyIndex = m_transferFamily;
+    vkDeviceQueueCreateInfos[1].queueCount = 1;
     VkDeviceCreateInfo vkDeviceCreateInfo = {};
     vkDeviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     vkDeviceCreateInfo.pNext = &subgroupSizeControlFeatures;
-    vkDeviceCreateInfo.queueCreateInfoCount = 1;
-    vkDeviceCreateInfo.pQueueCreateInfos = &vkDeviceQueueCreateInfo;
+    vkDeviceCreateInfo.queueCreateInfoCount = (m_transferFamily == uint32_t(-1)) ? 1 : 2;
+    vkDeviceCreateInfo.pQueueCreateInfos = vkDeviceQueueCreateInfos;
     if (!deviceExtNames.empty( )){
         vkDeviceCreateInfo.enabledExtensionCount = deviceExtNames.size( );
         vkDeviceCreateInfo.ppEnabledExtensionNames = deviceExtNames.data( );
     }
     m_vkResult = ::vkCreateDevice( vkPhysicalDevice, &vkDeviceCreateInfo, pAllocator, &m_vkDevice );
+    if (m_vkResult == VK_SUCCESS){
+        m_memoryPool = ::std::make_shared<MemoryPool>( m_vkDevice );
+
+        // Get the pipeline cache; pipelines can still be created without one
+        m_pipelineCache = PipelineCache( m_vkDevice, m_vkPhysicalDevice );
+        if (!m_pipelineCache){
+            ::std::cerr << "Failed to create a pipeline cache; pipelines will be compiled from scratch." << ::std::endl;
+        }
+
+        // Load the choices for the pipelines, if the device (and driver version) has been profiled
+        VkPhysicalDeviceIDProperties vkPhysicalDeviceIDProperties = {};
+        vkPhysicalDeviceIDProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+        VkPhysicalDeviceProperties2KHR vkPhysicalDeviceProperties2 = {};
+        vkPhysicalDeviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        vkPhysicalDeviceProperties2.pNext = &vkPhysicalDeviceIDProperties;
+        this->GetPhysicalDeviceProperties2KHR( &vkPhysicalDeviceProperties2 );
+
+        ::std::ostringstream oss;
+        oss << cache_directory( ) << "/vkmr-" << ::std::hex << ::std::setfill( '0' );
+        for (uint32_t u = 0U; u < VK_UUID_SIZE; ++u){
+            oss << ::std::setw( 2 ) << static_cast<uint32_t>( vkPhysicalDeviceIDProperties.deviceUUID[u] );
+        }
+        oss << "-" << ::std::setw( 8 ) << vkPhysicalDeviceProperties2.properties.driverVersion << ".profile";
+        m_profilePath = oss.str( );
+        if (m_tuning.Load( m_profilePath )){
+            cout << "Loaded tuning (" << m_tuning.Describe( ) << ") from " << m_profilePath << endl;
+        }
+
+        // Get the queues, each with its own timeline
+        for (uint32_t u = 0U; u < m_queueCount; ++u){
+            VkQueue vkQueue = VK_NULL_HANDLE;
+            ::vkGetDeviceQueue( m_vkDevice, m_queueFamily, u, &vkQueue );
+            DeviceQueue queue( m_vkDevice, vkQueue );
+            if ((vkQueue == VK_NULL_HANDLE) || !queue){
+                ::std::cerr << "Failed to retrieve device queue #" << u << "!" << ::std::endl;
+                continue;
+            }
+            m_queues.push_back( ::std::move( queue ) );
+        }
+
+        // And the transfer queue, if any
+        if (m_transferFamily != uint32_t(-1)){
+            VkQueue vkQueue = VK_NULL_HANDLE;
+            ::vkGetDeviceQueue( m_vkDevice, m_transferFamily, 0U, &vkQueue );
+            DeviceQueue queue( m_vkDevice, vkQueue );
+            if ((vkQueue == VK_NULL_HANDLE) || !queue){
+                ::std::cerr << "Failed to retrieve the transfer queue!" << ::std::endl;
+            }else{
+                m_transferQueue = ::std::move( queue );
+            }
+        }
+    }
 }
 
 ComputeDevice::ComputeDevice(ComputeDevice&& device):
@@ -491,8 +1234,15 @@ ComputeDevice::ComputeDevice(ComputeDevice&& device):
     m_queueFamily( device.m_queueFamily ),
     m_queueCount( device.m_queueCount ),
     m_queueNext( device.m_queueNext ),
+    m_queues( ::std::move( device.m_queues ) ),
+    m_transferFamily( device.m_transferFamily ),
+    m_transferQueue( ::std::move( device.m_transferQueue ) ),
     m_vkResult( device.m_vkResult ),
-    m_vkDevice( device.m_vkDevice) {
+    m_vkDevice( device.m_vkDevice),
+    m_pipelineCache( ::std::move( device.m_pipelineCache ) ),
+    m_tuning( device.m_tuning ),
+    m_profilePath( ::std::move( device.m_profilePath ) ),
+    m_memoryPool( ::std::move( device.m_memoryPool ) ) {
 
     device.Reset( );
 }
@@ -506,8 +1256,15 @@ ComputeDevice& ComputeDevice::operator=(ComputeDevice&& device) {
         m_queueFamily = device.m_queueFamily;
         m_queueCount = device.m_queueCount;
         m_queueNext = device.m_queueNext;
+        m_queues = ::std::move( device.m_queues );
+        m_transferFamily = device.m_transferFamily;
+        m_transferQueue = ::std::move( device.m_transferQueue );
         m_vkResult = device.m_vkResult;
         m_vkDevice = device.m_vkDevice;
+        m_pipelineCache = ::std::move( device.m_pipelineCache );
+        m_tuning = device.m_tuning;
+        m_profilePath = ::std::move( device.m_profilePath );
+        m_memoryPool = ::std::move( device.m_memoryPool );
 
         device.Reset( );
     }
@@ -522,19 +1279,26 @@ CommandPool ComputeDevice::CreateCommandPool(void) const {
     return CommandPool( m_vkDevice, m_queueFamily );
 }
 
-VkQueue ComputeDevice::Queue(void) {
+CommandPool ComputeDevice::CreateTransferCommandPool(void) const {
+    return CommandPool( m_vkDevice, this->TransferQueueFamily( ) );
+}
+
+DeviceQueue& ComputeDevice::Queue(void) {
 
-    VkQueue vkQueue = VK_NULL_HANDLE;
-    ::vkGetDeviceQueue( m_vkDevice, m_queueFamily, m_queueNext, &vkQueue );
-    if (vkQueue == VK_NULL_HANDLE){
-        ::std::cerr << "Failed to retrieve handle to device queue!" << ::std::endl;
-    }else{
-        m_queueNext += 1U;
-        if (m_queueNext >= m_queueCount){
-            m_queueNext = 0U;
-        }
+    if (m_queues.empty( )){
+        ::std::cerr << "No device queue to hand!" << ::std::endl;
+        return m_noQueue;
+    }
+    auto& queue = m_queues[m_queueNext];
+    m_queueNext += 1U;
+    if (m_queueNext >= m_queues.size( )){
+        m_queueNext = 0U;
     }
-    return vkQueue;
+    return queue;
+}
+
+DeviceQueue& ComputeDevice::TransferQueue(void) {
+    return this->HasTransferQueue( ) ? m_transferQueue : this->Queue( );
 }
 
 VkMemoryRequirements ComputeDevice::StorageBufferRequirements(VkDeviceSize vkSize) const {
@@ -563,6 +1327,16 @@ VkMemoryRequirements ComputeDevice::StorageBufferRequirements(VkDeviceSize vkSiz
     return vkMemoryRequirements;
 }
 
+bool ComputeDevice::SaveTuning(void) const {
+
+    if (m_profilePath.empty( ) || !m_tuning.Save( m_profilePath )){
+        ::std::cerr << "Failed to save the tuning to " << m_profilePath << ::std::endl;
+        return false;
+    }
+    ::std::cout << "Saved tuning (" << m_tuning.Describe( ) << ") to " << m_profilePath << ::std::endl;
+    return true;
+}
+
 void ComputeDevice::GetPhysicalDeviceProperties2KHR(VkPhysicalDeviceProperties2KHR* pVkPhysicalDeviceProperties2) const {
     g_pVkGetPhysicalDeviceProperties2KHR( m_vkPhysicalDevice, pVkPhysicalDeviceProperties2 );
 }
@@ -638,42 +1412,54 @@ ComputeDevice::MemoryTypeBudgets ComputeDevice::AvailableMemoryTypes(
     return memoryTypeBudgets;
 }
 
-VkDeviceMemory ComputeDevice::Allocate(const MemoryTypeBudget& deviceMemoryBudget, VkDeviceSize vkSize) {
+MemoryRange ComputeDevice::Allocate(const MemoryTypeBudget& deviceMemoryBudget, VkDeviceSize vkSize, VkDeviceSize vkAlignment) {
 
-    VkMemoryAllocateInfo vkDeviceMemoryAllocateInfo = {};
-    vkDeviceMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    vkDeviceMemoryAllocateInfo.allocationSize = vkSize;
-    vkDeviceMemoryAllocateInfo.memoryTypeIndex = deviceMemoryBudget.memoryTypeIndex;
-    VkDeviceMemory vkDeviceMemory = VK_NULL_HANDLE;
-    VkResult vkResult = ::vkAllocateMemory( m_vkDevice, &vkDeviceMemoryAllocateInfo, VK_NULL_HANDLE, &vkDeviceMemory );
-    if (vkResult == VK_SUCCESS){
-        //::std::cout << "Allocated " << int64_t(vkSize) << " bytes of memory type " << vkDeviceMemoryAllocateInfo.memoryTypeIndex << ::std::endl;
-
-        // TODO, maybe: keep track of allocations? But, would that ever be useful?
-        return vkDeviceMemory;
+    if (!m_memoryPool){
+        return MemoryRange( );
+    }
+    VkDeviceSize vkOffset = 0U;
+    void* pData = nullptr;
+    auto vkDeviceMemory = m_memoryPool->Allocate( deviceMemoryBudget, vkSize, vkAlignment, vkOffset, &pData );
+    if (vkDeviceMemory == VK_NULL_HANDLE){
+        return MemoryRange( );
     }
-    return VK_NULL_HANDLE;
+    return MemoryRange( m_memoryPool, vkDeviceMemory, vkOffset, vkSize, pData );
 }
 
-void ComputeDevice::Free(VkDeviceMemory vkDeviceMemory) const {
+MemoryPoolStats ComputeDevice::MemoryStats(void) const {
 
-    if (vkDeviceMemory != VK_NULL_HANDLE){
-        ::vkFreeMemory( m_vkDevice, vkDeviceMemory, VK_NULL_HANDLE );
+    if (m_memoryPool){
+        return m_memoryPool->Stats( );
     }
+    MemoryPoolStats stats = { 0U, 0U, 0U, 0U };
+    return stats;
 }
 
 void ComputeDevice::Reset() {
 
     m_vkPhysicalDevice = VK_NULL_HANDLE;
     m_queueCount = m_queueNext = 0U;
-    m_queueFamily = uint32_t(-1);
+    m_queueFamily = m_transferFamily = uint32_t(-1);
     m_vkResult = VK_RESULT_MAX_ENUM;
     m_vkDevice = VK_NULL_HANDLE;
+    m_queues.clear( );
+    m_transferQueue = DeviceQueue( );
+    m_pipelineCache = PipelineCache( );
+    m_tuning = Tuning( );
+    m_profilePath.clear( );
+    m_memoryPool.reset( );
 }
 
 void ComputeDevice::Release() {
 
     const VkAllocationCallbacks *pAllocator = VK_NULL_HANDLE;
+    if (m_memoryPool){
+        // Any ranges still outstanding are of no use once the device is gone
+        m_memoryPool->Release( );
+    }
+    m_queues.clear( );
+    m_transferQueue = DeviceQueue( );
+    m_pipelineCache = PipelineCache( );
     if (m_vkDevice != VK_NULL_HANDLE){
         ::vkDestroyDevice( m_vkDevice, pAllocator );
     }
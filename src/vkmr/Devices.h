@@ -8,13 +8,20 @@
 //
 
 // C++ Standard Library Headers
+#include <memory>
 #include <vector>
+#include <string>
 
 // Local Project Headers
 #include "Shaders.h"
 
 namespace vkmr {
 
+// Forward Declarations
+//
+
+class MemoryPool;
+
 // Class(es)
 //
 
@@ -49,7 +56,7 @@ private:
 // Encapsulates a command buffer
 class CommandBuffer {
 public:
-    CommandBuffer(VkDevice, VkCommandPool);
+    CommandBuffer(VkDevice, VkCommandPool, VkCommandBufferLevel = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
     CommandBuffer(CommandBuffer&&);
     CommandBuffer(CommandBuffer const&) = delete;
     CommandBuffer(void) { Reset( ); }
@@ -88,8 +95,8 @@ public:
     operator bool() const { return (m_vkCommandPool != VK_NULL_HANDLE); }
     operator VkResult() const { return m_vkResult; }
 
-    // Allocate a new command buffer from the pool
-    CommandBuffer AllocateCommandBuffer(void);
+    // Allocate a new (by default, primary) command buffer from the pool
+    CommandBuffer AllocateCommandBuffer(VkCommandBufferLevel = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
 private:
     void Reset(void);
@@ -101,6 +108,64 @@ private:
     VkCommandPool m_vkCommandPool;
 };
 
+// A point on the timeline of a queue, i.e. the value which its (timeline)
+// semaphore reaches once a given submission to the queue has completed
+typedef struct {
+    VkSemaphore vkSemaphore;
+    uint64_t value;
+} TimelinePoint;
+
+// Encapsulates a queue, along with a timeline semaphore which
+// it advances as each submission to it completes
+class DeviceQueue {
+public:
+    DeviceQueue(VkDevice, VkQueue);
+    DeviceQueue(DeviceQueue&&);
+    DeviceQueue(DeviceQueue const&) = delete;
+    DeviceQueue(void) { Reset( ); }
+    ~DeviceQueue(void) { Release( ); }
+
+    DeviceQueue& operator=(DeviceQueue&&);
+    DeviceQueue& operator=(DeviceQueue const&) = delete;
+    operator bool() const { return (m_vkSemaphore != VK_NULL_HANDLE); }
+    operator VkResult() const { return m_vkResult; }
+
+    // Returns the underlying queue
+    VkQueue operator * () const { return m_vkQueue; }
+
+    // Submits the given command buffer, to be executed once the given points (on the
+    // timelines of any of the queues) have been reached, and gives the point reached
+    // on this queue's timeline once it has completed
+    VkResult Submit(VkCommandBuffer, const ::std::vector<TimelinePoint>&, TimelinePoint&);
+
+    // Blocks until any (or all) of the given points have been reached
+    static VkResult WaitFor(VkDevice, const ::std::vector<TimelinePoint>&, VkBool32);
+
+private:
+    void Reset(void);
+    void Release(void);
+
+    VkResult m_vkResult;
+    VkDevice m_vkDevice;
+    VkQueue m_vkQueue;
+
+    VkSemaphore m_vkSemaphore;
+    uint64_t m_value;
+};
+
+// Tells whether points on the timelines of the queues have been
+// reached, reading the value of each timeline no more than once
+class TimelineSnapshot {
+public:
+    TimelineSnapshot(VkDevice vkDevice): m_vkDevice( vkDevice ) { }
+
+    bool Reached(const TimelinePoint&);
+
+private:
+    VkDevice m_vkDevice;
+    ::std::vector<TimelinePoint> m_values;
+};
+
 typedef struct {
     uint32_t heapIndex;
     uint32_t memoryTypeIndex;
@@ -108,6 +173,48 @@ typedef struct {
     VkMemoryPropertyFlags vkMemoryPropertyFlags;
 } MemoryTypeBudget;
 
+// Counts the allocations made by (and from) a memory pool
+typedef struct {
+    uint32_t blockCount;
+    VkDeviceSize vkBlockSize;
+    uint32_t allocationCount, freeCount;
+} MemoryPoolStats;
+
+// Encapsulates an (aligned) range of a larger block of device memory, which
+// is handed back to the pool it came from (rather than freed) on release
+class MemoryRange {
+public:
+    MemoryRange(const ::std::shared_ptr<MemoryPool>&, VkDeviceMemory, VkDeviceSize, VkDeviceSize, void*);
+    MemoryRange(MemoryRange&&);
+    MemoryRange(MemoryRange const&) = delete;
+    MemoryRange(void) { Reset( ); }
+    ~MemoryRange(void) { Release( ); }
+
+    MemoryRange& operator=(MemoryRange&&);
+    MemoryRange& operator=(MemoryRange const&) = delete;
+    operator bool() const { return (m_vkDeviceMemory != VK_NULL_HANDLE); }
+
+    // Returns the underlying block of device memory
+    VkDeviceMemory operator * () const { return m_vkDeviceMemory; }
+
+    // Returns the offset of the range within the block, and its size, in bytes
+    VkDeviceSize Offset(void) const { return m_vkOffset; }
+    VkDeviceSize Size(void) const { return m_vkSize; }
+
+    // Returns the (host) address of the start of the range, if the
+    // memory is host-visible; null otherwise
+    void* Data(void) const { return m_pData; }
+
+private:
+    void Reset(void);
+    void Release(void);
+
+    ::std::shared_ptr<MemoryPool> m_pool;
+    VkDeviceMemory m_vkDeviceMemory;
+    VkDeviceSize m_vkOffset, m_vkSize;
+    void* m_pData;
+};
+
 struct WorkgroupSize {
     uint32_t x, y, z;
     bool bySubgroup = false;
@@ -118,7 +225,7 @@ struct WorkgroupSize {
 // Encapsulates a pipeline
 class Pipeline {
 public:
-    Pipeline(VkDevice, VkDescriptorSetLayout, VkPipelineLayout, ShaderModule&&, const WorkgroupSize* pWorkGroupSize = nullptr);
+    Pipeline(VkDevice, VkDescriptorSetLayout, VkPipelineLayout, ShaderModule&&, const WorkgroupSize* pWorkGroupSize = nullptr, VkPipelineCache = VK_NULL_HANDLE);
     Pipeline(Pipeline&&);
     Pipeline(Pipeline const&) = delete;
 
@@ -180,10 +287,70 @@ private:
     VkDescriptorPool m_vkDescriptorPool;
 };
 
+// Encapsulates a pipeline cache, seeded from (and, on release, written back
+// to) a file specific to the physical device and driver version
+class PipelineCache {
+public:
+    PipelineCache(VkDevice, VkPhysicalDevice);
+    PipelineCache(PipelineCache&&);
+    PipelineCache(PipelineCache const&) = delete;
+    PipelineCache(void) { Reset( ); }
+    ~PipelineCache(void) { Release( ); }
+
+    PipelineCache& operator=(PipelineCache&&);
+    PipelineCache& operator=(PipelineCache const&) = delete;
+    operator bool() const { return (m_vkPipelineCache != VK_NULL_HANDLE); }
+    operator VkResult() const { return m_vkResult; }
+
+    // Returns the underlying pipeline cache
+    VkPipelineCache operator * () const { return m_vkPipelineCache; }
+
+    // Returns the path to the file backing the cache
+    static ::std::string Path(const VkPhysicalDeviceProperties&);
+
+private:
+    void Reset(void);
+    void Release(void);
+
+    VkResult m_vkResult;
+    VkDevice m_vkDevice;
+
+    VkPipelineCache m_vkPipelineCache;
+    ::std::string m_path;
+    size_t m_loaded;
+};
+
+// Gives the choices made for the pipelines of a device, as found (by autotuning) to be the fastest
+// on it and kept in a profile specific to the device and driver version; zeroes leave the defaults
+struct Tuning {
+    // How slices are reduced: by subgroup, where supported; by workgroup, several levels
+    // at a time in shared memory; or pair-by-pair, one level at a time
+    enum Reduction {
+        ReductionAuto,
+        ReductionBasic,
+        ReductionSubgroups,
+        ReductionShared
+    };
+
+    uint32_t mappingWorkgroupSize = 0U;
+    bool fusedMapping = true;
+    uint32_t mappingLanes = 0U;
+    Reduction reduction = ReductionAuto;
+    uint32_t subgroupSize = 0U;
+    uint32_t reductionWorkgroupSize = 0U;
+
+    // Reads the choices in from, or writes them out to, the given profile, returning true if successful
+    bool Load(const ::std::string&);
+    bool Save(const ::std::string&) const;
+
+    // Describes the choices, e.g. for logging
+    ::std::string Describe(void) const;
+};
+
 // Encapsulates a (logical, Vulkan) compute device
 class ComputeDevice {
 public:
-    ComputeDevice(VkPhysicalDevice, uint32_t, uint32_t);
+    ComputeDevice(VkPhysicalDevice, uint32_t, uint32_t, uint32_t = uint32_t(-1));
     ComputeDevice(ComputeDevice&&);
     ComputeDevice(const ComputeDevice&) = delete;
     ComputeDevice(void) { Reset( ); }
@@ -200,14 +367,39 @@ public:
     // Returns a handle to the physical device
     VkPhysicalDevice PhysicalDevice(void) const { return m_vkPhysicalDevice; }
 
+    // Returns the cache from which to create the device's pipelines
+    VkPipelineCache GetPipelineCache(void) const { return *m_pipelineCache; }
+
+    // Returns the choices for the device's pipelines, as loaded from its profile (if any),
+    // and replaces them (for pipelines created from here on), respectively
+    const Tuning& GetTuning(void) const { return m_tuning; }
+    void SetTuning(const Tuning& tuning) { m_tuning = tuning; }
+
+    // Writes the current choices out to the device's profile, for later runs to load
+    bool SaveTuning(void) const;
+
     // Creates a new descriptor pool
     DescriptorPool CreateDescriptorPool(uint32_t, uint32_t) const;
 
     // Creates a new command pool
     CommandPool CreateCommandPool(void) const;
 
-    // Returns a handle to a queue
-    VkQueue Queue(void);
+    // Creates a new command pool for the transfer queue
+    CommandPool CreateTransferCommandPool(void) const;
+
+    // Returns the next of the device's queues
+    DeviceQueue& Queue(void);
+
+    // Returns true if the device has a queue from a transfer-capable family other
+    // than that of its (compute) queues, and the queue itself; otherwise, the latter
+    // falls back to the next of the compute queues
+    bool HasTransferQueue(void) const { return static_cast<bool>( m_transferQueue ); }
+    DeviceQueue& TransferQueue(void);
+
+    // Returns the indices of the families of the device's (compute) queues and,
+    // if it has one, of its transfer queue, respectively
+    uint32_t QueueFamily(void) const { return m_queueFamily; }
+    uint32_t TransferQueueFamily(void) const { return this->HasTransferQueue( ) ? m_transferFamily : m_queueFamily; }
 
     // Returns the memory requirement of storage buffers
     // created with the device
@@ -227,11 +419,12 @@ public:
     typedef ::std::vector<MemoryTypeBudget> MemoryTypeBudgets;
     MemoryTypeBudgets AvailableMemoryTypes(const VkMemoryRequirements&, VkMemoryPropertyFlags) const;
 
-    // Allocates up to the given amount of device memory
-    VkDeviceMemory Allocate(const MemoryTypeBudget&, VkDeviceSize vkSize);
+    // Sub-allocates the given amount of device memory, at the given alignment,
+    // from a larger block of the given type, allocating the block if needed
+    MemoryRange Allocate(const MemoryTypeBudget&, VkDeviceSize vkSize, VkDeviceSize vkAlignment);
 
-    // Frees the given, previously-allocated bit of memory
-    void Free(VkDeviceMemory) const;    
+    // Returns the counts of the allocations made so far
+    MemoryPoolStats MemoryStats(void) const;
 
 private:
     void Reset(void);
@@ -239,9 +432,19 @@ private:
 
     VkPhysicalDevice m_vkPhysicalDevice;
     uint32_t m_queueFamily, m_queueCount, m_queueNext;
+    ::std::vector<DeviceQueue> m_queues;
+    DeviceQueue m_noQueue;
+
+    uint32_t m_transferFamily;
+    DeviceQueue m_transferQueue;
 
     VkResult m_vkResult;
     VkDevice m_vkDevice;
+
+    PipelineCache m_pipelineCache;
+    Tuning m_tuning;
+    ::std::string m_profilePath;
+    ::std::shared_ptr<MemoryPool> m_memoryPool;
 };
 
 } // namespace vkmr
@@ -30,6 +30,12 @@ public:
 
     virtual bool Add(const arg_type& arg) = 0;
 
+    // Adds the given bytes as one input, for callers which don't have them in a string
+    virtual bool Add(const char* data, size_t size) { return this->Add( arg_type( data, size ) ); }
+
+    // Adds the given 32-byte SHA-256d hash as a leaf, as-is (i.e. without hashing it again)
+    virtual bool AddLeaf(const char*) = 0;
+
     virtual bool Reset(void) = 0;
 
 protected:
@@ -4,8 +4,18 @@
 // Includes
 //
 
+// C Standard Library Headers
+#include <stdint.h>
+#if !defined (_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 // C++ Standard Library Headers
 #include <iostream>
+#include <cstring>
 
 // Declarations
 #include "Inputs.h"
@@ -18,31 +28,65 @@ namespace vkmr {
 Input::Input(void):
     m_fp( NULL ),
     m_owner( false ),
+    m_eof( true ),
+    m_truncated( false ),
     m_size( 0U ),
-    m_count( 0U ) {    
+    m_count( 0U ),
+    m_view( NULL ),
+    m_begin( 0U ),
+    m_end( 0U ) {    
 }
 
-Input::Input(const std::string& path):
-    m_fp( ::fopen( path.c_str( ), "r" ) ),
+Input::Input(const std::string& path, const Format& format):
+    m_fp( NULL ),
+    m_format( format ),
     m_owner( true ),
+    m_eof( true ),
+    m_truncated( false ),
     m_size( 0U ),
-    m_count( 0U ) {
+    m_count( 0U ),
+    m_view( NULL ),
+    m_begin( 0U ),
+    m_end( 0U ) {
+
+    // Split the file into records in place if we can,
+    // or else fall back to reading it a block at a time
+    if (!Map( path )){
+        m_fp = ::fopen( path.c_str( ), (format.framing == Lines) ? "r" : "rb" );
+        m_eof = (m_fp == NULL);
+        Fill( );
+    }
 }
 
 Input::Input(Input&& input):
     m_fp( input.m_fp ),
+    m_format( input.m_format ),
     m_owner( input.m_owner ),
+    m_eof( input.m_eof ),
+    m_truncated( input.m_truncated ),
     m_size( input.m_size ),
-    m_count( input.m_count ) {
+    m_count( input.m_count ),
+    m_view( input.m_view ),
+    m_buffer( std::move( input.m_buffer ) ),
+    m_begin( input.m_begin ),
+    m_end( input.m_end ) {
 
     input.Reset( );
 }
 
-Input::Input(FILE* fp, bool owner):
+Input::Input(FILE* fp, bool owner, const Format& format):
     m_fp( fp ),
+    m_format( format ),
     m_owner( owner ),
+    m_eof( fp == NULL ),
+    m_truncated( false ),
     m_size( 0U ),
-    m_count( 0U ) {
+    m_count( 0U ),
+    m_view( NULL ),
+    m_begin( 0U ),
+    m_end( 0U ) {
+
+    Fill( );
 }
 
 Input::~Input(void) {
@@ -50,7 +94,7 @@ Input::~Input(void) {
 }
 
 bool Input::Has(void) const {
-    return !(::feof( m_fp ));
+    return (m_begin < m_end) || !m_eof;
 }
 
 Input& Input::operator=(Input&& input) {
@@ -59,9 +103,16 @@ Input& Input::operator=(Input&& input) {
         this->Release( );
 
         m_fp = input.m_fp;
+        m_format = input.m_format;
         m_owner = input.m_owner;
+        m_eof = input.m_eof;
+        m_truncated = input.m_truncated;
         m_size = input.m_size;
         m_count = input.m_count;
+        m_view = input.m_view;
+        m_buffer = std::move( input.m_buffer );
+        m_begin = input.m_begin;
+        m_end = input.m_end;
 
         input.Reset( );
     }
@@ -69,47 +120,207 @@ Input& Input::operator=(Input&& input) {
 }
 
 Input::operator bool(void) const {
-    return static_cast<bool>( m_fp );
+    return (m_fp != NULL) || (m_view != NULL);
 }
 
-std::string Input::Get(void) {
+Input::Record Input::Next(void) {
 
-    // Setup
-    const auto lf = static_cast<int>( '\n' );
+    Record record = { NULL, 0U };
+    switch (m_format.framing){
+        case Lines:
+            record = NextLine( );
+            break;
 
-    // Read until we hit the EOF or line-feed
-    std::string str;
-    for (bool not_finished = true; not_finished; ){
-        const auto input = fgetc( m_fp );
-        switch (input) {
-            case lf:
-            case EOF:
-                not_finished = false;
-                break;
+        case Prefixed32:
+            record = NextPrefixed( sizeof( uint32_t ) );
+            break;
+
+        case Prefixed64:
+            record = NextPrefixed( sizeof( uint64_t ) );
+            break;
+
+        default:
+            // Fixed-width and hashed records need no scanning at all
+            record = NextFixed( m_format.width );
+            break;
+    }
+
+    // Peek ahead at the end of a block, so as not to claim there's more to come when
+    // all that's left is the EOF (without disturbing the record in the buffer)
+    if ((m_begin == m_end) && !m_eof){
+        const auto c = ::fgetc( m_fp );
+        if (c == EOF){
+            m_eof = true;
+        }else{
+            ::ungetc( c, m_fp );
+        }
+    }
 
-            default:
-                // Accumulate
-                str.append( 1, static_cast<char>( input ) );
+    // Tally up (but for any left out, or cut short) and return
+    m_size += record.size;
+    m_count += (Skips( record ) || m_truncated) ? 0 : 1;
+    return record;
+}
+
+Input::Record Input::NextLine(void) {
+
+    // Scan for the next line-feed, reading in more of the file as needed
+    Record record = { NULL, 0U };
+    size_type scanned = m_begin;
+    for (const char* lf = NULL; !lf; ){
+        lf = (scanned < m_end) ? static_cast<const char*>( std::memchr( Data( ) + scanned, '\n', m_end - scanned ) ) : NULL;
+        if (lf){
+            record.data = Data( ) + m_begin;
+            record.size = static_cast<size_type>( lf - record.data );
+            m_begin += record.size + 1U;
+        }else{
+            // Remember how far we got, as the next block may move things around
+            scanned = m_end - m_begin;
+            if (!Fill( )){
+                // The last record runs up to the EOF
+                record.data = Data( ) + m_begin;
+                record.size = m_end - m_begin;
+                m_begin = m_end;
                 break;
+            }
+            scanned += m_begin;
         }
     }
+    return record;
+}
+
+Input::Record Input::NextPrefixed(size_type bytes) {
+
+    // Read the size, least significant byte first
+    Record record = { NULL, 0U };
+    if (!Ensure( bytes )){
+        m_truncated = (m_begin < m_end);
+        m_begin = m_end;
+        return record;
+    }
+    const auto p = reinterpret_cast<const unsigned char*>( Data( ) + m_begin );
+    uint64_t size = 0U;
+    for (size_type b = bytes; b > 0U; --b){
+        size = (size << 8) | p[b - 1U];
+    }
+    m_begin += bytes;
 
-    // Tally up and return
-    m_size += str.size( );
-    m_count += str.empty( ) ? 0 : 1; 
-    return str;
+    // The record itself follows on directly; having read its size, anything short of
+    // that (even nothing at all, at the end of the input) is a truncated record
+    record = NextFixed( static_cast<size_type>( size ) );
+    if ((record.data == NULL) && (size > 0U)){
+        m_truncated = true;
+    }
+    return record;
+}
+
+Input::Record Input::NextFixed(size_type size) {
+
+    Record record = { NULL, 0U };
+    if (Ensure( size )){
+        record.data = Data( ) + m_begin;
+        record.size = size;
+        m_begin += size;
+    }else{
+        // Drop whatever is left over
+        m_truncated = (m_begin < m_end);
+        m_begin = m_end;
+    }
+    return record;
+}
+
+bool Input::Map(const std::string& path) {
+
+#if defined (_WIN32)
+    return false;
+#else
+    // Only regular (non-empty) files can be mapped
+    const auto fd = ::open( path.c_str( ), O_RDONLY );
+    if (fd < 0){
+        return false;
+    }
+    struct stat st;
+    void* view = MAP_FAILED;
+    if ((::fstat( fd, &st ) == 0) && S_ISREG( st.st_mode ) && (st.st_size > 0)){
+        // Where we can, fault the whole file in up-front (i.e. in bulk, rather than a page at a time)
+        int flags = MAP_PRIVATE;
+#if defined (MAP_POPULATE)
+        flags |= MAP_POPULATE;
+#endif
+        view = ::mmap( NULL, static_cast<size_t>( st.st_size ), PROT_READ, flags, fd, 0 );
+    }
+    ::close( fd );
+    if (view == MAP_FAILED){
+        return false;
+    }
+
+    // The file is read front to back, once
+    ::madvise( view, static_cast<size_t>( st.st_size ), MADV_SEQUENTIAL );
+    m_view = static_cast<const char*>( view );
+    m_end = static_cast<size_type>( st.st_size );
+    m_eof = true;
+    return true;
+#endif
+}
+
+bool Input::Fill(void) {
+
+    // Look for an early out
+    if (m_eof){
+        return false;
+    }
+
+    // Shuffle whatever is left over up to the front, and make room for a whole block after it
+    const auto left = m_end - m_begin;
+    if (m_begin > 0U){
+        std::memmove( m_buffer.data( ), m_buffer.data( ) + m_begin, left );
+        m_begin = 0U;
+        m_end = left;
+    }
+    if ((m_buffer.size( ) - m_end) < c_blockSize){
+        m_buffer.resize( m_end + c_blockSize );
+    }
+
+    // Read the next block
+    const auto read = ::fread( m_buffer.data( ) + m_end, 1U, c_blockSize, m_fp );
+    m_end += read;
+    if (read < c_blockSize){
+        m_eof = true;
+    }
+    return (read > 0U);
+}
+
+bool Input::Ensure(size_type size) {
+
+    while ((m_end - m_begin) < size){
+        if (!Fill( )){
+            return false;
+        }
+    }
+    return true;
 }
 
 void Input::Reset(void) {
     m_fp = NULL;
+    m_format = Format( );
     m_owner = false;
+    m_eof = true;
+    m_truncated = false;
     m_size = m_count = 0U;
+    m_view = NULL;
+    m_buffer.clear( );
+    m_begin = m_end = 0U;
 }
 
 void Input::Release(void) {
     if (m_owner && m_fp){
         ::fclose( m_fp );
     }
+#if !defined (_WIN32)
+    if (m_view){
+        ::munmap( const_cast<char*>( m_view ), m_end );
+    }
+#endif
     Reset( );
 }
 
@@ -10,20 +10,50 @@
 // C++ Standard Library Headers
 #include <fstream>
 #include <string>
+#include <vector>
 
 namespace vkmr {
 
 // Class(es)
 //
 
+// Reads records from a file or stream, either mapping (regular) files
+// into memory whole, or else a block at a time
 class Input {
 public:
     typedef size_t size_type;
 
+    // The ways in which records can be framed in the input
+    enum Framing {
+        Lines,      // Delimited by line-feeds
+        Prefixed32, // Each preceded by its size, as a little-endian 32-bit integer
+        Prefixed64, // Each preceded by its size, as a little-endian 64-bit integer
+        Fixed,      // Each of the same, given size
+        Hashed      // Each a 32-byte SHA-256d hash, to be taken as a leaf as-is
+    };
+
+    struct Format {
+        Framing framing;
+        size_type width;
+
+        Format(Framing f = Lines, size_type w = 0U): framing( f ), width( (f == Hashed) ? c_hashSize : w ) { }
+    };
+
+    // A record read from the input; it points into the input's own buffer,
+    // and so is only valid until the next one is read (or, for a mapped
+    // file, for as long as the input is)
+    struct Record {
+        const char* data;
+        size_type size;
+
+        bool empty(void) const { return size == 0U; }
+        std::string str(void) const { return std::string( data, size ); }
+    };
+
     Input(void);
-    Input(const std::string&);
+    Input(const std::string&, const Format& = Format( ));
     Input(Input&&);
-    Input(FILE*, bool owner = false);
+    Input(FILE*, bool owner = false, const Format& = Format( ));
     Input(const Input&) = delete;
     ~Input(void);
 
@@ -32,18 +62,60 @@ public:
     operator bool() const;
 
     bool Has(void) const;
-    std::string Get(void);
+    Record Next(void);
+    std::string Get(void) { return Next( ).str( ); }
 
     size_type Size(void) const { return m_size; }
     size_type Count(void) const { return m_count; }
 
+    // Returns true if the given record is to be skipped, rather than added: i.e. an empty line
+    // (but not an empty length-prefixed record, which is valid data)
+    bool Skips(const Record& record) const { return record.empty( ) && (m_format.framing == Lines); }
+
+    // Returns true if the input ended part-way through a record
+    bool Truncated(void) const { return m_truncated; }
+
+    // Returns true if the input is a file mapped into memory, i.e. whose
+    // records are valid for as long as the input is
+    bool Mapped(void) const { return (m_view != NULL); }
+
+    // The size of a hash, in bytes
+    static const size_type c_hashSize = 32U;
+
 private:
     void Reset(void);
     void Release(void);
 
+    // Maps the file at the given path into memory, if possible
+    bool Map(const std::string&);
+
+    // Reads the next block from the file into the buffer, after whatever is left
+    // over from the last one; returns false if there was nothing more to read
+    bool Fill(void);
+
+    // Reads in more of the file until at least the given number of bytes are
+    // buffered; returns false if it ends first
+    bool Ensure(size_type);
+
+    // Return the next record in each framing
+    Record NextLine(void);
+    Record NextPrefixed(size_type);
+    Record NextFixed(size_type);
+
+    // Returns the start of the mapped file, or of the buffer
+    const char* Data(void) const { return m_view ? m_view : m_buffer.data( ); }
+
     FILE* m_fp;
-    bool m_owner;
+    Format m_format;
+    bool m_owner, m_eof, m_truncated;
     size_type m_size, m_count;
+
+    const char* m_view;
+    std::vector<char> m_buffer;
+    size_type m_begin, m_end;
+
+    // The number of bytes read from the file at a time
+    static const size_type c_blockSize = 1U << 20;
 };
 
 } // namespace vkmr
@@ -6,6 +6,7 @@
 
 // C++ Standard Library Headers
 #include <vector>
+#include <cstdlib>
 #include <cstring>
 #include <utility>
 #include <iostream>
@@ -31,6 +32,25 @@ namespace vkmr {
 struct alignas(uint) MappingPushConstants {
     uint offset;
     uint bound;
+    uint stride;
+    uint start;
+    uint pack;
+};
+
+// Constants
+//
+
+// The number of inputs of a single message block apiece which each invocation hashes, one after the other
+static const uint32_t PackedInputs = 4U;
+
+struct alignas(uint) FusedMappingPushConstants {
+    uint offset;
+    uint bound;
+    uint head;
+    uint pairs;
+    uint fold;
+    uint hashed;
+    uint stride;
 };
 
 // Classes
@@ -38,7 +58,7 @@ struct alignas(uint) MappingPushConstants {
 class Mapping {
 public:
     Mapping(Mapping&&);
-    Mapping(VkDevice, DescriptorSet&&, CommandBuffer&&, Batch&&, Mappings::slice_type&&, uint32_t, QueryPoolTimer&&);
+    Mapping(VkDevice, DescriptorSet&&, CommandBuffer&&, CommandBuffer&&, Batch&&, Mappings::slice_type&&, uint32_t, QueryPoolTimer&&);
     Mapping(Mapping const&) = delete;
 
     Mapping(void) { Reset( ); }
@@ -48,12 +68,24 @@ public:
     Mapping& operator=(Mapping&&);
     operator bool() const { return (m_vkResult == VK_SUCCESS); }
     operator VkResult() const { return m_vkResult; }
-    operator VkFence() const { return m_vkFence; }
 
-    VkResult Dispatch(VkQueue, vkmr::Pipeline&);
+    // Records and submits the mapping, folding the leaves as it goes if given where
+    // the batch falls in the slice, once the given points on the timeline(s) are reached
+    // (and the batch has been uploaded on the given transfer queue, if need be)
+    VkResult Dispatch(DeviceQueue&, DeviceQueue&, vkmr::Pipeline&, const Fold*, ::std::vector<TimelinePoint>);
 
-    Mappings::slice_type&& MoveSlice(void) {
-        return ::std::move( m_slice );
+    // Returns the point on the timeline of the queue reached once the mapping completes
+    const TimelinePoint& Point(void) const {
+        return m_point;
+    }
+
+    // Returns the (sub) slice being mapped into, and its number
+    const Mappings::slice_type& Target(void) const {
+        return m_slice;
+    }
+
+    Mappings::slice_type::number_type Number(void) const {
+        return m_slice.Number( );
     }
 
     const QueryPoolTimer& Timer(void) const {
@@ -64,16 +96,24 @@ public:
         return m_batch;
     }
 
+    Batch&& MoveBatch(void) {
+        return ::std::move( m_batch );
+    }
+
 private:
     void Reset(void);
     void Release(void);
 
+    uint HalfEven(uint u) {
+        return (((u % 2 == 0) ? u : (u+1)) >> 1);
+    }
+
     VkResult m_vkResult;
     VkDevice m_vkDevice;
-    VkFence m_vkFence;
+    TimelinePoint m_point;
 
     DescriptorSet m_descriptorSet;
-    CommandBuffer m_commandBuffer;
+    CommandBuffer m_commandBuffer, m_uploadCommandBuffer;
     Batch m_batch;
     Mappings::slice_type m_slice;
     QueryPoolTimer m_queryPoolTimer;
@@ -84,9 +124,10 @@ private:
 Mapping::Mapping(Mapping&& mapping):
     m_vkResult( mapping.m_vkResult ),
     m_vkDevice( mapping.m_vkDevice ),
-    m_vkFence( mapping.m_vkFence ),
+    m_point( mapping.m_point ),
     m_descriptorSet( ::std::move( mapping.m_descriptorSet ) ),
     m_commandBuffer( ::std::move( mapping.m_commandBuffer ) ),
+    m_uploadCommandBuffer( ::std::move( mapping.m_uploadCommandBuffer ) ),
     m_batch( ::std::move( mapping.m_batch ) ),
     m_slice( ::std::move( mapping.m_slice ) ),
     m_maxComputeWorkGroupCount( mapping.m_maxComputeWorkGroupCount ),
@@ -95,21 +136,19 @@ Mapping::Mapping(Mapping&& mapping):
     mapping.Reset( );
 }
 
-Mapping::Mapping(VkDevice vkDevice, DescriptorSet&& descriptorSet, CommandBuffer&& commandBuffer, Batch&& batch, Mappings::slice_type&& slice, uint32_t maxComputeWorkGroupCount, QueryPoolTimer&& queryPoolTimer):
-    m_vkResult( VK_RESULT_MAX_ENUM ),
+Mapping::Mapping(VkDevice vkDevice, DescriptorSet&& descriptorSet, CommandBuffer&& commandBuffer, CommandBuffer&& uploadCommandBuffer, Batch&& batch, Mappings::slice_type&& slice, uint32_t maxComputeWorkGroupCount, QueryPoolTimer&& queryPoolTimer):
+    m_vkResult( VK_SUCCESS ),
     m_vkDevice( vkDevice ),
-    m_vkFence( VK_NULL_HANDLE ),
     m_descriptorSet( ::std::move( descriptorSet ) ),
     m_commandBuffer( ::std::move( commandBuffer ) ),
+    m_uploadCommandBuffer( ::std::move( uploadCommandBuffer ) ),
     m_batch( ::std::move( batch ) ),
     m_slice( ::std::move( slice ) ),
     m_maxComputeWorkGroupCount( maxComputeWorkGroupCount ),
     m_queryPoolTimer( ::std::move( queryPoolTimer ) ) {
 
-    // Create the fence
-    VkFenceCreateInfo vkFenceCreateInfo = {};
-    vkFenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    m_vkResult = ::vkCreateFence( m_vkDevice, &vkFenceCreateInfo, VK_NULL_HANDLE, &m_vkFence );
+    m_point.vkSemaphore = VK_NULL_HANDLE;
+    m_point.value = 0U;
 }
 
 Mapping& Mapping::operator=(Mapping&& mapping) {
@@ -119,9 +158,10 @@ Mapping& Mapping::operator=(Mapping&& mapping) {
 
         m_vkResult = mapping.m_vkResult;
         m_vkDevice = mapping.m_vkDevice;
-        m_vkFence = mapping.m_vkFence;
+        m_point = mapping.m_point;
         m_descriptorSet = ::std::move( mapping.m_descriptorSet );
         m_commandBuffer = ::std::move( mapping.m_commandBuffer );
+        m_uploadCommandBuffer = ::std::move( mapping.m_uploadCommandBuffer );
         m_batch = ::std::move( mapping.m_batch );
         m_slice = ::std::move( mapping.m_slice );
         m_maxComputeWorkGroupCount = mapping.m_maxComputeWorkGroupCount;
@@ -132,43 +172,80 @@ Mapping& Mapping::operator=(Mapping&& mapping) {
     return (*this);
 }
 
-VkResult Mapping::Dispatch(VkQueue vkQueue, vkmr::Pipeline& pipeline) {
-
-    // Reset the fence
-    m_vkResult = ::vkResetFences( m_vkDevice, 1, &m_vkFence );
-    if (m_vkResult != VK_SUCCESS){
-        return m_vkResult;
+VkResult Mapping::Dispatch(DeviceQueue& queue, DeviceQueue& transferQueue, vkmr::Pipeline& pipeline, const Fold* pFold, ::std::vector<TimelinePoint> waits) {
+
+    // Upload the batch first, if need be, for the mapping to wait on
+    if (m_batch.Uploads( )){
+        auto vkUploadCommandBuffer = *m_uploadCommandBuffer;
+        VkCommandBufferBeginInfo vkCommandBufferBeginInfo = {};
+        vkCommandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        vkCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        m_vkResult = ::vkBeginCommandBuffer( vkUploadCommandBuffer, &vkCommandBufferBeginInfo );
+        if (m_vkResult == VK_SUCCESS){
+            VkMemoryBarrier2KHR host2CopyMemB = {};
+            host2CopyMemB.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            host2CopyMemB.srcStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
+            host2CopyMemB.srcAccessMask = VK_ACCESS_2_HOST_WRITE_BIT_KHR;
+            host2CopyMemB.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+            host2CopyMemB.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+            VkDependencyInfoKHR host2CopyDep = {};
+            host2CopyDep.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            host2CopyDep.memoryBarrierCount = 1;
+            host2CopyDep.pMemoryBarriers = &host2CopyMemB;
+            g_pVkCmdPipelineBarrier2KHR( vkUploadCommandBuffer, &host2CopyDep );
+
+            m_batch.CmdUpload( vkUploadCommandBuffer );
+            m_vkResult = ::vkEndCommandBuffer( vkUploadCommandBuffer );
+        }
+        if (m_vkResult == VK_SUCCESS){
+            TimelinePoint uploaded = {};
+            m_vkResult = transferQueue.Submit( vkUploadCommandBuffer, ::std::vector<TimelinePoint>( ), uploaded );
+            waits.push_back( uploaded );
+        }
+        if (m_vkResult != VK_SUCCESS){
+            return m_vkResult;
+        }
     }
 
-     // Update the descriptor set
-    const auto batchBufferDescriptors = m_batch.BufferDescriptors( );
-    const auto sliceBufferDescriptor = m_slice.BufferDescriptor( );
-    VkWriteDescriptorSet vkWriteDescriptorSetInputs = {};
-    vkWriteDescriptorSetInputs.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    vkWriteDescriptorSetInputs.dstSet = *m_descriptorSet;
-    vkWriteDescriptorSetInputs.descriptorCount = 1;
-    vkWriteDescriptorSetInputs.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    vkWriteDescriptorSetInputs.pBufferInfo = &(batchBufferDescriptors.vkDescriptorBufferInputs);
-    VkWriteDescriptorSet vkWriteDescriptorSetMetadata = {};
-    vkWriteDescriptorSetMetadata.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    vkWriteDescriptorSetMetadata.dstSet = *m_descriptorSet;
-    vkWriteDescriptorSetMetadata.dstBinding = 1;
-    vkWriteDescriptorSetMetadata.descriptorCount = 1;
-    vkWriteDescriptorSetMetadata.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    vkWriteDescriptorSetMetadata.pBufferInfo = &(batchBufferDescriptors.vkDescriptorBufferMetdata);
-    VkWriteDescriptorSet vkWriteDescriptorSetResults = {};
-    vkWriteDescriptorSetResults.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    vkWriteDescriptorSetResults.dstSet = *m_descriptorSet;
-    vkWriteDescriptorSetResults.dstBinding = 2;
-    vkWriteDescriptorSetResults.descriptorCount = 1;
-    vkWriteDescriptorSetResults.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    vkWriteDescriptorSetResults.pBufferInfo = &(sliceBufferDescriptor);
-    VkWriteDescriptorSet vkWriteDescriptorSets[] = {
-        vkWriteDescriptorSetInputs,
-        vkWriteDescriptorSetMetadata,
-        vkWriteDescriptorSetResults
-    };
-    ::vkUpdateDescriptorSets( m_vkDevice, 3, vkWriteDescriptorSets, 0, VK_NULL_HANDLE );
+    // Update the descriptor set, unless the batch holds leaves which are just copied
+    // (rather than folded, if they are to be); descriptors can't be empty, though
+    auto batchBufferDescriptors = m_batch.BufferDescriptors( );
+    const auto copied = (m_batch.Hashed( ) && (pFold == nullptr));
+    if (!copied){
+        if (batchBufferDescriptors.vkDescriptorBufferInputs.range == 0U){
+            batchBufferDescriptors.vkDescriptorBufferInputs.range = VK_WHOLE_SIZE;
+        }
+        if (batchBufferDescriptors.vkDescriptorBufferMetdata.range == 0U){
+            batchBufferDescriptors.vkDescriptorBufferMetdata.range = VK_WHOLE_SIZE;
+        }
+        const auto sliceBufferDescriptor = m_slice.BufferDescriptor( );
+        VkWriteDescriptorSet vkWriteDescriptorSetInputs = {};
+        vkWriteDescriptorSetInputs.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        vkWriteDescriptorSetInputs.dstSet = *m_descriptorSet;
+        vkWriteDescriptorSetInputs.descriptorCount = 1;
+        vkWriteDescriptorSetInputs.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        vkWriteDescriptorSetInputs.pBufferInfo = &(batchBufferDescriptors.vkDescriptorBufferInputs);
+        VkWriteDescriptorSet vkWriteDescriptorSetMetadata = {};
+        vkWriteDescriptorSetMetadata.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        vkWriteDescriptorSetMetadata.dstSet = *m_descriptorSet;
+        vkWriteDescriptorSetMetadata.dstBinding = 1;
+        vkWriteDescriptorSetMetadata.descriptorCount = 1;
+        vkWriteDescriptorSetMetadata.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        vkWriteDescriptorSetMetadata.pBufferInfo = &(batchBufferDescriptors.vkDescriptorBufferMetdata);
+        VkWriteDescriptorSet vkWriteDescriptorSetResults = {};
+        vkWriteDescriptorSetResults.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        vkWriteDescriptorSetResults.dstSet = *m_descriptorSet;
+        vkWriteDescriptorSetResults.dstBinding = 2;
+        vkWriteDescriptorSetResults.descriptorCount = 1;
+        vkWriteDescriptorSetResults.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        vkWriteDescriptorSetResults.pBufferInfo = &(sliceBufferDescriptor);
+        VkWriteDescriptorSet vkWriteDescriptorSets[] = {
+            vkWriteDescriptorSetInputs,
+            vkWriteDescriptorSetMetadata,
+            vkWriteDescriptorSetResults
+        };
+        ::vkUpdateDescriptorSets( m_vkDevice, 3, vkWriteDescriptorSets, 0, VK_NULL_HANDLE );
+    }
 
     // Update the command buffer
     auto vkCommandBuffer = *m_commandBuffer;
@@ -178,86 +255,146 @@ VkResult Mapping::Dispatch(VkQueue vkQueue, vkmr::Pipeline& pipeline) {
     m_vkResult = ::vkBeginCommandBuffer( vkCommandBuffer, &vkCommandBufferBeginInfo );
     if (m_vkResult == VK_SUCCESS){
         m_queryPoolTimer.Start( vkCommandBuffer );
-        ::vkCmdBindPipeline( vkCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline );
-
-        VkDescriptorSet descriptorSets[] = { *m_descriptorSet };
-        ::vkCmdBindDescriptorSets( vkCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.Layout( ), 0, 1, descriptorSets, 0, VK_NULL_HANDLE );
-
-        // c.f. https://github.com/KhronosGroup/Vulkan-Docs/wiki/Synchronization-Examples#cpu-read-back-of-data-written-by-a-compute-shader
-        VkMemoryBarrier2KHR host2ShaderMemB = {};
-        host2ShaderMemB.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
-        host2ShaderMemB.srcStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
-        host2ShaderMemB.srcAccessMask = VK_ACCESS_2_HOST_WRITE_BIT_KHR;
-        host2ShaderMemB.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
-        host2ShaderMemB.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
-        VkDependencyInfoKHR host2ShaderDep = {};
-        host2ShaderDep.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-        host2ShaderDep.memoryBarrierCount = 1;
-        host2ShaderDep.pMemoryBarriers = &host2ShaderMemB;
-        g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &host2ShaderDep );
-
-        // Split into as many dispatches as are needed
-        const auto bound = static_cast<uint>( m_batch.Count( ) );
-        const auto& workgroupSize = pipeline.GetWorkGroupSize( );
-        const auto count = workgroupSize.GetGroupCountX( bound );
-        for (auto remaining = count; remaining > 0U; ){
-            const auto x = ::std::min(
-                remaining,
-                m_maxComputeWorkGroupCount
-            );
-
-            // Push the constants
-            MappingPushConstants pc = { 0U };
-            pc.offset = workgroupSize.x * (count - remaining);
-            pc.bound = m_batch.Count( );
-            ::vkCmdPushConstants( vkCommandBuffer, pipeline.Layout( ), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pc ), &pc );
-
-            // Actually dispatch the shader invocations
-            ::vkCmdDispatch( vkCommandBuffer, x, 1, 1 );
-
-            // Advance
-            remaining -= x;
+        if (copied){
+            // Copy the leaves straight into the slice
+            VkMemoryBarrier2KHR host2CopyMemB = {};
+            host2CopyMemB.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            host2CopyMemB.srcStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
+            host2CopyMemB.srcAccessMask = VK_ACCESS_2_HOST_WRITE_BIT_KHR;
+            host2CopyMemB.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+            host2CopyMemB.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+            VkDependencyInfoKHR host2CopyDep = {};
+            host2CopyDep.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            host2CopyDep.memoryBarrierCount = 1;
+            host2CopyDep.pMemoryBarriers = &host2CopyMemB;
+            g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &host2CopyDep );
+
+            VkBufferCopy vkBufferCopy = {};
+            vkBufferCopy.size = batchBufferDescriptors.vkDescriptorBufferInputs.range;
+            ::vkCmdCopyBuffer( vkCommandBuffer, batchBufferDescriptors.vkDescriptorBufferInputs.buffer, m_slice.Buffer( ), 1, &vkBufferCopy );
+        }else{
+            ::vkCmdBindPipeline( vkCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline );
+
+            VkDescriptorSet descriptorSets[] = { *m_descriptorSet };
+            ::vkCmdBindDescriptorSets( vkCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.Layout( ), 0, 1, descriptorSets, 0, VK_NULL_HANDLE );
+
+            // c.f. https://github.com/KhronosGroup/Vulkan-Docs/wiki/Synchronization-Examples#cpu-read-back-of-data-written-by-a-compute-shader
+            VkMemoryBarrier2KHR host2ShaderMemB = {};
+            host2ShaderMemB.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            host2ShaderMemB.srcStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
+            host2ShaderMemB.srcAccessMask = VK_ACCESS_2_HOST_WRITE_BIT_KHR;
+            host2ShaderMemB.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+            host2ShaderMemB.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
+            VkDependencyInfoKHR host2ShaderDep = {};
+            host2ShaderDep.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            host2ShaderDep.memoryBarrierCount = 1;
+            host2ShaderDep.pMemoryBarriers = &host2ShaderMemB;
+            g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &host2ShaderDep );
+
+            // Split into as many dispatches as are needed
+            const auto bound = static_cast<uint>( m_batch.Count( ) );
+            const auto& workgroupSize = pipeline.GetWorkGroupSize( );
+            if (pFold){
+                // Each invocation takes a pair of leaves, starting with those already in the slice ahead
+                // of the batch's in its group, and folds them with those of the rest of its (sub)group;
+                // that should match the first pass of the reduction, if this is the last of the batches
+                FusedMappingPushConstants pc = { 0U };
+                pc.bound = bound;
+                pc.head = pFold->head;
+                pc.pairs = pFold->last
+                    ? ::std::min( HalfEven( pFold->applicable ), workgroupSize.x )
+                    : workgroupSize.x;
+                pc.fold = (pFold->last && (pFold->applicable > 1U)) ? 1U : 0U;
+                pc.hashed = m_batch.Hashed( ) ? 1U : 0U;
+                pc.stride = m_batch.Lanes( );
+
+                const auto count = workgroupSize.GetGroupCountX( HalfEven( pc.head + bound ) );
+                for (auto remaining = count; remaining > 0U; ){
+                    const auto x = ::std::min( remaining, m_maxComputeWorkGroupCount );
+
+                    // Push the constants, and dispatch
+                    pc.offset = workgroupSize.x * (count - remaining);
+                    ::vkCmdPushConstants( vkCommandBuffer, pipeline.Layout( ), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pc ), &pc );
+                    ::vkCmdDispatch( vkCommandBuffer, x, 1, 1 );
+                    remaining -= x;
+                }
+            }else{
+                // Dispatch the inputs bucket by bucket, if they were sorted into them (so that those in each
+                // (sub)group span about as many blocks as each other), packing several of the smallest into
+                // each invocation; otherwise, all at once. The buckets write out disjoint sets of leaves
+                auto buckets = m_batch.Buckets( );
+                if (buckets.empty( )){
+                    Batch::Bucket all = { 0U, bound, 0U };
+                    buckets.push_back( all );
+                }
+                for (auto it = buckets.cbegin( ), end = buckets.cend( ); it != end; ++it){
+                    MappingPushConstants pc = { 0U };
+                    pc.bound = it->start + it->count;
+                    pc.stride = m_batch.Lanes( );
+                    pc.start = it->start;
+                    pc.pack = (it->blocks == 1U) ? PackedInputs : 1U;
+
+                    const auto count = workgroupSize.GetGroupCountX( (it->count + pc.pack - 1U) / pc.pack );
+                    for (auto remaining = count; remaining > 0U; ){
+                        const auto x = ::std::min(
+                            remaining,
+                            m_maxComputeWorkGroupCount
+                        );
+
+                        // Push the constants
+                        pc.offset = workgroupSize.x * (count - remaining);
+                        ::vkCmdPushConstants( vkCommandBuffer, pipeline.Layout( ), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pc ), &pc );
+
+                        // Actually dispatch the shader invocations
+                        ::vkCmdDispatch( vkCommandBuffer, x, 1, 1 );
+
+                        // Advance
+                        remaining -= x;
+                    }
+                }
+            }
         }
         m_queryPoolTimer.Finish( vkCommandBuffer );
         m_vkResult = ::vkEndCommandBuffer( vkCommandBuffer );
     }   
-    VkCommandBuffer commandBuffers[] = { vkCommandBuffer };
-
-    // Submit the (presumably previously-recordded) commands onto the queue
-    VkSubmitInfo vkSubmitInfo = {};
-    vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    vkSubmitInfo.commandBufferCount = 1;
-    vkSubmitInfo.pCommandBuffers = commandBuffers;
-    return (m_vkResult = ::vkQueueSubmit( vkQueue, 1, &vkSubmitInfo, m_vkFence ));
+    if (m_vkResult != VK_SUCCESS){
+        return m_vkResult;
+    }
+
+    // Submit the commands onto the queue, to advance its timeline once done
+    return (m_vkResult = queue.Submit( vkCommandBuffer, waits, m_point ));
 }
 
 void Mapping::Reset(void) {
     m_vkResult = VK_RESULT_MAX_ENUM;
     m_vkDevice = VK_NULL_HANDLE;
-    m_vkFence = VK_NULL_HANDLE;
+    m_point.vkSemaphore = VK_NULL_HANDLE;
+    m_point.value = 0U;
     m_maxComputeWorkGroupCount = 0U;
 }
 
 void Mapping::Release(void) {
 
-    if (m_vkFence != VK_NULL_HANDLE){
-        ::vkDestroyFence( m_vkDevice, m_vkFence, VK_NULL_HANDLE );
-    }
     m_descriptorSet = DescriptorSet( );
     m_commandBuffer = CommandBuffer( );
+    m_uploadCommandBuffer = CommandBuffer( );
     m_queryPoolTimer = QueryPoolTimer( );
     Reset( );
 }
 
 class MappingsImpl : public Mappings {
 public:
-    MappingsImpl(ComputeDevice& device, uint32_t capacity, vkmr::Pipeline&& pipeline):
+    MappingsImpl(ComputeDevice& device, uint32_t capacity, vkmr::Pipeline&& pipeline, uint32_t foldSize, bool sorted):
         m_vkDevice( *device ),
         m_capacity( capacity ),
+        m_foldSize( foldSize ),
+        m_sorted( sorted ),
         m_descriptorPool( device.CreateDescriptorPool( capacity, 3 * capacity ) ), // 1 set per potential concurrent mapping op
         m_commandPool( device.CreateCommandPool( ) ),
+        m_transferCommandPool( device.CreateTransferCommandPool( ) ),
         m_pipeline( ::std::move( pipeline ) ),
-        m_queryPoolTimers( device ) {
+        m_queryPoolTimers( device ),
+        m_elapsed( 0.0 ) {
 
         VkPhysicalDeviceProperties vkPhysicalDeviceProperties = {};
         ::vkGetPhysicalDeviceProperties( device.PhysicalDevice( ), &vkPhysicalDeviceProperties );
@@ -269,29 +406,60 @@ public:
         m_container.clear( );
         m_descriptorPool = DescriptorPool( );
         m_commandPool = CommandPool( );
+        m_transferCommandPool = CommandPool( );
         m_pipeline = Pipeline( );
         m_queryPoolTimers = QueryPoolTimers( );
     }
 
-    VkResult Map(Batch&&, Slice<VkSha256Result>&&, VkQueue);
+    VkResult Map(Batch&&, Slice<VkSha256Result>&&, DeviceQueue&, DeviceQueue&, const Fold&);
+
+    uint32_t FoldSize(void) const { return m_foldSize; }
+
+    void Update(Batches&);
+
+    void WaitForAny(Batches& batches) { this->Wait( batches, VK_FALSE ); }
+
+    void WaitFor(Batches& batches) { this->Wait( batches, VK_TRUE ); }
+
+    bool Has(void) const { return !m_container.empty( ); }
 
-    ::std::vector<slice_type> Update(void);
+    double Elapsed(void) const { return m_elapsed; }
 
-    void WaitFor(void);
+    ::std::vector<TimelinePoint> Pending(slice_type::number_type) const;
 
 private:
+    // Waits on any (or all) of the in-flight mappings, and then updates
+    void Wait(Batches&, VkBool32);
+
     VkDevice m_vkDevice;
-    uint32_t m_maxComputeWorkGroupCount, m_capacity;
+    uint32_t m_maxComputeWorkGroupCount, m_capacity, m_foldSize;
+
+    // Indicates whether the batches are sorted into buckets before being mapped
+    bool m_sorted;
 
     DescriptorPool m_descriptorPool;
-    CommandPool m_commandPool;
+    CommandPool m_commandPool, m_transferCommandPool;
     vkmr::Pipeline m_pipeline;
     QueryPoolTimers m_queryPoolTimers;
 
     ::std::vector<Mapping> m_container;
+
+    // The time spent on the device by the mappings which have completed
+    double m_elapsed;
 };
 
-VkResult MappingsImpl::Map(Batch&& batch, Slice<VkSha256Result>&& slice, VkQueue queue) {
+VkResult MappingsImpl::Map(Batch&& batch, Slice<VkSha256Result>&& slice, DeviceQueue& queue, DeviceQueue& transferQueue, const Fold& fold) {
+
+    // Leaves left as-is by the mapping(s) before this one, to fold in, must be there first
+    const auto folding = (m_foldSize > 0U);
+    const auto waits = (folding && (fold.head > 0U))
+        ? this->Pending( slice.Number( ) )
+        : ::std::vector<TimelinePoint>( );
+
+    // Sort the inputs by size, unless folding (which needs the leaves in order), before uploading them
+    if (m_sorted && !folding){
+        batch.Sort( );
+    }
 
     // Descriptor sets is the limiting factor on the number of potential in-flight mappings
     const auto ok = (m_container.size( ) < m_capacity);
@@ -303,6 +471,7 @@ VkResult MappingsImpl::Map(Batch&& batch, Slice<VkSha256Result>&& slice, VkQueue
             m_vkDevice,
             ::std::move( descriptorSet ),
             m_commandPool.AllocateCommandBuffer( ),
+            batch.Uploads( ) ? m_transferCommandPool.AllocateCommandBuffer( ) : CommandBuffer( ),
             ::std::move( batch ),
             ::std::move( slice ),
             m_maxComputeWorkGroupCount,
@@ -312,59 +481,74 @@ VkResult MappingsImpl::Map(Batch&& batch, Slice<VkSha256Result>&& slice, VkQueue
     if (ok){
         // Dispatch the mapping onto the queue
         auto& mapping = m_container.back( );
-        return mapping.Dispatch( queue, m_pipeline );
+        return mapping.Dispatch( queue, transferQueue, m_pipeline, folding ? &fold : nullptr, waits );
     }
     return VK_ERROR_OUT_OF_POOL_MEMORY;
 }
 
-::std::vector<Mappings::slice_type> MappingsImpl::Update(void) {
+void MappingsImpl::Update(Batches& batches) {
 
-    ::std::vector<Mappings::slice_type> slices;
+    // Read the timeline(s) once, rather than polling each mapping
+    TimelineSnapshot snapshot( m_vkDevice );
     for (auto it = m_container.begin( ); it != m_container.end( ); ) {
-        // Get the current status
-        auto status = ::vkGetFenceStatus( m_vkDevice, static_cast<VkFence>( *it ) );
-        if (status == VK_SUCCESS){
+        if (snapshot.Reached( it->Point( ) )){
             // Retire the mapping by removing from the vector
             auto mapping = ::std::move( *it );
             it = m_container.erase( it );
 
-            // Accumulate the slice
-            slices.push_back( ::std::move( mapping.MoveSlice( ) ) );
-            const auto& batch = mapping.Subject( );
-
             // Output
-            const auto& sub = slices.back( );
+            const auto& sub = mapping.Target( );
+            const auto& batch = mapping.Subject( );
             std::cout << "Mapping for slice #" << sub.Number( ) << " (" << sub.Reserved( ) << " item(s); " << batch.Size( ) << " byte(s)) finished";
             auto elapsed = mapping.Timer( ).ElapsedMillis( );
             if (elapsed != 0){
                 ::std::cout << " in " << elapsed << "ms";
+                if (!batch.Hashed( )){
+                    // Give the rate at which the inputs were read, to compare the layouts by
+                    ::std::cout << " (" << (static_cast<double>( batch.Size( ) ) / (elapsed * 1000.0)) << "MB/s";
+                    ::std::cout << ((batch.Lanes( ) > 1U) ? ", interleaved" : "") << ")";
+                }
+                m_elapsed += elapsed;
             }
             ::std::cout << "." << ::std::endl;
+
+            // Hand back the batch, for reuse
+            batches.Recycle( mapping.MoveBatch( ) );
         }else{
             // Check again later; for now, just advance
             ++it;
         }
     }
-    return slices;
 }
 
-void MappingsImpl::WaitFor(void) {
+void MappingsImpl::Wait(Batches& batches, VkBool32 vkWaitAll) {
 
-    // Get the in-flight mappings as a vector of fences
-    ::std::vector<VkFence> fences;
+    // Get the in-flight mappings as points on the timeline(s)
+    ::std::vector<TimelinePoint> points;
     for (auto it = m_container.cbegin( ), end = m_container.cend( ); it != end; ++it) {
-        fences.push_back( static_cast<VkFence>( *it ) );
+        points.push_back( it->Point( ) );
     }
-    if (fences.empty( )){
+    if (points.empty( )){
         return;
     }
 
-    // Wait on them all
-    ::vkWaitForFences( m_vkDevice, fences.size( ), fences.data( ), VK_TRUE, UINT64_MAX );
-    this->Update( );
+    // Wait on them
+    DeviceQueue::WaitFor( m_vkDevice, points, vkWaitAll );
+    this->Update( batches );
+}
+
+::std::vector<TimelinePoint> MappingsImpl::Pending(slice_type::number_type number) const {
+
+    ::std::vector<TimelinePoint> points;
+    for (auto it = m_container.cbegin( ), end = m_container.cend( ); it != end; ++it) {
+        if (it->Number( ) == number){
+            points.push_back( it->Point( ) );
+        }
+    }
+    return points;
 }
 
-::std::unique_ptr<Mappings> Mappings::New(ComputeDevice& device, uint32_t capacity) {
+::std::unique_ptr<Mappings> Mappings::New(ComputeDevice& device, uint32_t capacity, uint32_t foldSize) {
 
     // Look for an early out
     ::std::unique_ptr<Mappings> mappings;
@@ -377,8 +561,13 @@ void MappingsImpl::WaitFor(void) {
     const VkAllocationCallbacks *pAllocator = VK_NULL_HANDLE;
 
     // Load the shader code, wrap it in a module, etc
-    ShaderModule shaderModule( vkDevice, "SHA-256-n.spv" );
+    const auto fused = (foldSize > 0U);
+    ShaderModule shaderModule( vkDevice, fused ? "SHA-256-n-fused.spv" : "SHA-256-n.spv" );
     auto vkResult = static_cast<VkResult>( shaderModule );
+    if (fused && (vkResult != VK_SUCCESS)){
+        ::std::cerr << "Failed to load the shader for fused mapping; leaves will not be folded." << ::std::endl;
+        return Mappings::New( device, capacity );
+    }
 
     // Create the descriptor set layout
     VkDescriptorSetLayout vkDescriptorSetLayout = VK_NULL_HANDLE;
@@ -411,7 +600,11 @@ void MappingsImpl::WaitFor(void) {
 
     WorkgroupSize workgroupSize;
     workgroupSize.x = workgroupSize.y = workgroupSize.z = 1;
-    if (vkResult == VK_SUCCESS){
+    if (fused){
+        // Each (sub)group folds twice as many leaves as it has invocations
+        workgroupSize.x = (foldSize >> 1);
+        workgroupSize.bySubgroup = true;
+    }else if (vkResult == VK_SUCCESS){
         // Query for the device limits
         VkPhysicalDeviceProperties2KHR vkPhysicalDeviceProperties2 = {};
         vkPhysicalDeviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
@@ -422,14 +615,25 @@ void MappingsImpl::WaitFor(void) {
             vkPhysicalDeviceProperties2.properties.limits.maxComputeWorkGroupSize[0],
             vkPhysicalDeviceProperties2.properties.limits.maxComputeWorkGroupInvocations
         );
+
+        // Go with the size found (by autotuning) to be the fastest instead, if any
+        const auto tuned = device.GetTuning( ).mappingWorkgroupSize;
+        if (tuned > 0U){
+            workgroupSize.x = ::std::min( workgroupSize.x, tuned );
+        }
     }
 
+    // Have the batches sorted into buckets by size before they're mapped (where not
+    // folding), unless asked not to (via VKMR_BUCKETED_BATCHES=0)
+    const char* bucketed = ::std::getenv( "VKMR_BUCKETED_BATCHES" );
+    const auto sorted = !fused && ((bucketed == nullptr) || (::std::strcmp( bucketed, "0" ) != 0));
+
     // Wrap it all up, maybe
     if (vkResult == VK_SUCCESS){
         VkPushConstantRange vkPushConstantRange = {};
         vkPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
         vkPushConstantRange.offset = 0;
-        vkPushConstantRange.size = sizeof( MappingPushConstants );
+        vkPushConstantRange.size = fused ? sizeof( FusedMappingPushConstants ) : sizeof( MappingPushConstants );
         mappings.reset( new MappingsImpl(
             device,
             capacity,
@@ -438,8 +642,11 @@ void MappingsImpl::WaitFor(void) {
                 vkDescriptorSetLayout,
                 vkmr::Pipeline::NewSimpleLayout( vkDevice, vkDescriptorSetLayout, &vkPushConstantRange ),
                 ::std::move( shaderModule ),
-                &workgroupSize
-            )
+                &workgroupSize,
+                device.GetPipelineCache( )
+            ),
+            foldSize,
+            sorted
         ) );
     }
     return mappings;
@@ -8,7 +8,9 @@
 //
 
 // C++ Standard Library Headers
+#include <map>
 #include <memory>
+#include <vector>
 
 // Local Project Headers
 #include "Slices.h"
@@ -16,6 +18,19 @@
 #include "ISha256D.h"
 
 namespace vkmr {
+// Types
+//
+
+// Describes where a batch falls in the slice into which it is mapped, for mappings which fold the
+// leaves they hash into the roots of the sub-trees of the groups of them: the number of leaves in
+// the group before the batch's, already in the slice, and whether the batch is the last in the
+// slice (and, so, the number of leaves the slice is reduced as if it holds is known)
+struct Fold {
+    uint32_t head;
+    bool last;
+    uint32_t applicable;
+};
+
 // Classes
 //
 
@@ -26,15 +41,39 @@ public:
 
     virtual ~Mappings(void) = default;
 
-    virtual VkResult Map(Batch&&, slice_type&&, VkQueue) = 0;
+    // Maps the given batch into the given (sub) slice, on the first of the given queues, having uploaded
+    // it on the second, if need be; where the mappings fold, the sub slice starts with the leaves
+    // in the group before the batch's
+    virtual VkResult Map(Batch&&, slice_type&&, DeviceQueue&, DeviceQueue&, const Fold&) = 0;
+
+    // Returns the number of leaves which each mapping folds into the root
+    // of their sub-tree, group by group, or 0 if they don't fold
+    virtual uint32_t FoldSize(void) const = 0;
 
-    // Updates the status of in-flight mappings
-    virtual ::std::vector<slice_type> Update(void) = 0;
+    // Updates the status of in-flight mappings, handing back the
+    // batches of any which have completed
+    virtual void Update(Batches&) = 0;
+
+    // Synchronously waits for any one in-flight mapping to complete
+    virtual void WaitForAny(Batches&) = 0;
 
     // Synchronously waits for all in-flight mappings to complete
-    virtual void WaitFor(void) = 0;
+    virtual void WaitFor(Batches&) = 0;
+
+    // Returns true if there are any in-flight mappings
+    virtual bool Has(void) const = 0;
+
+    // Returns the time spent on the device by the mappings which have completed, in ms,
+    // going by their timers (i.e. 0 if the device doesn't time them)
+    virtual double Elapsed(void) const = 0;
+
+    // Returns the points on the timeline(s) of the queue(s) at which the
+    // in-flight mappings into the slice with the given number complete
+    virtual ::std::vector<TimelinePoint> Pending(slice_type::number_type) const = 0;
 
-    static ::std::unique_ptr<Mappings> New(ComputeDevice&, uint32_t);
+    // Creates the mappings, folding groups of the given number of leaves (if not 0), with
+    // the fused shader, if it can be loaded; otherwise, writing out every leaf
+    static ::std::unique_ptr<Mappings> New(ComputeDevice&, uint32_t, uint32_t = 0U);
 };
 
 // Encapsulates reductions of slices of device memory to a single value
@@ -44,14 +83,52 @@ public:
 
     virtual ~Reductions(void) = default;
 
-    // Initiates a new reduction of the given slice of on-device memory
-    virtual VkResult Reduce(slice_type&&, ComputeDevice&) = 0;
+    // Initiates a new reduction of the given slice of on-device memory, to
+    // start (on the device) once the given points have been reached
+    virtual VkResult Reduce(slice_type&&, ComputeDevice&, const ::std::vector<TimelinePoint>&) = 0;
+
+    // Updates the status of in-progress reductions, kicking off the
+    // reductions of any slices of their roots which they have filled,
+    // and handing back the slices which they have finished with
+    virtual void Update(ComputeDevice&, Slices<VkSha256Result>&) = 0;
+
+    // Synchronously waits for any one in-progress reduction to conclude
+    virtual void WaitForAny(ComputeDevice&, Slices<VkSha256Result>&) = 0;
+
+    // Synchronously waits for all reductions to conclude, and then reduces
+    // their roots (on the device) to the root of the whole tree
+    virtual ISha256D::out_type WaitFor(ComputeDevice&, Slices<VkSha256Result>&) = 0;
+
+    // Returns true if there are any in-progress reductions
+    virtual bool Has(void) const = 0;
+
+    // Returns the time spent on the device by the reductions which have concluded, in ms,
+    // going by their timers (i.e. 0 if the device doesn't time them)
+    virtual double Elapsed(void) const = 0;
+
+    // Returns the number of leaves which the first pass of each reduction of a slice
+    // of them reduces to a root, group by group, if mappings can fold them in its
+    // stead (i.e. if reducing by subgroup), or else 0
+    virtual uint32_t FoldSize(void) const = 0;
+
+    // Sets whether the slices of leaves have been folded by their mappings,
+    // such that the first pass of the reductions of them is skipped
+    virtual void Folded(bool) = 0;
+
+    // Sets whether the root of each slice of leaves is read back to the host by itself (i.e. as
+    // that of one shard of a tree spread across devices), rather than reduced any further
+    virtual void Sharded(bool) = 0;
+
+    // Returns the roots of the slices of leaves which have been read back, by slice number
+    virtual const ::std::map<slice_type::number_type, VkSha256Result>& Roots(void) const = 0;
 
-    // Updates the status of in-progress reductions
-    virtual void Update(void) = 0;
+    // Returns the sizes of the subgroups by which the device can reduce slices, the one
+    // used by default first, or nothing if it can't reduce them by subgroup at all
+    static ::std::vector<uint32_t> SubgroupSizes(const ComputeDevice&);
 
-    // Synchronously waits for all reductions to conclude
-    virtual ISha256D::out_type WaitFor(void) = 0;
+    // Returns the size of the largest workgroups by which the device can reduce
+    // slices in shared memory (i.e. where it can't do so by subgroup)
+    static uint32_t MaxWorkgroupSize(const ComputeDevice&);
 
     static ::std::unique_ptr<Reductions> New(ComputeDevice&, typename slice_type::number_type);
 };
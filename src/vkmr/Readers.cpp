@@ -0,0 +1,161 @@
+// Readers.cpp: defines the types, functions and classes for reading input ahead, on other threads
+//
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <iostream>
+#include <utility>
+
+// Local Project Headers
+#include "StopWatch.h"
+
+// Declarations
+#include "Readers.h"
+
+namespace vkmr {
+
+// Classes
+//
+
+Reader::Reader(Input&& input):
+    m_input( ::std::move( input ) ),
+    m_ring( c_ringSize ),
+    m_done( false ),
+    m_stopping( false ),
+    m_truncated( false ),
+    m_reading( 0.0 ),
+    m_stalled( 0.0 ),
+    m_starved( 0.0 ),
+    m_occupancy( 0.0 ),
+    m_taken( 0U ) {
+
+    m_thread = ::std::thread( &Reader::Run, this );
+}
+
+Reader::~Reader(void) {
+
+    m_stopping.store( true, ::std::memory_order_release );
+    Notify( m_writable );
+    if (m_thread.joinable( )){
+        m_thread.join( );
+    }
+}
+
+bool Reader::Next(Records& records) {
+
+    StopWatch sw;
+    bool waited = false;
+    while (true){
+        // Sample how full the ring is, before taking from it
+        const auto size = m_ring.Size( );
+        if (m_ring.TryPop( records )){
+            m_occupancy += static_cast<double>( size ) / m_ring.Capacity( );
+            m_taken++;
+            break;
+        }
+        if (m_done.load( ::std::memory_order_acquire )){
+            // Check again, for anything pushed just before we looked
+            if (!m_ring.TryPop( records )){
+                return false;
+            }
+            m_taken++;
+            break;
+        }
+        if (!waited){
+            sw.Start( );
+            waited = true;
+        }
+
+        // Sleep until there's something to take, or there never will be
+        ::std::unique_lock<::std::mutex> lock( m_mutex );
+        m_readable.wait( lock, [this]() -> bool {
+            return (m_ring.Size( ) > 0U) || m_done.load( ::std::memory_order_acquire );
+        } );
+    }
+    if (waited){
+        m_starved += sw.Elapsed( );
+    }
+
+    // There's space in the ring now, if the reader was waiting on it
+    Notify( m_writable );
+    return true;
+}
+
+Reader::Stats Reader::GetStats(void) const {
+
+    Stats stats = {
+        m_reading,
+        m_stalled,
+        m_starved,
+        (m_taken > 0U) ? (m_occupancy / m_taken) : 0.0
+    };
+    return stats;
+}
+
+void Reader::Run(void) {
+
+    StopWatch total;
+    total.Start( );
+
+    // Hands off the given block, sleeping until there's space in the ring for it if need be
+    auto push = [&](Records& records) -> bool {
+        records.Seal( );
+        if (!m_ring.TryPush( records )){
+            StopWatch sw;
+            sw.Start( );
+            while (!m_ring.TryPush( records )){
+                ::std::unique_lock<::std::mutex> lock( m_mutex );
+                m_writable.wait( lock, [this]() -> bool {
+                    return (m_ring.Size( ) < m_ring.Capacity( )) || m_stopping.load( ::std::memory_order_acquire );
+                } );
+                if (m_stopping.load( ::std::memory_order_acquire )){
+                    return false;
+                }
+            }
+            m_stalled += sw.Elapsed( );
+        }
+        Notify( m_readable );
+        return true;
+    };
+
+    // Records in a mapped file are passed on in place; any others are copied into the block
+    const auto copy = !m_input.Mapped( );
+    Records records;
+    bool ok = true;
+    while (ok && m_input.Has( )){
+        const auto record = m_input.Next( );
+        if (m_input.Truncated( )){
+            m_truncated.store( true, ::std::memory_order_release );
+            break;
+        }
+        if (m_input.Skips( record )){
+            ::std::cerr << "Read an empty string?" << ::std::endl;
+            continue;
+        }
+        records.Push( record, copy );
+        if ((records.Count( ) >= c_blockCount) || (records.bytes >= c_blockSize)){
+            ok = push( records );
+            records.Clear( );
+        }
+    }
+    if (ok && (records.Count( ) > 0U)){
+        push( records );
+    }
+    m_reading = total.Elapsed( );
+    m_done.store( true, ::std::memory_order_release );
+    Notify( m_readable );
+}
+
+void Reader::Notify(::std::condition_variable& cv) {
+
+    // Take the lock, however briefly, so the other end can't miss the signal
+    // between checking the ring and going to sleep
+    {
+        ::std::lock_guard<::std::mutex> lock( m_mutex );
+    }
+    cv.notify_one( );
+}
+
+} // namespace vkmr
@@ -0,0 +1,125 @@
+// Readers.h: declares the types, functions and classes for reading input ahead, on other threads
+//
+
+#ifndef __VKMR_READERS_H__
+#define __VKMR_READERS_H__
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Local Project Headers
+#include "Inputs.h"
+#include "Rings.h"
+
+namespace vkmr {
+
+// Class(es)
+//
+
+// A block of records: either views of them in place (i.e. in a mapped file, which outlives
+// the block), or else copies of them, kept back to back rather than in a string apiece
+struct Records {
+    ::std::vector<Input::Record> records;
+    ::std::vector<char> data;
+    size_t bytes = 0U;
+    bool copied = false;
+
+    // Appends the given record, copying it if asked to (i.e. if it's only valid until the next is read)
+    void Push(const Input::Record& record, bool copy) {
+        records.push_back( record );
+        if (copy){
+            data.insert( data.end( ), record.data, record.data + record.size );
+            copied = true;
+        }
+        bytes += record.size;
+    }
+
+    // Points the records at their copies, if any, once the block is done growing
+    void Seal(void) {
+        if (copied){
+            const char* p = data.data( );
+            for (auto it = records.begin( ), end = records.end( ); it != end; ++it){
+                it->data = p;
+                p += it->size;
+            }
+        }
+    }
+
+    size_t Count(void) const { return records.size( ); }
+
+    void Clear(void) {
+        records.clear( );
+        data.clear( );
+        bytes = 0U;
+        copied = false;
+    }
+};
+
+// Reads the records from an input on a thread of its own, a block at a time,
+// into a ring from which another thread can take them
+class Reader {
+public:
+    typedef Ring<Records> ring_type;
+
+    // How long each end of the ring spent waiting on the other, in milliseconds,
+    // and how full the ring was (on average) whenever a block was taken
+    struct Stats {
+        double reading, stalled, starved, occupancy;
+    };
+
+    Reader(Input&&);
+    Reader(Reader const&) = delete;
+    ~Reader(void);
+
+    Reader& operator=(Reader const&) = delete;
+
+    // Waits for, and takes, the next block of records from the
+    // ring; returns false once there are no more to take. The
+    // records are valid for as long as the reader is
+    bool Next(Records&);
+
+    // Returns true if the input ended part-way through a record
+    bool Truncated(void) const { return m_truncated.load( ::std::memory_order_acquire ); }
+
+    // Returns the stats, once all of the records have been taken
+    Stats GetStats(void) const;
+
+    // The number of blocks the ring holds
+    static const size_t c_ringSize = 64U;
+
+private:
+    void Run(void);
+
+    // Wakes whichever end of the ring is waiting on the given condition
+    void Notify(::std::condition_variable&);
+
+    Input m_input;
+    ring_type m_ring;
+    ::std::thread m_thread;
+    ::std::atomic<bool> m_done, m_stopping, m_truncated;
+
+    // Each end of the ring blocks on one of these (rather than spinning) while
+    // it's empty or full, respectively, for the other end to signal
+    ::std::mutex m_mutex;
+    ::std::condition_variable m_readable, m_writable;
+
+    // Written only by the reading thread until it's done, and
+    // then only by the taking thread
+    double m_reading, m_stalled, m_starved, m_occupancy;
+    size_t m_taken;
+
+    // The most records, and bytes, per block
+    static const size_t c_blockCount = 4096U;
+    static const size_t c_blockSize = 1U << 20;
+};
+
+} // namespace vkmr
+
+#endif // __VKMR_READERS_H__
@@ -9,6 +9,9 @@
 #include <cstring>
 #include <iostream>
 #include <utility>
+#include <tuple>
+#include <map>
+#include <algorithm>
 #include <unordered_map>
 
 // Declarations
@@ -17,7 +20,6 @@
 // Local Project Headers
 #include "Debug.h"
 #include "Utils.h"
-#include "SHA-256plus.h"
 #include "QueryPoolTimers.h"
 
 // Externals
@@ -40,7 +42,7 @@ struct alignas(uint) BasicPushConstants {
     uint bound;
 };
 
-struct alignas(uint) BySubgroupPushConstants {
+struct alignas(uint) ByGroupPushConstants {
     uint offset;
     uint pairs;
     uint delta;
@@ -51,36 +53,47 @@ struct alignas(uint) BySubgroupPushConstants {
 // Classes
 //
 
-// An extension of the CPU-based implementation for which
-// the input are already hashed
-class CpuSha256DforReductions : public CpuSha256D {
-public:
-    bool Add(const VkSha256Result&);
-};
-
-bool CpuSha256DforReductions::Add(const VkSha256Result& vkSha256Result) {
-
-    CpuSha256D::node_type leaf;
-    for (uint32_t u = 0U; u < SHA256_WC; ++u){
-        leaf.push_back( vkSha256Result.data[u] );
-    }
-    m_leaves.push_back( leaf );
-    return true;
-}
+class ReductionPlans;
 
 class Reduction {
 public:
+    friend class ReductionPlans;
+
     virtual ~Reduction();
 
     operator VkResult() const { return m_vkResult; }
-    operator VkFence() const { return m_vkFence; }
+
+    // Returns the point on the timeline of the queue reached once the reduction completes
+    const TimelinePoint& Point(void) const {
+        return m_point;
+    }
 
     Reductions::slice_type::number_type Number(void) const {
         return m_slice.Number( );
     }
 
+    // Returns the level in the tree of the slice being reduced (i.e. 0 for the
+    // leaves, 1 for the roots of the slices of leaves, etc)
+    uint32_t Level(void) const {
+        return m_level;
+    }
+
+    // Returns true if the root is to be read back by the host, i.e. if
+    // it is the root of the whole tree, rather than of another slice
+    bool Final(void) const {
+        return (m_vkBufferTarget == VK_NULL_HANDLE);
+    }
+
     VkSha256Result Read(void);
-    VkResult Apply(Reductions::slice_type&&, ComputeDevice&, const vkmr::Pipeline&);
+
+    Reductions::slice_type&& MoveSlice(void) {
+        return ::std::move( m_slice );
+    }
+
+    // Applies the reduction to the given slice (skipping the first pass if its leaves were folded as they were mapped),
+    // once the given points have been reached, writing the root into the given buffer, at the given offset, or else
+    // (if none) into host-visible memory to be read
+    VkResult Apply(Reductions::slice_type&&, ComputeDevice&, vkmr::Pipeline&, ReductionPlans&, uint32_t, bool, const vector<TimelinePoint>&, VkBuffer = VK_NULL_HANDLE, VkDeviceSize = 0U);
 
     virtual double Elapsed(void) {
         return m_queryPoolTimer.ElapsedMillis( );
@@ -88,35 +101,99 @@ public:
 
 protected:
     Reduction();
-    Reduction(VkResult, VkDevice, QueryPoolTimer&&);
+    Reduction(VkResult, VkDevice, CommandBuffer&&, QueryPoolTimer&&);
 
     virtual void Free(void);
-    virtual CommandBuffer& GetCommandBuffer(ComputeDevice&, const vkmr::Pipeline&) = 0;
+
+    // Records the passes which reduce the slice to its root into the given (secondary) command
+    // buffer, with the pipeline bound, splitting dispatches at the given maximum group count
+    virtual VkResult CmdReduce(VkCommandBuffer, const vkmr::Pipeline&, uint32_t) = 0;
 
     uint HalfEven(uint u) {
         return (((u % 2 == 0) ? u : (u+1)) >> 1);
     }
 
+    // Returns the number of elements the slice is reduced as if it holds: every slice
+    // but the first is reduced as if full, so that all of their roots are at the same height
+    uint Applicable(void) const {
+        return static_cast<uint>( m_slice.Number( ) > 1 ? m_slice.Capacity( ) : m_slice.Count( ) );
+    }
+
+    // Records the commands to wait for the roots which were copied into the slice
+    // by the reductions below it, if any, and to copy out the root of the slice
+    void CmdWaitForRoots(VkCommandBuffer);
+    void CmdCopyRoot(VkCommandBuffer);
+
     VkResult m_vkResult;
     VkDevice m_vkDevice;
 
-    VkFence m_vkFence;
+    TimelinePoint m_point;
     VkBuffer m_vkBufferHost;
-    VkDeviceMemory m_vkHostMemory;
+    MemoryRange m_hostMemory;
+
+    uint32_t m_level;
+    bool m_folded;
+    VkBuffer m_vkBufferTarget;
+    VkDeviceSize m_vkTargetOffset;
 
+    CommandBuffer m_commandBuffer;
     QueryPoolTimer m_queryPoolTimer;
     Reductions::slice_type m_slice;
 };
 
-Reduction::Reduction(VkResult vkResult, VkDevice vkDevice, QueryPoolTimer&& queryPoolTimer):
+// Keeps the (secondary) command buffers which reduce slices, each recorded once per shape - i.e. the
+// slice's buffer, its count, the number of elements it is reduced as if it holds and whether it was folded - and
+// executed by every reduction of a slice of that shape thereafter. Slices are recycled, rather
+// than released, so their buffers (and, so, the shapes of all but the last of them) recur
+class ReductionPlans {
+public:
+    ReductionPlans(ComputeDevice&, DescriptorPool&&);
+    ReductionPlans(ReductionPlans const&) = delete;
+    ~ReductionPlans() { this->Clear( ); }
+
+    ReductionPlans& operator=(ReductionPlans const&) = delete;
+
+    // Gets the command buffer which reduces slices shaped like that of the given reduction,
+    // recording it first if need be
+    VkResult Get(Reduction&, vkmr::Pipeline&, VkCommandBuffer&);
+
+    // Discards all of the plans; none may be in use by an in-flight reduction
+    void Clear(void) { m_container.clear( ); }
+
+    size_t Size(void) const { return m_container.size( ); }
+
+private:
+    typedef ::std::tuple<VkBuffer, uint, uint, bool> key_type;
+
+    struct Plan {
+        DescriptorSet descriptorSet;
+        CommandBuffer commandBuffer;
+    };
+
+    VkDevice m_vkDevice;
+    uint32_t m_maxComputeWorkGroupCount;
+
+    DescriptorPool m_descriptorPool;
+    CommandPool m_commandPool;
+    ::std::map<key_type, Plan> m_container;
+};
+
+Reduction::Reduction(VkResult vkResult, VkDevice vkDevice, CommandBuffer&& commandBuffer, QueryPoolTimer&& queryPoolTimer):
     m_vkResult( vkResult ),
     m_vkDevice( vkDevice ),
-    m_vkFence( VK_NULL_HANDLE ),
     m_vkBufferHost( VK_NULL_HANDLE ),
-    m_vkHostMemory( VK_NULL_HANDLE ),
-    m_queryPoolTimer( ::std::move( queryPoolTimer ) ) { }
+    m_level( 0U ),
+    m_folded( false ),
+    m_vkBufferTarget( VK_NULL_HANDLE ),
+    m_vkTargetOffset( 0U ),
+    m_commandBuffer( ::std::move( commandBuffer ) ),
+    m_queryPoolTimer( ::std::move( queryPoolTimer ) ) {
+
+    m_point.vkSemaphore = VK_NULL_HANDLE;
+    m_point.value = 0U;
+}
 
-Reduction::Reduction(): Reduction( VK_RESULT_MAX_ENUM, VK_NULL_HANDLE, QueryPoolTimer( ) ) { }
+Reduction::Reduction(): Reduction( VK_RESULT_MAX_ENUM, VK_NULL_HANDLE, CommandBuffer( ), QueryPoolTimer( ) ) { }
 
 Reduction::~Reduction() {
     this->Free( );
@@ -127,55 +204,54 @@ VkSha256Result Reduction::Read(void) {
     // Default to nothing
     VkSha256Result result = { 0 };
 
-    // Map in the memory, maybe
-    void* pMapped = nullptr;
-    if (m_vkResult == VK_SUCCESS){
-        m_vkResult = ::vkMapMemory( m_vkDevice, m_vkHostMemory, 0U, VK_WHOLE_SIZE, 0, &pMapped );
-    }
-    if (m_vkResult == VK_SUCCESS){
-        const auto pResults = static_cast<uint8_t*>( pMapped );
+    // The memory is kept mapped in by the pool
+    const auto pResults = static_cast<const uint8_t*>( m_hostMemory.Data( ) );
+    if ((m_vkResult == VK_SUCCESS) && pResults){
         ::std::memcpy( &result, pResults, sizeof( VkSha256Result ) );
     }
-
-    // Cleanup & return
-    if (pMapped){
-        ::vkUnmapMemory( m_vkDevice, m_vkHostMemory );
-    }
     return result;
 }
 
-VkResult Reduction::Apply(Reductions::slice_type&& slice, ComputeDevice& device, const vkmr::Pipeline& pipeline) {
+VkResult Reduction::Apply(Reductions::slice_type&& slice, ComputeDevice& device, vkmr::Pipeline& pipeline, ReductionPlans& plans, uint32_t level, bool folded, const vector<TimelinePoint>& waits, VkBuffer vkBufferTarget, VkDeviceSize vkTargetOffset) {
 
-    // Capture the slice internally
+    // Capture the slice (and where its root goes) internally
     m_slice = ::std::move( slice );
+    m_level = level;
+    m_folded = folded;
+    m_vkBufferTarget = vkBufferTarget;
+    m_vkTargetOffset = vkTargetOffset;
 
     // Release any previously-held memory
     this->Free( );
 
-    // Get the (approx) memory requirements
-    const VkMemoryRequirements vkMemoryRequirements = device.StorageBufferRequirements( sizeof( VkSha256Result ) );
+    // Only the root of the whole tree comes back to the host
+    m_vkResult = VK_SUCCESS;
+    if (this->Final( )){
+        // Get the (approx) memory requirements
+        const VkMemoryRequirements vkMemoryRequirements = device.StorageBufferRequirements( sizeof( VkSha256Result ) );
 
-    // Look for some corresponding memory types, and try to allocate
-    const auto memoryBudgets = device.AvailableMemoryTypes(
-        vkMemoryRequirements,
-        (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
-    );
-    for (auto it = memoryBudgets.cbegin( ), end = memoryBudgets.cend( ); it != end; it++){
-        const auto& deviceMemoryBudget = *it;
-        if (deviceMemoryBudget.vkMemoryBudget < vkMemoryRequirements.size){
-            // We're not interested, yet..?
-            continue;
-        }
+        // Look for some corresponding memory types, and try to allocate
+        const auto memoryBudgets = device.AvailableMemoryTypes(
+            vkMemoryRequirements,
+            (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        );
+        for (auto it = memoryBudgets.cbegin( ), end = memoryBudgets.cend( ); it != end; it++){
+            const auto& deviceMemoryBudget = *it;
+            if (deviceMemoryBudget.vkMemoryBudget < vkMemoryRequirements.size){
+                // We're not interested, yet..?
+                continue;
+            }
 
-        // Try and allocate
-        m_vkHostMemory = device.Allocate( deviceMemoryBudget, vkMemoryRequirements.size );
-        if (m_vkHostMemory == VK_NULL_HANDLE){
-            continue;
+            // Try and allocate
+            m_hostMemory = device.Allocate( deviceMemoryBudget, vkMemoryRequirements.size, vkMemoryRequirements.alignment );
+            if (!m_hostMemory){
+                continue;
+            }
+            break;
         }
-        break;
+        m_vkResult = m_hostMemory ? VK_SUCCESS : VK_ERROR_UNKNOWN;
     }
-    m_vkResult = (m_vkHostMemory == VK_NULL_HANDLE) ? VK_ERROR_UNKNOWN : VK_SUCCESS;
-    if (m_vkResult == VK_SUCCESS){
+    if ((m_vkResult == VK_SUCCESS) && this->Final( )){
         // Create a buffer
         VkBufferCreateInfo vkBufferCreateInfo = {};
         vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -189,198 +265,31 @@ VkResult Reduction::Apply(Reductions::slice_type&& slice, ComputeDevice& device,
             &m_vkBufferHost
         );
     }
-    if (m_vkResult == VK_SUCCESS){
+    if ((m_vkResult == VK_SUCCESS) && this->Final( )){
         // Bind the buffer to the memory
-        m_vkResult = ::vkBindBufferMemory( m_vkDevice, m_vkBufferHost, m_vkHostMemory, 0U );
+        m_vkResult = ::vkBindBufferMemory( m_vkDevice, m_vkBufferHost, *m_hostMemory, m_hostMemory.Offset( ) );
     }
-    if (m_vkResult == VK_SUCCESS){
-        // Create a fence
-        VkFenceCreateInfo vkFenceCreateInfo = {};
-        vkFenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        m_vkResult = ::vkCreateFence( m_vkDevice, &vkFenceCreateInfo, VK_NULL_HANDLE, &m_vkFence );
-    }
-    if (m_vkResult == VK_SUCCESS){
-        auto& commandBuffer = this->GetCommandBuffer( device, pipeline );
-        if (m_vkResult == VK_SUCCESS){
-            VkCommandBuffer commandBuffers[] = { *commandBuffer };
-
-            // Submit unto the queue
-            VkSubmitInfo vkSubmitInfo = {};
-            vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            vkSubmitInfo.commandBufferCount = 1;
-            vkSubmitInfo.pCommandBuffers = commandBuffers;
-            m_vkResult = ::vkQueueSubmit( device.Queue( ), 1, &vkSubmitInfo, m_vkFence );
-        }
-    }
-    return m_vkResult; 
-}
-
-void Reduction::Free(void) {
 
-    const VkAllocationCallbacks *pAllocator = VK_NULL_HANDLE;
-    if (m_vkBufferHost != VK_NULL_HANDLE){
-        ::vkDestroyBuffer( m_vkDevice, m_vkBufferHost, pAllocator );
-        m_vkBufferHost = VK_NULL_HANDLE;
-    }
-    if (m_vkHostMemory != VK_NULL_HANDLE){
-        ::vkFreeMemory( m_vkDevice, m_vkHostMemory, pAllocator );
-        m_vkHostMemory = VK_NULL_HANDLE;
-    }
-    if (m_vkFence != VK_NULL_HANDLE){
-        ::vkDestroyFence( m_vkDevice, m_vkFence, pAllocator );
-        m_vkFence = VK_NULL_HANDLE;
+    // Get the plan for reducing the slice
+    VkCommandBuffer vkPlanCommandBuffer = VK_NULL_HANDLE;
+    if (m_vkResult == VK_SUCCESS){
+        m_vkResult = plans.Get( *this, pipeline, vkPlanCommandBuffer );
     }
-}
 
-class BasicReduction : public Reduction {
-public:
-    BasicReduction(VkDevice, DescriptorSet&&, CommandBuffer&&, QueryPoolTimer&&);
-    virtual ~BasicReduction(void) { }
-
-    virtual CommandBuffer& GetCommandBuffer(ComputeDevice&, const vkmr::Pipeline&);
-
-private:
-    VkDeviceSize m_vkSize;
-    uint m_count;
-
-    DescriptorSet m_descriptorSet;
-    CommandBuffer m_commandBuffer;
-};
-
-BasicReduction::BasicReduction(VkDevice vkDevice, DescriptorSet&& descriptorSet, CommandBuffer&& commandBuffer, QueryPoolTimer&& queryPoolTimer):
-    Reduction( VK_RESULT_MAX_ENUM, vkDevice, ::std::move( queryPoolTimer ) ),
-    m_vkSize( 0U ),
-    m_count( 0U ),
-    m_descriptorSet( ::std::move( descriptorSet ) ),
-    m_commandBuffer( ::std::move( commandBuffer ) ) { }
-
-CommandBuffer& BasicReduction::GetCommandBuffer(ComputeDevice& device, const vkmr::Pipeline& pipeline) {
-
-    // Update the descriptor set (to point at the slice's buffer)
-    m_count = m_slice.Count( );
-    const auto sliceBufferDescriptor = m_slice.BufferDescriptor( );
-    VkWriteDescriptorSet vkWriteDescriptorSet = {};
-    vkWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    vkWriteDescriptorSet.dstSet = *m_descriptorSet;
-    vkWriteDescriptorSet.descriptorCount = 1;
-    vkWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    vkWriteDescriptorSet.pBufferInfo = &(sliceBufferDescriptor);
-    VkWriteDescriptorSet vkWriteDescriptorSets[] = {
-        vkWriteDescriptorSet
-    };
-    ::vkUpdateDescriptorSets( m_vkDevice, 1, vkWriteDescriptorSets, 0, VK_NULL_HANDLE );
-
-    // Get the command buffer
+    // Record the commands around it, i.e. which differ from one reduction to the next
     auto vkCommandBuffer = *m_commandBuffer;
-
-    // Start recording commands into it
-    VkCommandBufferBeginInfo vkCommandBufferBeginInfo = {};
-    vkCommandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    vkCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    m_vkResult = ::vkBeginCommandBuffer( vkCommandBuffer, &vkCommandBufferBeginInfo );
     if (m_vkResult == VK_SUCCESS){
-        VkPhysicalDeviceProperties vkPhysicalDeviceProperties = {};
-        ::vkGetPhysicalDeviceProperties( device.PhysicalDevice( ), &vkPhysicalDeviceProperties );
-
-        // Capture the timstamp
+        VkCommandBufferBeginInfo vkCommandBufferBeginInfo = {};
+        vkCommandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        vkCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        m_vkResult = ::vkBeginCommandBuffer( vkCommandBuffer, &vkCommandBufferBeginInfo );
+    }
+    if (m_vkResult == VK_SUCCESS){
+        // Capture the timestamp
         m_queryPoolTimer.Start( vkCommandBuffer );
 
-        ::vkCmdBindPipeline( vkCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline );
-        VkDescriptorSet descriptorSets[] = { *m_descriptorSet };
-        ::vkCmdBindDescriptorSets( vkCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.Layout( ), 0, 1, descriptorSets, 0, VK_NULL_HANDLE );
-
-        // Loop until we've reduced the number of elements to 1
-        uint applicable = m_slice.Number( ) > 1 ? m_slice.Capacity( ) : m_slice.Count( );
-        for (uint pass = 0U, count = m_count; applicable > 1U; applicable = HalfEven( applicable )){
-            const uint delta = (1 << pass);
-
-            // Shader only operates on pairs, so the group count
-            // for every pass must be even
-            if ((count % 2) != 0){
-                // If this is not the first iteration, then we need
-                // a barrier between the last shader invocation and
-                // the copy we're about to do
-                if (pass > 0U){
-                    VkMemoryBarrier2KHR vkMemoryBarrier = {};
-                    vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
-                    vkMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
-                    vkMemoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT_KHR;
-                    vkMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
-                    vkMemoryBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-                    VkDependencyInfoKHR vkDependencyInfo = {};
-                    vkDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-                    vkDependencyInfo.memoryBarrierCount = 1;
-                    vkDependencyInfo.pMemoryBarriers = &vkMemoryBarrier;
-                    g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &vkDependencyInfo );
-                }
-
-                // Duplicate the last element
-                VkBufferCopy vkBufferCopy = {};
-                vkBufferCopy.size = sizeof( Reductions::slice_type::value_type );
-                vkBufferCopy.srcOffset = vkBufferCopy.size * (count - 1U) * delta;
-                vkBufferCopy.dstOffset = vkBufferCopy.srcOffset + (vkBufferCopy.size * delta);
-                if ((vkBufferCopy.dstOffset + vkBufferCopy.size) > m_slice.Size( )){
-                    // The copy would overflow the slice's memory - bail
-                    m_vkResult = VK_ERROR_OUT_OF_DEVICE_MEMORY;
-                    break;
-                }
-                ::vkCmdCopyBuffer( vkCommandBuffer, m_slice.Buffer( ), m_slice.Buffer( ), 1, &vkBufferCopy );
-                std::cout << "Duplicating item at " << int64_t(vkBufferCopy.srcOffset) << " to " << int64_t(vkBufferCopy.dstOffset) << "; count == " << count << ", delta == " << delta << std::endl;
-                count += 1U;
-
-                // Now we need a barrier between the copy and the shader invocation, below
-                VkMemoryBarrier2KHR vkMemoryBarrier = {};
-                vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
-                vkMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
-                vkMemoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
-                vkMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
-                vkMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT_KHR;
-                VkDependencyInfoKHR vkDependencyInfo = {};
-                vkDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-                vkDependencyInfo.memoryBarrierCount = 1;
-                vkDependencyInfo.pMemoryBarriers = &vkMemoryBarrier;
-                g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &vkDependencyInfo );
-            }else if (pass > 0U){
-                // Inject a barrier between shader invocations
-                VkMemoryBarrier2KHR vkMemoryBarrier = {};
-                vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
-                vkMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
-                vkMemoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT_KHR;
-                vkMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
-                vkMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT_KHR;
-                VkDependencyInfoKHR vkDependencyInfo = {};
-                vkDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-                vkDependencyInfo.memoryBarrierCount = 1;
-                vkDependencyInfo.pMemoryBarriers = &vkMemoryBarrier;
-                g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &vkDependencyInfo );
-            }
-
-            // Split into as many dispatches as are needed
-            BasicPushConstants pc = {};
-            pc.pass = (++pass);
-            pc.delta = delta;
-            pc.bound = m_count;
-            const auto pairs = (count >> 1);
-            const auto& workgroupSize = pipeline.GetWorkGroupSize( );
-            const auto workgroups = workgroupSize.GetGroupCountX( pairs );
-            for (auto remaining = workgroups; remaining > 0U; ){
-                const auto x = ::std::min(
-                    remaining,
-                    vkPhysicalDeviceProperties.limits.maxComputeWorkGroupCount[0]
-                );
-
-                // Push the constants
-                pc.offset = workgroupSize.x * (workgroups - remaining);
-                ::vkCmdPushConstants( vkCommandBuffer, pipeline.Layout( ), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pc ), &pc );
-
-                // Actually dispatch the shader invocations
-                ::std::cout << "Dispatching " << x << " workgroup(s) of size " << workgroupSize.x << " for " << pairs << " pair(s)" << ::std::endl;
-                ::vkCmdDispatch( vkCommandBuffer, x, 1, 1 );
-
-                remaining -= x;
-            }
-            count = pairs;
-        }
+        this->CmdWaitForRoots( vkCommandBuffer );
+        ::vkCmdExecuteCommands( vkCommandBuffer, 1, &vkPlanCommandBuffer );
 
         // Insert a barrier such that the writes from the shader complete
         // before we try and copy back to host-mappable memory
@@ -396,49 +305,106 @@ CommandBuffer& BasicReduction::GetCommandBuffer(ComputeDevice& device, const vkm
         vkDependencyInfo.pMemoryBarriers = &vkMemoryBarrier;
         g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &vkDependencyInfo );
 
-        // Add the command to copy from the slice buffer to the one we've allocated
-        VkBufferCopy vkBufferCopy = {};
-        vkBufferCopy.size = sizeof( VkSha256Result );
-        ::vkCmdCopyBuffer( vkCommandBuffer, m_slice.Buffer( ), m_vkBufferHost, 1, &vkBufferCopy );
+        // Add the command to copy out the root
+        this->CmdCopyRoot( vkCommandBuffer );
 
-        // Wrap it all up
+        // Capture the timestamp and wrap it up
         m_queryPoolTimer.Finish( vkCommandBuffer );
         m_vkResult = ::vkEndCommandBuffer( vkCommandBuffer );
     }
-    return m_commandBuffer;
+    if (m_vkResult == VK_SUCCESS){
+        // Submit unto the queue, to start once (e.g.) the mappings into the slice have completed
+        m_vkResult = device.Queue( ).Submit( vkCommandBuffer, waits, m_point );
+    }
+    return m_vkResult; 
 }
+void Reduction::CmdWaitForRoots(VkCommandBuffer vkCommandBuffer) {
 
-class ReductionBySubgroup : public Reduction {
-public:
-    ReductionBySubgroup(VkDevice, DescriptorSet&&, CommandBuffer&&, QueryPoolTimer&&);
-    virtual ~ReductionBySubgroup(void) { }
+    // Only slices of roots are written by other reductions; these are separate
+    // submissions, so make their copies visible to the shader (and to any copy)
+    if (m_level == 0U){
+        return;
+    }
+    VkMemoryBarrier2KHR vkMemoryBarrier = {};
+    vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    vkMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+    vkMemoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+    vkMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
+    vkMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_READ_BIT;
+    VkDependencyInfoKHR vkDependencyInfo = {};
+    vkDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    vkDependencyInfo.memoryBarrierCount = 1;
+    vkDependencyInfo.pMemoryBarriers = &vkMemoryBarrier;
+    g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &vkDependencyInfo );
+}
 
-    virtual CommandBuffer& GetCommandBuffer(ComputeDevice&, const vkmr::Pipeline&);
+void Reduction::CmdCopyRoot(VkCommandBuffer vkCommandBuffer) {
 
-private:
-    VkDeviceSize m_vkSize;
-    uint m_count;
+    // Copy from the slice buffer either into the slice of roots above
+    // it, or else into the (host-visible) one we've allocated
+    VkBufferCopy vkBufferCopy = {};
+    vkBufferCopy.size = sizeof( VkSha256Result );
+    if (this->Final( )){
+        ::vkCmdCopyBuffer( vkCommandBuffer, m_slice.Buffer( ), m_vkBufferHost, 1, &vkBufferCopy );
+    }else{
+        vkBufferCopy.dstOffset = m_vkTargetOffset;
+        ::vkCmdCopyBuffer( vkCommandBuffer, m_slice.Buffer( ), m_vkBufferTarget, 1, &vkBufferCopy );
+    }
+}
 
-    DescriptorSet m_descriptorSet;
-    CommandBuffer m_commandBuffer;
-};
+void Reduction::Free(void) {
+
+    const VkAllocationCallbacks *pAllocator = VK_NULL_HANDLE;
+    if (m_vkBufferHost != VK_NULL_HANDLE){
+        ::vkDestroyBuffer( m_vkDevice, m_vkBufferHost, pAllocator );
+        m_vkBufferHost = VK_NULL_HANDLE;
+    }
+    m_hostMemory = MemoryRange( );
+    m_point.vkSemaphore = VK_NULL_HANDLE;
+    m_point.value = 0U;
+}
 
-ReductionBySubgroup::ReductionBySubgroup(VkDevice vkDevice, DescriptorSet&& descriptorSet, CommandBuffer&& commandBuffer, QueryPoolTimer&& queryPoolTimer):
-    Reduction( VK_RESULT_MAX_ENUM, vkDevice, ::std::move( queryPoolTimer ) ),
-    m_vkSize( 0U ),
-    m_count( 0U ),
-    m_descriptorSet( ::std::move( descriptorSet ) ),
-    m_commandBuffer( ::std::move( commandBuffer ) ) { }
 
-CommandBuffer& ReductionBySubgroup::GetCommandBuffer(ComputeDevice& device, const vkmr::Pipeline& pipeline) {
+ReductionPlans::ReductionPlans(ComputeDevice& device, DescriptorPool&& descriptorPool):
+    m_vkDevice( *device ),
+    m_maxComputeWorkGroupCount( 0U ),
+    m_descriptorPool( ::std::move( descriptorPool ) ),
+    m_commandPool( device.CreateCommandPool( ) ) {
 
-    m_count = m_slice.Count( );
+    // Query for the limit once, rather than for every plan
+    VkPhysicalDeviceProperties vkPhysicalDeviceProperties = {};
+    ::vkGetPhysicalDeviceProperties( device.PhysicalDevice( ), &vkPhysicalDeviceProperties );
+    m_maxComputeWorkGroupCount = vkPhysicalDeviceProperties.limits.maxComputeWorkGroupCount[0];
+}
+
+VkResult ReductionPlans::Get(Reduction& reduction, vkmr::Pipeline& pipeline, VkCommandBuffer& vkCommandBuffer) {
+
+    // Look for a plan already recorded for the shape
+    const auto& slice = reduction.m_slice;
+    const auto key = ::std::make_tuple( slice.Buffer( ), static_cast<uint>( slice.Count( ) ), reduction.Applicable( ), reduction.m_folded );
+    const auto found = m_container.find( key );
+    if (found != m_container.end( )){
+        vkCommandBuffer = *(found->second.commandBuffer);
+        return VK_SUCCESS;
+    }
 
-    // Update the descriptor set (to point at the slice's buffer)
-    const auto sliceBufferDescriptor = m_slice.BufferDescriptor( );
+    // Otherwise, allocate a new one
+    Plan plan = {
+        m_descriptorPool.AllocateDescriptorSet( pipeline ),
+        m_commandPool.AllocateCommandBuffer( VK_COMMAND_BUFFER_LEVEL_SECONDARY )
+    };
+    if (!plan.descriptorSet){
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+    if (!plan.commandBuffer){
+        return static_cast<VkResult>( plan.commandBuffer );
+    }
+
+    // Point the descriptor set at the slice's buffer, for good
+    const auto sliceBufferDescriptor = slice.BufferDescriptor( );
     VkWriteDescriptorSet vkWriteDescriptorSet = {};
     vkWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    vkWriteDescriptorSet.dstSet = *m_descriptorSet;
+    vkWriteDescriptorSet.dstSet = *(plan.descriptorSet);
     vkWriteDescriptorSet.descriptorCount = 1;
     vkWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     vkWriteDescriptorSet.pBufferInfo = &(sliceBufferDescriptor);
@@ -447,130 +413,196 @@ CommandBuffer& ReductionBySubgroup::GetCommandBuffer(ComputeDevice& device, cons
     };
     ::vkUpdateDescriptorSets( m_vkDevice, 1, vkWriteDescriptorSets, 0, VK_NULL_HANDLE );
 
-    // Get the command buffer
-    auto vkCommandBuffer = *m_commandBuffer;
-
-    // Start recording commands into it
+    // Record the passes; the command buffer is executed again and again, so it's not one-time
+    auto vkPlanCommandBuffer = *(plan.commandBuffer);
+    VkCommandBufferInheritanceInfo vkCommandBufferInheritanceInfo = {};
+    vkCommandBufferInheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
     VkCommandBufferBeginInfo vkCommandBufferBeginInfo = {};
     vkCommandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    vkCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    m_vkResult = ::vkBeginCommandBuffer( vkCommandBuffer, &vkCommandBufferBeginInfo );
-    if (m_vkResult == VK_SUCCESS){
-        VkPhysicalDeviceProperties vkPhysicalDeviceProperties = {};
-        ::vkGetPhysicalDeviceProperties( device.PhysicalDevice( ), &vkPhysicalDeviceProperties );
+    vkCommandBufferBeginInfo.pInheritanceInfo = &vkCommandBufferInheritanceInfo;
+    auto vkResult = ::vkBeginCommandBuffer( vkPlanCommandBuffer, &vkCommandBufferBeginInfo );
+    if (vkResult == VK_SUCCESS){
+        ::vkCmdBindPipeline( vkPlanCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline );
+        VkDescriptorSet descriptorSets[] = { *(plan.descriptorSet) };
+        ::vkCmdBindDescriptorSets( vkPlanCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.Layout( ), 0, 1, descriptorSets, 0, VK_NULL_HANDLE );
+        vkResult = reduction.CmdReduce( vkPlanCommandBuffer, pipeline, m_maxComputeWorkGroupCount );
 
-        // Capture the timstamp
-        m_queryPoolTimer.Start( vkCommandBuffer );
+        const auto vkEndResult = ::vkEndCommandBuffer( vkPlanCommandBuffer );
+        if (vkResult == VK_SUCCESS){
+            vkResult = vkEndResult;
+        }
+    }
+    if (vkResult == VK_SUCCESS){
+        ::std::cout << "Recorded a plan for reducing " << ::std::get<1>( key ) << " of " << ::std::get<2>( key ) << " element(s); " << (m_container.size( ) + 1U) << " plan(s) in all." << ::std::endl;
+
+        // Keep it
+        vkCommandBuffer = vkPlanCommandBuffer;
+        m_container.emplace( key, ::std::move( plan ) );
+    }
+    return vkResult;
+}
 
-        ::vkCmdBindPipeline( vkCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline );
-        VkDescriptorSet descriptorSets[] = { *m_descriptorSet };
-        ::vkCmdBindDescriptorSets( vkCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.Layout( ), 0, 1, descriptorSets, 0, VK_NULL_HANDLE );
+// Reduces the slice one level of the tree per pass, pair-by-pair
+class BasicReduction : public Reduction {
+public:
+    BasicReduction(VkDevice, CommandBuffer&&, QueryPoolTimer&&);
+    virtual ~BasicReduction(void) { }
 
-        // Loop until we will have reduced to 1 element
+protected:
+    virtual VkResult CmdReduce(VkCommandBuffer, const vkmr::Pipeline&, uint32_t);
+};
+
+BasicReduction::BasicReduction(VkDevice vkDevice, CommandBuffer&& commandBuffer, QueryPoolTimer&& queryPoolTimer):
+    Reduction( VK_RESULT_MAX_ENUM, vkDevice, ::std::move( commandBuffer ), ::std::move( queryPoolTimer ) ) { }
+
+VkResult BasicReduction::CmdReduce(VkCommandBuffer vkCommandBuffer, const vkmr::Pipeline& pipeline, uint32_t maxComputeWorkGroupCount) {
+
+    // Loop until we've reduced the number of elements to 1
+    const uint bound = static_cast<uint>( m_slice.Count( ) );
+    uint applicable = this->Applicable( );
+    for (uint pass = 0U, count = bound; applicable > 1U; applicable = HalfEven( applicable )){
+        const uint delta = (1 << pass);
+
+        // The shader hashes the last element at each level with itself if it is unpaired
+        // (i.e. if the count is odd), so the passes need only wait on each other
+        if (pass > 0U){
+            // Inject a barrier between shader invocations
+            VkMemoryBarrier2KHR vkMemoryBarrier = {};
+            vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            vkMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+            vkMemoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT_KHR;
+            vkMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+            vkMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT_KHR;
+            VkDependencyInfoKHR vkDependencyInfo = {};
+            vkDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            vkDependencyInfo.memoryBarrierCount = 1;
+            vkDependencyInfo.pMemoryBarriers = &vkMemoryBarrier;
+            g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &vkDependencyInfo );
+        }
+
+        // Split into as many dispatches as are needed
+        BasicPushConstants pc = {};
+        pc.pass = (++pass);
+        pc.delta = delta;
+        pc.bound = bound;
+        const auto pairs = HalfEven( count );
         const auto& workgroupSize = pipeline.GetWorkGroupSize( );
-        uint applicable = m_slice.Number( ) > 1 ? m_slice.Capacity( ) : m_slice.Count( );
-        for (uint delta = 1U, count = m_count; applicable > 1U; ){
-            applicable = HalfEven( applicable );
-
-            // Get the actual number of work groups needed for the current pass
-            const auto elements = count;
-            const auto pairs = HalfEven( count );
-            count = workgroupSize.GetGroupCountX( pairs );
-
-            // Split into as many dispatches as are needed
-            for (auto remaining = count; remaining > 0U; ){
-                const auto x = ::std::min(
-                    remaining,
-                    vkPhysicalDeviceProperties.limits.maxComputeWorkGroupCount[0]
-                );
-
-                // Push the constants
-                BySubgroupPushConstants pc = { 0U };
-                pc.offset = workgroupSize.x * (count - remaining);
-                pc.pairs = ::std::min( applicable, workgroupSize.x );
-                pc.delta = delta;
-                pc.d2 = (delta << 1);
-                pc.bound = m_count;
-                ::vkCmdPushConstants( vkCommandBuffer, pipeline.Layout( ), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pc ), &pc );
-
-                // Actually dispatch the shader invocations
-                ::std::cout << m_slice.Number( ) << ": dispatching " << x << " subgroup-ed workgroup(s) of size " << pc.pairs << " for " << pairs << " pair(s) (" << elements << " element(s))" << ::std::endl;
-                ::vkCmdDispatch( vkCommandBuffer, x, 1, 1 );
-
-                // Advance
-                remaining -= x;
-            }
+        const auto workgroups = workgroupSize.GetGroupCountX( pairs );
+        for (auto remaining = workgroups; remaining > 0U; ){
+            const auto x = ::std::min( remaining, maxComputeWorkGroupCount );
 
-            // Tee up the next iteration
-            applicable = workgroupSize.GetGroupCountX( applicable );
-            if (applicable > 1U){
-                // Inject a barrier between passes
-                VkMemoryBarrier2KHR vkMemoryBarrier = {};
-                vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
-                vkMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
-                vkMemoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT_KHR;
-                vkMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
-                vkMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT_KHR;
-                VkDependencyInfoKHR vkDependencyInfo = {};
-                vkDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-                vkDependencyInfo.memoryBarrierCount = 1;
-                vkDependencyInfo.pMemoryBarriers = &vkMemoryBarrier;
-                g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &vkDependencyInfo );
-            }
-            delta *= (workgroupSize.x << 1); // x2 because each invocation in the group has addressed two items
+            // Push the constants
+            pc.offset = workgroupSize.x * (workgroups - remaining);
+            ::vkCmdPushConstants( vkCommandBuffer, pipeline.Layout( ), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pc ), &pc );
+
+            // Actually dispatch the shader invocations
+            ::vkCmdDispatch( vkCommandBuffer, x, 1, 1 );
+
+            remaining -= x;
         }
+        count = pairs;
+    }
+    return VK_SUCCESS;
+}
 
-        // Insert a barrier such that the writes from the shader complete
-        // before we try and copy back to host-mappable memory
-        VkMemoryBarrier2KHR vkMemoryBarrier = {};
-        vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
-        vkMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
-        vkMemoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT_KHR;
-        vkMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR;
-        vkMemoryBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-        VkDependencyInfoKHR vkDependencyInfo = {};
-        vkDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-        vkDependencyInfo.memoryBarrierCount = 1;
-        vkDependencyInfo.pMemoryBarriers = &vkMemoryBarrier;
-        g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &vkDependencyInfo );
+// Reduces the slice as many levels of the tree per pass as there are invocations in each group,
+// which reduces the sub-tree under it by subgroup shuffles or else in shared memory
+class ReductionByGroup : public Reduction {
+public:
+    ReductionByGroup(VkDevice, CommandBuffer&&, QueryPoolTimer&&);
+    virtual ~ReductionByGroup(void) { }
 
-        // Add the command to copy from the slice buffer to the one we've allocated
-        VkBufferCopy vkBufferCopy = {};
-        vkBufferCopy.size = sizeof( VkSha256Result );
-        ::vkCmdCopyBuffer( vkCommandBuffer, m_slice.Buffer( ), m_vkBufferHost, 1, &vkBufferCopy );
+protected:
+    virtual VkResult CmdReduce(VkCommandBuffer, const vkmr::Pipeline&, uint32_t);
+};
 
-        // Capture the timestamp and wrap it up
-        m_queryPoolTimer.Finish( vkCommandBuffer );
-        m_vkResult = ::vkEndCommandBuffer( vkCommandBuffer );
+ReductionByGroup::ReductionByGroup(VkDevice vkDevice, CommandBuffer&& commandBuffer, QueryPoolTimer&& queryPoolTimer):
+    Reduction( VK_RESULT_MAX_ENUM, vkDevice, ::std::move( commandBuffer ), ::std::move( queryPoolTimer ) ) { }
+
+VkResult ReductionByGroup::CmdReduce(VkCommandBuffer vkCommandBuffer, const vkmr::Pipeline& pipeline, uint32_t maxComputeWorkGroupCount) {
+
+    // Loop until we will have reduced to 1 element
+    const uint bound = static_cast<uint>( m_slice.Count( ) );
+    const auto& workgroupSize = pipeline.GetWorkGroupSize( );
+    uint applicable = this->Applicable( ), delta = 1U, count = bound;
+    if (m_folded && (applicable > 1U)){
+        // The mappings have already folded each group of leaves into the root of its
+        // sub-tree, at the start of it, just as the first pass would have
+        count = workgroupSize.GetGroupCountX( HalfEven( count ) );
+        applicable = workgroupSize.GetGroupCountX( HalfEven( applicable ) );
+        delta = (workgroupSize.x << 1);
+    }
+    while (applicable > 1U){
+        applicable = HalfEven( applicable );
+
+        // Get the actual number of work groups needed for the current pass
+        const auto pairs = HalfEven( count );
+        count = workgroupSize.GetGroupCountX( pairs );
+
+        // Split into as many dispatches as are needed
+        for (auto remaining = count; remaining > 0U; ){
+            const auto x = ::std::min( remaining, maxComputeWorkGroupCount );
+
+            // Push the constants
+            ByGroupPushConstants pc = { 0U };
+            pc.offset = workgroupSize.x * (count - remaining);
+            pc.pairs = ::std::min( applicable, workgroupSize.x );
+            pc.delta = delta;
+            pc.d2 = (delta << 1);
+            pc.bound = bound;
+            ::vkCmdPushConstants( vkCommandBuffer, pipeline.Layout( ), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pc ), &pc );
+
+            // Actually dispatch the shader invocations
+            ::vkCmdDispatch( vkCommandBuffer, x, 1, 1 );
+
+            // Advance
+            remaining -= x;
+        }
+
+        // Tee up the next iteration
+        applicable = workgroupSize.GetGroupCountX( applicable );
+        if (applicable > 1U){
+            // Inject a barrier between passes
+            VkMemoryBarrier2KHR vkMemoryBarrier = {};
+            vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            vkMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+            vkMemoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT_KHR;
+            vkMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+            vkMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT_KHR;
+            VkDependencyInfoKHR vkDependencyInfo = {};
+            vkDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            vkDependencyInfo.memoryBarrierCount = 1;
+            vkDependencyInfo.pMemoryBarriers = &vkMemoryBarrier;
+            g_pVkCmdPipelineBarrier2KHR( vkCommandBuffer, &vkDependencyInfo );
+        }
+        delta *= (workgroupSize.x << 1); // x2 because each invocation in the group has addressed two items
     }
-    return (m_commandBuffer);
+    return VK_SUCCESS;
 }
 
 class ReductionFactory {
 public:
     typedef ::std::shared_ptr<Reduction> ProductType;
 
-    ReductionFactory(ComputeDevice& device, bool subgroupSupportPreferred):
-        m_subgroupSupportPreferred( subgroupSupportPreferred ),
+    ReductionFactory(ComputeDevice& device, Tuning::Reduction strategy):
+        m_strategy( strategy ),
         m_queryPoolTimers( device ) { }
     ~ReductionFactory() = default;
 
-    ProductType CreateReduction(VkDevice vkDevice, DescriptorSet&& descriptorSet, CommandBuffer&& commandBuffer) {
+    ProductType CreateReduction(VkDevice vkDevice, CommandBuffer&& commandBuffer) {
 
         using ::std::make_shared;
 
         ProductType product;
-        if (m_subgroupSupportPreferred){
-            product = make_shared<ReductionBySubgroup>(
+        if (m_strategy != Tuning::ReductionBasic){
+            product = make_shared<ReductionByGroup>(
                 vkDevice,
-                ::std::move( descriptorSet ),
                 ::std::move( commandBuffer ),
                 m_queryPoolTimers.New( )
             );
         }else{
             product = make_shared<BasicReduction>(
                 vkDevice,
-                ::std::move( descriptorSet ),
                 ::std::move( commandBuffer ),
                 m_queryPoolTimers.New( )
             );
@@ -579,54 +611,127 @@ public:
     }
 
 private:
-    bool m_subgroupSupportPreferred;
+    Tuning::Reduction m_strategy;
     QueryPoolTimers m_queryPoolTimers;
 };
 
 class ReductionsImpl : public Reductions {
 public:
-    ReductionsImpl(ComputeDevice& device, vkmr::Pipeline&& pipeline, DescriptorPool&& descriptorPool, bool subgroupSupportPreferred):
+    ReductionsImpl(ComputeDevice& device, vkmr::Pipeline&& pipeline, DescriptorPool&& descriptorPool, Tuning::Reduction strategy):
         m_vkDevice( *device ),
-        m_descriptorPool( ::std::move( descriptorPool ) ),
         m_commandPool( device.CreateCommandPool( ) ),
         m_pipeline( ::std::move( pipeline ) ),
-        m_factory( ReductionFactory( device, subgroupSupportPreferred ) ) { }
+        m_plans( device, ::std::move( descriptorPool ) ),
+        m_factory( ReductionFactory( device, strategy ) ),
+        m_rootsPerSlice( Slices<VkSha256Result>( c_vkRootsSliceSize ).SliceSize( device ) / sizeof( VkSha256Result ) ),
+        m_rooted( false ),
+        m_root( ),
+        m_folded( false ),
+        m_sharded( false ),
+        m_elapsed( 0.0 ) { }
 
     virtual ~ReductionsImpl() {
 
         m_container.clear( );
-        m_descriptorPool = DescriptorPool( );
+        m_levels.clear( );
+        m_plans.Clear( );
         m_commandPool = CommandPool( );
         m_pipeline = vkmr::Pipeline( );
     }
 
-    VkResult Reduce(Reductions::slice_type&&, ComputeDevice&);
+    VkResult Reduce(Reductions::slice_type&& slice, ComputeDevice& device, const vector<TimelinePoint>& waits) {
+        return this->Reduce( ::std::move( slice ), device, 0U, m_sharded, waits );
+    }
 
-    void Update(void);
+    void Update(ComputeDevice&, Slices<VkSha256Result>&);
 
-    ISha256D::out_type WaitFor(void);
+    void WaitForAny(ComputeDevice&, Slices<VkSha256Result>&);
+
+    ISha256D::out_type WaitFor(ComputeDevice&, Slices<VkSha256Result>&);
+
+    bool Has(void) const { return !m_container.empty( ); }
+
+    double Elapsed(void) const { return m_elapsed; }
+
+    uint32_t FoldSize(void) const {
+        const auto& workgroupSize = m_pipeline.GetWorkGroupSize( );
+        return workgroupSize.bySubgroup ? (workgroupSize.x << 1) : 0U;
+    }
+
+    void Folded(bool folded) { m_folded = folded; }
+
+    void Sharded(bool sharded) { m_sharded = sharded; }
+
+    const ::std::map<slice_type::number_type, VkSha256Result>& Roots(void) const { return m_roots; }
 
 private:
+    // Waits on any (or all) of the in-progress reductions, and then updates
+    void Wait(ComputeDevice&, Slices<VkSha256Result>&, VkBool32);
+
+    // Initiates a new reduction of the given slice, at the given level of the tree, writing its
+    // root into the slice of roots above it, or else (if final) back to the host
+    VkResult Reduce(Reductions::slice_type&&, ComputeDevice&, uint32_t, bool, const vector<TimelinePoint>& = vector<TimelinePoint>( ));
+
     VkDevice m_vkDevice;
 
-    DescriptorPool m_descriptorPool;
     CommandPool m_commandPool;
     vkmr::Pipeline m_pipeline;
+    ReductionPlans m_plans;
 
     ReductionFactory m_factory;
     vector<ReductionFactory::ProductType> m_container;
-    ::std::unordered_map<slice_type::number_type, VkSha256Result> m_results;
+
+    // The slices of the roots of the slices at each level of the tree (i.e.
+    // the first holds the roots of the slices of leaves), and their size
+    vector<Slices<VkSha256Result>> m_levels;
+    slice_type::size_type m_rootsPerSlice;
+
+    // The root of the whole tree, once it has been read back
+    bool m_rooted;
+    VkSha256Result m_root;
+
+    // Whether the slices of leaves were folded by their mappings
+    bool m_folded;
+
+    // Whether the root of each slice of leaves is read back by itself, and those read back
+    bool m_sharded;
+    ::std::map<slice_type::number_type, VkSha256Result> m_roots;
+
+    // The time spent on the device by the reductions which have concluded
+    double m_elapsed;
+
+    // The preferred size of each slice of roots
+    static const VkDeviceSize c_vkRootsSliceSize = 4096U * sizeof( VkSha256Result );
 };
 
-VkResult ReductionsImpl::Reduce(Reductions::slice_type&& slice, ComputeDevice& device) {
+VkResult ReductionsImpl::Reduce(Reductions::slice_type&& slice, ComputeDevice& device, uint32_t level, bool final, const vector<TimelinePoint>& waits) {
+
+    // Look for an early out
+    if (!slice || (m_rootsPerSlice == 0U)){
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Find the slice of roots, and the place in it, for the root of the given slice
+    VkBuffer vkBufferTarget = VK_NULL_HANDLE;
+    VkDeviceSize vkTargetOffset = 0U;
+    if (!final){
+        while (m_levels.size( ) <= level){
+            m_levels.push_back( Slices<VkSha256Result>( c_vkRootsSliceSize ) );
+        }
+        auto& roots = m_levels[level];
+        const auto index = static_cast<slice_type::number_type>( (slice.Number( ) - 1U) / m_rootsPerSlice ) + 1U;
+        while (roots.Newest( ) < index){
+            if (!roots.New( device )){
+                return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+            }
+        }
+        vkBufferTarget = roots[index].Buffer( );
+        vkTargetOffset = ((slice.Number( ) - 1U) % m_rootsPerSlice) * sizeof( VkSha256Result );
+    }
 
     // Allocate and apply a new reduction
-    auto reduction = m_factory.CreateReduction(
-        m_vkDevice,
-        m_descriptorPool.AllocateDescriptorSet( m_pipeline ),
-        m_commandPool.AllocateCommandBuffer( )
-    );
-    auto vkResult = reduction->Apply( ::std::move( slice ), device, m_pipeline );
+    auto reduction = m_factory.CreateReduction( m_vkDevice, m_commandPool.AllocateCommandBuffer( ) );
+    auto vkResult = reduction->Apply( ::std::move( slice ), device, m_pipeline, m_plans, level, (m_folded && (level == 0U)), waits, vkBufferTarget, vkTargetOffset );
     if (vkResult == VK_SUCCESS){
         // Accumulate it
         m_container.push_back( ::std::move( reduction ) );
@@ -634,95 +739,133 @@ VkResult ReductionsImpl::Reduce(Reductions::slice_type&& slice, ComputeDevice& d
     return vkResult;
 }
 
-void ReductionsImpl::Update(void) {
+void ReductionsImpl::Update(ComputeDevice& device, Slices<VkSha256Result>& slices) {
 
+    // Gather the slices of roots which have been filled, reading the timeline(s) once
+    vector<::std::pair<uint32_t, slice_type::number_type>> filled;
+    TimelineSnapshot snapshot( m_vkDevice );
     for (auto it = m_container.begin( ); it != m_container.end( ); ) {
         auto reduction = (*it);
-        auto vkFence = static_cast<VkFence>( *reduction );
-        auto vkResult = ::vkGetFenceStatus( m_vkDevice, vkFence );
-        if (vkResult == VK_SUCCESS){
-            ::std::cout << "Reduction #" << reduction->Number( ) << " finished";
+        if (snapshot.Reached( reduction->Point( ) )){
+            ::std::cout << "Reduction #" << reduction->Number( ) << " (level " << reduction->Level( ) << ") finished";
             auto elapsed = reduction->Elapsed( );
             if (elapsed != 0){
                 ::std::cout << " in " << elapsed << "ms";
+                m_elapsed += elapsed;
             }
             ::std::cout << "." << ::std::endl;
 
-            VkSha256Result vkSha256Result = reduction->Read( );
-            for (auto u = 0U; u < SHA256_WC; ++u){
-                const uint w = vkSha256Result.data[u];
-                vkSha256Result.data[u] = SWOP_ENDS_U32( w );
+            const auto level = reduction->Level( );
+            if (reduction->Final( ) && m_sharded){
+                // Keep it to be combined with those of the slices reduced elsewhere
+                m_roots[reduction->Number( )] = reduction->Read( );
+            }else if (reduction->Final( )){
+                // Done-zo..
+                m_root = reduction->Read( );
+                m_rooted = true;
+            }else{
+                // Count the root into the slice of roots above
+                const auto index = static_cast<slice_type::number_type>( (reduction->Number( ) - 1U) / m_rootsPerSlice ) + 1U;
+                auto& roots = m_levels[level][index];
+                roots.Fill( );
+                if (roots.IsFilled( )){
+                    filled.push_back( ::std::make_pair( level, index ) );
+                }
             }
-            ::std::cout << "#" << reduction->Number( ) << ":" << print_bytes_ex( vkSha256Result.data, SHA256_WC ).str( ) << ::std::endl;
 
-            // Done-zo..
-            m_results.emplace(
-                reduction->Number( ),
-                reduction->Read( )
-            );
+            // Hand back the slice, for reuse, to whichever it came from
+            if (level == 0U){
+                slices.Recycle( reduction->MoveSlice( ) );
+            }else{
+                m_levels[level - 1U].Recycle( reduction->MoveSlice( ) );
+            }
             it = m_container.erase( it );
         }else{
             ++it;
         }
     }
-}
 
-ISha256D::out_type ReductionsImpl::WaitFor(void) {
-
-    // Look for an early out
-    if (m_container.empty( )){
-        return "";
+    // Kick off the reductions of the slices of roots which have been filled
+    for (auto it = filled.cbegin( ), end = filled.cend( ); it != end; ++it){
+        this->Reduce( m_levels[it->first].Remove( it->second ), device, it->first + 1U, false );
     }
+}
+
+void ReductionsImpl::Wait(ComputeDevice& device, Slices<VkSha256Result>& slices, VkBool32 vkWaitAll) {
 
-    // Wait on all of the fences
-    vector<VkFence> fences;
+    vector<TimelinePoint> points;
     for (auto it = m_container.cbegin( ), end = m_container.cend( ); it != end; ++it) {
         auto reduction = (*it);
-        auto vkFence = static_cast<VkFence>( *reduction );
-        fences.push_back( vkFence );
+        points.push_back( reduction->Point( ) );
     }
-    if (!fences.empty( )){
-        ::vkWaitForFences( m_vkDevice, fences.size( ), fences.data( ), VK_TRUE, UINT64_MAX );
+    if (points.empty( )){
+        return;
     }
+    DeviceQueue::WaitFor( m_vkDevice, points, vkWaitAll );
 
-    // Update to get out the results
-    this->Update( );
+    // Update to collect the results
+    this->Update( device, slices );
+}
+
+void ReductionsImpl::WaitForAny(ComputeDevice& device, Slices<VkSha256Result>& slices) {
+    this->Wait( device, slices, VK_FALSE );
+}
 
-    // Return
-    if (m_results.size( ) == 1U){
-        auto vkSha256Result = m_results.begin( )->second;
+ISha256D::out_type ReductionsImpl::WaitFor(ComputeDevice& device, Slices<VkSha256Result>& slices) {
 
-        // The output is big-endian in nature; convert to little endianess prior to output
-        for (auto u = 0U; u < SHA256_WC; ++u){
-            const uint w = vkSha256Result.data[u];
-            vkSha256Result.data[u] = SWOP_ENDS_U32( w );
+    while (!m_rooted){
+        // Wait on all of the reductions, which may kick off more
+        while (!m_container.empty( )){
+            this->Wait( device, slices, VK_TRUE );
+        }
+        if (m_rooted){
+            break;
+        }
+        if (m_sharded){
+            // The roots of the slices are combined by whoever sharded them
+            return "";
         }
-        return print_bytes_ex( vkSha256Result.data, SHA256_WC ).str( );
-    }
 
-    CpuSha256DforReductions sha256D;
-    for (slice_type::number_type u = 1U, bound = (u + m_results.size( )); u < bound; ++u ){
-        const auto found = m_results.find( u );
-        if (found == m_results.end( )){
-            // Bail
+        // Find the lowest level with any (partly-filled) slices of roots left
+        uint32_t level = 0U;
+        while ((level < m_levels.size( )) && !m_levels[level].Has( )){
+            level++;
+        }
+        if (level == m_levels.size( )){
+            // Nothing was reduced
             return "";
         }
-        sha256D.Add( found->second );
-    }
-    return sha256D.Root( );
-}
 
-::std::unique_ptr<Reductions> Reductions::New(ComputeDevice& device, typename slice_type::number_type number) {
+        // If there's only ever been one slice at this level, then its root is the root of the
+        // whole tree; otherwise, reduce them all into the level above, and go around again
+        auto& roots = m_levels[level];
+        if (roots.Newest( ) == 1U){
+            if (this->Reduce( roots.Remove( 1U ), device, level + 1U, true ) != VK_SUCCESS){
+                return "";
+            }
+            continue;
+        }
+        while (roots.Has( )){
+            const auto number = roots.Any( ).Number( );
+            if (this->Reduce( roots.Remove( number ), device, level + 1U, false ) != VK_SUCCESS){
+                return "";
+            }
+        }
+    }
 
-    // Look for an early out
-    ::std::unique_ptr<Reductions> reductions;
-    auto vkDevice = *device;
-    if (vkDevice == VK_NULL_HANDLE){
-        return reductions;
+    // The output is big-endian in nature; convert to little endianess prior to output
+    auto vkSha256Result = m_root;
+    for (auto u = 0U; u < SHA256_WC; ++u){
+        const uint w = vkSha256Result.data[u];
+        vkSha256Result.data[u] = SWOP_ENDS_U32( w );
     }
+    return print_bytes_ex( vkSha256Result.data, SHA256_WC ).str( );
+}
+
+::std::vector<uint32_t> Reductions::SubgroupSizes(const ComputeDevice& device) {
 
     // Prep
-    const VkAllocationCallbacks *pAllocator = VK_NULL_HANDLE;
+    ::std::vector<uint32_t> sizes;
     const auto subgroupFeatureFlagMask = int(VK_SUBGROUP_FEATURE_BASIC_BIT) | int(VK_SUBGROUP_FEATURE_SHUFFLE_RELATIVE_BIT);
 
     // Query for subgroup support/size
@@ -755,28 +898,90 @@ ISha256D::out_type ReductionsImpl::WaitFor(void) {
             subgroupSize = vkPhysicalDeviceSubgroupSizeControlProperties.minSubgroupSize;
         }
     }
-    subgroupsSupported = (subgroupSize > 1U);
+    if (subgroupSize <= 1U){
+        return sizes;
+    }
+    ::std::cout << "Subgroup feature flags = 0x" << std::hex << subgroupFeatureFlags << std::dec << ::std::endl;
+    sizes.push_back( vkmr::largest_pow2_le( subgroupSize ) );
+
+    // Followed by any others which can be required of the pipeline
+    const auto maxSubgroupSize = vkPhysicalDeviceSubgroupSizeControlProperties.maxSubgroupSize;
+    for (auto size = (sizes.front( ) << 1); size <= maxSubgroupSize; size <<= 1){
+        sizes.push_back( size );
+    }
+    return sizes;
+}
+
+uint32_t Reductions::MaxWorkgroupSize(const ComputeDevice& device) {
+
+    // Each invocation holds (the two halves of) one hash in shared memory
+    VkPhysicalDeviceProperties2KHR vkPhysicalDeviceProperties2 = {};
+    vkPhysicalDeviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    device.GetPhysicalDeviceProperties2KHR( &vkPhysicalDeviceProperties2 );
+    const auto& limits = vkPhysicalDeviceProperties2.properties.limits;
+    const auto limit = ::std::min(
+        ::std::min( limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations ),
+        static_cast<uint32_t>( limits.maxComputeSharedMemorySize / sizeof( VkSha256Result ) )
+    );
+    return vkmr::largest_pow2_le( ::std::max( limit, 1U ) );
+}
+
+::std::unique_ptr<Reductions> Reductions::New(ComputeDevice& device, typename slice_type::number_type number) {
+
+    // Look for an early out
+    ::std::unique_ptr<Reductions> reductions;
+    auto vkDevice = *device;
+    if (vkDevice == VK_NULL_HANDLE){
+        return reductions;
+    }
+
+    // Prep
+    const VkAllocationCallbacks *pAllocator = VK_NULL_HANDLE;
+
+    // Reduce by subgroup where supported, or else by workgroup in shared memory, unless found
+    // (by autotuning) to be faster otherwise, and in groups of the size found to be fastest, if
+    // any (and if it can be required)
+    const auto& tuning = device.GetTuning( );
+    auto strategy = tuning.reduction;
+    const auto subgroupSizes = ((strategy == Tuning::ReductionAuto) || (strategy == Tuning::ReductionSubgroups))
+        ? Reductions::SubgroupSizes( device )
+        : ::std::vector<uint32_t>( );
+    uint32_t subgroupSize = 1U;
+    if (!subgroupSizes.empty( )){
+        subgroupSize = subgroupSizes.front( );
+        if (::std::find( subgroupSizes.cbegin( ), subgroupSizes.cend( ), tuning.subgroupSize ) != subgroupSizes.cend( )){
+            subgroupSize = tuning.subgroupSize;
+        }
+        strategy = Tuning::ReductionSubgroups;
+    }else if (strategy != Tuning::ReductionBasic){
+        strategy = Tuning::ReductionShared;
+    }
 
     // If suitably-sized subgroups are supported,
     // then make the workgroup size the same as the subgroup size
     WorkgroupSize workgroupSize = {};
-    if (subgroupsSupported){
-        ::std::cout << "Subgroup feature flags = 0x" << std::hex << subgroupFeatureFlags << ::std::endl;
+    workgroupSize.y = 1U;
+    workgroupSize.z = 1U;
+    workgroupSize.bySubgroup = false;
+    const char* shaderCodePath = "SHA-256-2-be.spv";
+    if (strategy == Tuning::ReductionSubgroups){
         ::std::cout << "Subgroups, with relative shuffle support, of size " << std::dec << subgroupSize << " are supported." << ::std::endl;
 
-        workgroupSize.x = vkmr::largest_pow2_le( subgroupSize );
-        workgroupSize.y = 1U;
-        workgroupSize.z = 1U;
+        workgroupSize.x = subgroupSize;
         workgroupSize.bySubgroup = true;
+        shaderCodePath = "SHA-256-2-be-subgroups.spv";
+    }else if (strategy == Tuning::ReductionShared){
+        // Large enough that each pass reduces 8 levels of the tree
+        const auto maxWorkgroupSize = Reductions::MaxWorkgroupSize( device );
+        const auto tuned = tuning.reductionWorkgroupSize;
+        workgroupSize.x = ::std::min( (tuned > 1U) ? vkmr::largest_pow2_le( tuned ) : 128U, maxWorkgroupSize );
+        shaderCodePath = "SHA-256-2-be-shared.spv";
+        ::std::cout << "Reducing by workgroups of size " << std::dec << workgroupSize.x << ", in shared memory." << ::std::endl;
     }else{
         workgroupSize.x = 64; // A sensible multiple of common subgroup sizes across Intel, nVidia & AMD
-        workgroupSize.y = 1U;
-        workgroupSize.z = 1U;
-        workgroupSize.bySubgroup = false;
     }
 
     // Load the shader code, wrap it in a module, etc
-    const auto shaderCodePath = subgroupsSupported ? "SHA-256-2-be-subgroups.spv" : "SHA-256-2-be.spv";
     ShaderModule shaderModule( vkDevice, shaderCodePath );
     auto vkResult = static_cast<VkResult>( shaderModule );
 
@@ -798,9 +1003,11 @@ ISha256D::out_type ReductionsImpl::WaitFor(void) {
         vkResult = ::vkCreateDescriptorSetLayout( vkDevice, &vkDescriptorSetLayoutCreateInfo, pAllocator, &vkDescriptorSetLayout );
     }
 
-    // Allocate a descriptor pool
+    // Allocate a descriptor pool, for the plans: one per slice, plus as many again
+    // for the slices of their roots, and some for those which are only partly filled
     ::std::cout << "Allocating for up to " << number << " concurrent reduction(s).." << ::std::endl;
-    auto descriptorPool = DescriptorPool( vkDevice, number, number );
+    const auto planCount = (2U * number) + 16U;
+    auto descriptorPool = DescriptorPool( vkDevice, planCount, planCount );
     if (!descriptorPool){
         vkResult = descriptorPool;
     }
@@ -811,9 +1018,9 @@ ISha256D::out_type ReductionsImpl::WaitFor(void) {
         VkPushConstantRange vkPushConstantRange = {};
         vkPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
         vkPushConstantRange.offset = 0;
-        vkPushConstantRange.size = subgroupsSupported
-            ? sizeof( BySubgroupPushConstants )
-            : sizeof( BasicPushConstants );
+        vkPushConstantRange.size = (strategy == Tuning::ReductionBasic)
+            ? sizeof( BasicPushConstants )
+            : sizeof( ByGroupPushConstants );
         reductions.reset( new ReductionsImpl(
             device,
             vkmr::Pipeline(
@@ -821,10 +1028,11 @@ ISha256D::out_type ReductionsImpl::WaitFor(void) {
                 vkDescriptorSetLayout,
                 vkmr::Pipeline::NewSimpleLayout( vkDevice, vkDescriptorSetLayout, &vkPushConstantRange ),
                 ::std::move( shaderModule ),
-                &workgroupSize
+                &workgroupSize,
+                device.GetPipelineCache( )
             ),
             ::std::move( descriptorPool ),
-            subgroupsSupported
+            strategy
         ) );
     }
     return reductions;
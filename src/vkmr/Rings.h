@@ -0,0 +1,96 @@
+// Rings.h: declares the types, functions and classes for passing items between a pair of threads
+//
+
+#ifndef __VKMR_RINGS_H__
+#define __VKMR_RINGS_H__
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace vkmr {
+
+// Class(es)
+//
+
+// A fixed-size, lock-free ring buffer of items passed from a single
+// producer thread to a single consumer thread
+template <typename T>
+class Ring {
+public:
+    typedef size_t size_type;
+
+    Ring(size_type capacity):
+        m_slots( capacity + 1U ),
+        m_head( 0U ),
+        m_tail( 0U ) { }
+    Ring(Ring const&) = delete;
+
+    Ring& operator=(Ring const&) = delete;
+
+    // Moves the given item onto the back of the ring, if there's space for
+    // it, and returns true; otherwise returns false (producer only)
+    bool TryPush(T& item) {
+
+        const auto tail = m_tail.load( ::std::memory_order_relaxed );
+        const auto next = this->Next( tail );
+        if (next == m_head.load( ::std::memory_order_acquire )){
+            // Full
+            return false;
+        }
+        m_slots[tail] = ::std::move( item );
+        m_tail.store( next, ::std::memory_order_release );
+        return true;
+    }
+
+    // Moves the item at the front of the ring into the given one, if there
+    // is one, and returns true; otherwise returns false (consumer only)
+    bool TryPop(T& item) {
+
+        const auto head = m_head.load( ::std::memory_order_relaxed );
+        if (head == m_tail.load( ::std::memory_order_acquire )){
+            // Empty
+            return false;
+        }
+        item = ::std::move( m_slots[head] );
+        m_head.store( this->Next( head ), ::std::memory_order_release );
+        return true;
+    }
+
+    // Returns the number of items in the ring (which, from any
+    // thread other than the producer or consumer, is a snapshot)
+    size_type Size(void) const {
+        const auto head = m_head.load( ::std::memory_order_acquire );
+        const auto tail = m_tail.load( ::std::memory_order_acquire );
+        return (tail >= head) ? (tail - head) : (tail + m_slots.size( ) - head);
+    }
+
+    // Returns the most number of items the ring can hold
+    size_type Capacity(void) const { return m_slots.size( ) - 1U; }
+
+private:
+    // The size of a cache line, in bytes (or at least a safe bet)
+    static const size_t c_cacheLineSize = 64U;
+
+    size_type Next(size_type index) const {
+        return ((index + 1U) == m_slots.size( )) ? 0U : (index + 1U);
+    }
+
+    ::std::vector<T> m_slots;
+
+    // The consumer and producer each write one of these; pad them out
+    // onto separate cache lines so they don't contend
+    char m_padding0[c_cacheLineSize];
+    ::std::atomic<size_type> m_head;
+    char m_padding1[c_cacheLineSize - sizeof( ::std::atomic<size_type> )];
+    ::std::atomic<size_type> m_tail;
+    char m_padding2[c_cacheLineSize - sizeof( ::std::atomic<size_type> )];
+};
+
+} // namespace vkmr
+
+#endif // __VKMR_RINGS_H__
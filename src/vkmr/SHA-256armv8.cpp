@@ -0,0 +1,112 @@
+// SHA-256armv8.cpp: defines the function(s) for computing SHA-256 hashes with the ARMv8 Cryptographic Extension
+//
+
+// Includes
+//
+
+// Local Project Headers
+#include "SHA-256mb.h"
+
+#if defined (_VKMR_ARM64_)
+// Intrinsics
+#include <arm_neon.h>
+
+#if defined (__clang__)
+_VKMR_TARGET_BEGIN_( "sha2" )
+#else
+_VKMR_TARGET_BEGIN_( "+crypto" )
+#endif
+
+// Local Project Headers
+#include "SHA-256lanes.h"
+
+namespace {
+
+// Functions
+//
+
+void sha256_compress_armv8(uint32_t* H, const uint32_t* M) {
+
+    // Load the hash value(s), as ABCD and EFGH
+    uint32x4_t state0 = vld1q_u32( H );
+    uint32x4_t state1 = vld1q_u32( H + 4 );
+    const uint32x4_t abcd = state0, efgh = state1;
+
+    // Load the message block; its words are already big-endian values
+    uint32x4_t W[4];
+    for (uint32_t w = 0U; w < 4U; ++w){
+        W[w] = vld1q_u32( M + (w << 2) );
+    }
+
+    // Apply the rounds, four at a time, while extending the message
+    // schedule four words at a time
+    for (uint32_t i = 0U; i < 16U; ++i){
+        const uint32x4_t msg = vaddq_u32( W[i & 3U], vld1q_u32( vkmr::c_sha256Constants + (i << 2) ) );
+        if (i < 12U){
+            W[i & 3U] = vsha256su1q_u32(
+                vsha256su0q_u32( W[i & 3U], W[(i + 1U) & 3U] ),
+                W[(i + 2U) & 3U],
+                W[(i + 3U) & 3U]
+            );
+        }
+        const uint32x4_t tmp = state0;
+        state0 = vsha256hq_u32( state0, state1, msg );
+        state1 = vsha256h2q_u32( state1, tmp, msg );
+    }
+
+    // Accumulate
+    vst1q_u32( H, vaddq_u32( state0, abcd ) );
+    vst1q_u32( H + 4, vaddq_u32( state1, efgh ) );
+}
+
+// Applies the compression function to the block of padding which follows a 64-byte message,
+// per c_sha256PaddingSchedule, and accumulates the result into the given hash value(s)
+void sha256_compress_padding_armv8(uint32_t* H) {
+
+    uint32x4_t state0 = vld1q_u32( H );
+    uint32x4_t state1 = vld1q_u32( H + 4 );
+    const uint32x4_t abcd = state0, efgh = state1;
+
+    // Apply the rounds, four at a time, with no message schedule to extend
+    for (uint32_t i = 0U; i < 16U; ++i){
+        const uint32x4_t msg = vld1q_u32( vkmr::c_sha256PaddingSchedule + (i << 2) );
+        const uint32x4_t tmp = state0;
+        state0 = vsha256hq_u32( state0, state1, msg );
+        state1 = vsha256h2q_u32( state1, tmp, msg );
+    }
+
+    // Accumulate
+    vst1q_u32( H, vaddq_u32( state0, abcd ) );
+    vst1q_u32( H + 4, vaddq_u32( state1, efgh ) );
+}
+
+} // namespace
+
+_VKMR_TARGET_END_
+
+namespace vkmr {
+
+// Functions
+//
+
+const CpuSha256Kernels* cpu_sha256_armv8_kernels(void) {
+
+    static const CpuSha256Kernels kernels = {
+        "ARMv8",
+        1U,
+        sha256_compress_armv8,
+        sha256d_64_1<sha256_compress_armv8, sha256_compress_padding_armv8>,
+        sha256d_n_1<sha256_compress_armv8>
+    };
+    return &kernels;
+}
+
+} // namespace vkmr
+
+#else
+namespace vkmr {
+
+const CpuSha256Kernels* cpu_sha256_armv8_kernels(void) { return nullptr; }
+
+} // namespace vkmr
+#endif // defined (_VKMR_ARM64_)
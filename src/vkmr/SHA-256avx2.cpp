@@ -0,0 +1,82 @@
+// SHA-256avx2.cpp: defines the function(s) for computing SHA-256 hashes of 8 buffers at once, with AVX2
+//
+
+// Includes
+//
+
+// Local Project Headers
+#include "SHA-256mb.h"
+
+#if defined (_VKMR_X86_)
+// Intrinsics
+#include <immintrin.h>
+
+_VKMR_TARGET_BEGIN_( "avx2" )
+
+// Local Project Headers
+#include "SHA-256lanes.h"
+
+namespace {
+
+// Types
+//
+
+struct Avx2Lanes {
+    typedef __m256i type;
+    typedef __m256i mask_type;
+
+    static const size_t lanes = 8U;
+
+    static inline type Set1(uint32_t u) { return _mm256_set1_epi32( static_cast<int>( u ) ); }
+    static inline type Load(const uint32_t* p) { return _mm256_load_si256( reinterpret_cast<const __m256i*>( p ) ); }
+    static inline void Store(uint32_t* p, type x) { _mm256_store_si256( reinterpret_cast<__m256i*>( p ), x ); }
+
+    static inline type Add(type x, type y) { return _mm256_add_epi32( x, y ); }
+    static inline type Xor(type x, type y) { return _mm256_xor_si256( x, y ); }
+    static inline type Xor3(type x, type y, type z) { return Xor( Xor( x, y ), z ); }
+    static inline type And(type x, type y) { return _mm256_and_si256( x, y ); }
+    static inline type Or(type x, type y) { return _mm256_or_si256( x, y ); }
+
+    template <int n>
+    static inline type Shr(type x) { return _mm256_srli_epi32( x, n ); }
+
+    template <int n>
+    static inline type Rotr(type x) { return Or( _mm256_srli_epi32( x, n ), _mm256_slli_epi32( x, 32 - n ) ); }
+
+    static inline type Choose(type x, type y, type z) { return Xor( And( x, y ), _mm256_andnot_si256( x, z ) ); }
+    static inline type Majority(type x, type y, type z) { return Or( And( x, y ), And( z, Or( x, y ) ) ); }
+
+    static inline mask_type Active(type n, uint32_t i) { return _mm256_cmpgt_epi32( n, Set1( i ) ); }
+    static inline type Select(mask_type m, type x, type y) { return _mm256_blendv_epi8( y, x, m ); }
+};
+
+} // namespace
+
+_VKMR_TARGET_END_
+
+namespace vkmr {
+
+// Functions
+//
+
+const CpuSha256Kernels* cpu_sha256_avx2_kernels(void) {
+
+    static const CpuSha256Kernels kernels = {
+        "AVX2",
+        Avx2Lanes::lanes,
+        nullptr,
+        sha256d_64_mb<Avx2Lanes>,
+        sha256d_n_mb<Avx2Lanes>
+    };
+    return &kernels;
+}
+
+} // namespace vkmr
+
+#else
+namespace vkmr {
+
+const CpuSha256Kernels* cpu_sha256_avx2_kernels(void) { return nullptr; }
+
+} // namespace vkmr
+#endif // defined (_VKMR_X86_)
@@ -0,0 +1,82 @@
+// SHA-256avx512.cpp: defines the function(s) for computing SHA-256 hashes of 16 buffers at once, with AVX-512
+//
+
+// Includes
+//
+
+// Local Project Headers
+#include "SHA-256mb.h"
+
+#if defined (_VKMR_X86_)
+// Intrinsics
+#include <immintrin.h>
+
+_VKMR_TARGET_BEGIN_( "avx512f" )
+
+// Local Project Headers
+#include "SHA-256lanes.h"
+
+namespace {
+
+// Types
+//
+
+struct Avx512Lanes {
+    typedef __m512i type;
+    typedef __mmask16 mask_type;
+
+    static const size_t lanes = 16U;
+
+    static inline type Set1(uint32_t u) { return _mm512_set1_epi32( static_cast<int>( u ) ); }
+    static inline type Load(const uint32_t* p) { return _mm512_load_si512( p ); }
+    static inline void Store(uint32_t* p, type x) { _mm512_store_si512( p, x ); }
+
+    static inline type Add(type x, type y) { return _mm512_add_epi32( x, y ); }
+    static inline type Xor(type x, type y) { return _mm512_xor_si512( x, y ); }
+    static inline type Xor3(type x, type y, type z) { return _mm512_ternarylogic_epi32( x, y, z, 0x96 ); }
+    static inline type And(type x, type y) { return _mm512_and_si512( x, y ); }
+    static inline type Or(type x, type y) { return _mm512_or_si512( x, y ); }
+
+    template <int n>
+    static inline type Shr(type x) { return _mm512_srli_epi32( x, n ); }
+
+    template <int n>
+    static inline type Rotr(type x) { return _mm512_ror_epi32( x, n ); }
+
+    static inline type Choose(type x, type y, type z) { return _mm512_ternarylogic_epi32( x, y, z, 0xCA ); }
+    static inline type Majority(type x, type y, type z) { return _mm512_ternarylogic_epi32( x, y, z, 0xE8 ); }
+
+    static inline mask_type Active(type n, uint32_t i) { return _mm512_cmpgt_epu32_mask( n, Set1( i ) ); }
+    static inline type Select(mask_type m, type x, type y) { return _mm512_mask_blend_epi32( m, y, x ); }
+};
+
+} // namespace
+
+_VKMR_TARGET_END_
+
+namespace vkmr {
+
+// Functions
+//
+
+const CpuSha256Kernels* cpu_sha256_avx512_kernels(void) {
+
+    static const CpuSha256Kernels kernels = {
+        "AVX-512",
+        Avx512Lanes::lanes,
+        nullptr,
+        sha256d_64_mb<Avx512Lanes>,
+        sha256d_n_mb<Avx512Lanes>
+    };
+    return &kernels;
+}
+
+} // namespace vkmr
+
+#else
+namespace vkmr {
+
+const CpuSha256Kernels* cpu_sha256_avx512_kernels(void) { return nullptr; }
+
+} // namespace vkmr
+#endif // defined (_VKMR_X86_)
@@ -0,0 +1,313 @@
+// SHA-256lanes.h: defines the templates for computing SHA-256 hashes of multiple buffers at once, one per SIMD
+//                 lane, or of one buffer at a time
+//
+// N.B. Each translation unit which instantiates these for a given instruction set includes this
+// header between _VKMR_TARGET_BEGIN_(...) and _VKMR_TARGET_END_, along with its traits (below)
+//
+
+#ifndef __VKMR_SHA_256_LANES_H__
+#define __VKMR_SHA_256_LANES_H__
+
+// Includes
+//
+
+// Local Project Headers
+#include "SHA-256mb.h"
+
+namespace vkmr {
+
+// Templates
+//
+// Each is parameterised by the traits of a SIMD vector of 32-bit lanes, V, which gives:
+// * type: the vector type, and mask_type: the type of the result of a lane-wise comparison;
+// * lanes: the number of 32-bit lanes in the vector type;
+// * Set1, Load and Store (aligned), Add, Xor, Xor3, And, Or, Shr<n> and Rotr<n>: the usual;
+// * Choose and Majority: as Ch and Maj;
+// * Active(n, i): the mask of lanes for which i < n;
+// * Select(m, x, y): x where the mask is set, y elsewhere.
+
+template <typename V>
+inline typename V::type mb_Sigma0(typename V::type x) {
+    return V::Xor3( V::template Rotr<2>( x ), V::template Rotr<13>( x ), V::template Rotr<22>( x ) );
+}
+
+template <typename V>
+inline typename V::type mb_Sigma1(typename V::type x) {
+    return V::Xor3( V::template Rotr<6>( x ), V::template Rotr<11>( x ), V::template Rotr<25>( x ) );
+}
+
+template <typename V>
+inline typename V::type mb_sigma0(typename V::type x) {
+    return V::Xor3( V::template Rotr<7>( x ), V::template Rotr<18>( x ), V::template Shr<3>( x ) );
+}
+
+template <typename V>
+inline typename V::type mb_sigma1(typename V::type x) {
+    return V::Xor3( V::template Rotr<17>( x ), V::template Rotr<19>( x ), V::template Shr<10>( x ) );
+}
+
+// Applies one round of the compression function to the given working variables, given
+// the sum of the constant and the word of the message schedule for the round
+template <typename V>
+inline void sha256_mb_round(typename V::type& a, typename V::type& b, typename V::type& c, typename V::type& d,
+                            typename V::type& e, typename V::type& f, typename V::type& g, typename V::type& h,
+                            typename V::type kw) {
+
+    typedef typename V::type T;
+
+    const T T1 = V::Add( V::Add( h, mb_Sigma1<V>( e ) ), V::Add( V::Choose( e, f, g ), kw ) );
+    const T T2 = V::Add( mb_Sigma0<V>( a ), V::Majority( a, b, c ) );
+    h = g;
+    g = f;
+    f = e;
+    e = V::Add( d, T1 );
+    d = c;
+    c = b;
+    b = a;
+    a = V::Add( T1, T2 );
+}
+
+// Applies the compression function to the given message block (which is overwritten)
+// and accumulates the result into the given state, lane-wise
+template <typename V>
+inline void sha256_mb_compress(typename V::type S[SHA256_WC], typename V::type W[SHA256_MESSAGE_BLOCK_WC]) {
+
+    typedef typename V::type T;
+
+    // Initialise the working variables
+    T a = S[0], b = S[1], c = S[2], d = S[3];
+    T e = S[4], f = S[5], g = S[6], h = S[7];
+
+    // Loop, keeping only the last 16 words of the message schedule
+    for (uint32_t t = 0U; t < 64U; ++t){
+        T& w = W[t & 15U];
+        if (t >= SHA256_MESSAGE_BLOCK_WC){
+            w = V::Add(
+                V::Add( mb_sigma1<V>( W[(t - 2U) & 15U] ), W[(t - 7U) & 15U] ),
+                V::Add( mb_sigma0<V>( W[(t - 15U) & 15U] ), w )
+            );
+        }
+        sha256_mb_round<V>( a, b, c, d, e, f, g, h, V::Add( w, V::Set1( c_sha256Constants[t] ) ) );
+    }
+
+    // Accumulate
+    S[0] = V::Add( S[0], a );
+    S[1] = V::Add( S[1], b );
+    S[2] = V::Add( S[2], c );
+    S[3] = V::Add( S[3], d );
+    S[4] = V::Add( S[4], e );
+    S[5] = V::Add( S[5], f );
+    S[6] = V::Add( S[6], g );
+    S[7] = V::Add( S[7], h );
+}
+
+// Applies the compression function to the block of padding which follows a 64-byte message,
+// per c_sha256PaddingSchedule, and accumulates the result into the given state, lane-wise
+template <typename V>
+inline void sha256_mb_compress_padding(typename V::type S[SHA256_WC]) {
+
+    typedef typename V::type T;
+
+    // Initialise the working variables
+    T a = S[0], b = S[1], c = S[2], d = S[3];
+    T e = S[4], f = S[5], g = S[6], h = S[7];
+
+    // Loop
+    for (uint32_t t = 0U; t < 64U; ++t){
+        sha256_mb_round<V>( a, b, c, d, e, f, g, h, V::Set1( c_sha256PaddingSchedule[t] ) );
+    }
+
+    // Accumulate
+    S[0] = V::Add( S[0], a );
+    S[1] = V::Add( S[1], b );
+    S[2] = V::Add( S[2], c );
+    S[3] = V::Add( S[3], d );
+    S[4] = V::Add( S[4], e );
+    S[5] = V::Add( S[5], f );
+    S[6] = V::Add( S[6], g );
+    S[7] = V::Add( S[7], h );
+}
+
+// Replaces the given (final) SHA-256 state with the SHA-256 of its big-endian bytes
+template <typename V>
+inline void sha256_mb_rehash(typename V::type S[SHA256_WC]) {
+
+    typename V::type W[SHA256_MESSAGE_BLOCK_WC];
+    uint32_t w = 0U;
+    for ( ; w < SHA256_WC; ++w){
+        W[w] = S[w];
+        S[w] = V::Set1( c_sha256Initial[w] );
+    }
+    W[w++] = V::Set1( 0x80000000 );
+    for ( ; w < (SHA256_MESSAGE_BLOCK_WC - 1U); ++w){
+        W[w] = V::Set1( 0U );
+    }
+    W[w] = V::Set1( SHA256_WC * 32U );
+    sha256_mb_compress<V>( S, W );
+}
+
+// Transposes the given (final) SHA-256 state out of the lanes and into the given
+// number of consecutive 8-word outputs, via the given (aligned) buffer
+template <typename V>
+inline void sha256_mb_store(typename V::type S[SHA256_WC], uint32_t* buffer, uint32_t* out, size_t active) {
+
+    for (uint32_t k = 0U; k < SHA256_WC; ++k){
+        V::Store( buffer + (k * V::lanes), S[k] );
+    }
+    for (size_t l = 0U; l < active; ++l){
+        for (uint32_t k = 0U; k < SHA256_WC; ++k){
+            out[(l * SHA256_WC) + k] = buffer[(k * V::lanes) + l];
+        }
+    }
+}
+
+// Computes the SHA-256d of each of the given number of 64-byte messages
+template <typename V>
+void sha256d_64_mb(const uint32_t* in, uint32_t* out, size_t count) {
+
+    typedef typename V::type T;
+    const size_t lanes = V::lanes;
+    alignas(64) uint32_t buffer[SHA256_MESSAGE_BLOCK_WC * V::lanes];
+
+    for (size_t n = 0U; n < count; n += lanes){
+        // Transpose the messages into the buffer; any unused lanes
+        // just repeat the last message, and are ignored
+        const size_t active = ((count - n) < lanes) ? (count - n) : lanes;
+        for (size_t l = 0U; l < lanes; ++l){
+            const uint32_t* M = in + ((n + ((l < active) ? l : (active - 1U))) * SHA256_MESSAGE_BLOCK_WC);
+            for (uint32_t w = 0U; w < SHA256_MESSAGE_BLOCK_WC; ++w){
+                buffer[(w * lanes) + l] = M[w];
+            }
+        }
+
+        // Compress the message block
+        T S[SHA256_WC], W[SHA256_MESSAGE_BLOCK_WC];
+        for (uint32_t w = 0U; w < SHA256_MESSAGE_BLOCK_WC; ++w){
+            W[w] = V::Load( buffer + (w * lanes) );
+        }
+        for (uint32_t k = 0U; k < SHA256_WC; ++k){
+            S[k] = V::Set1( c_sha256Initial[k] );
+        }
+        sha256_mb_compress<V>( S, W );
+
+        // Compress the padding block
+        sha256_mb_compress_padding<V>( S );
+
+        // Apply the second round of hashing, and transpose back out
+        sha256_mb_rehash<V>( S );
+        sha256_mb_store<V>( S, buffer, out + (n * SHA256_WC), active );
+    }
+}
+
+// Computes the SHA-256d of each of the given number of messages
+template <typename V>
+void sha256d_n_mb(const uint8_t* const* data, const size_t* sizes, uint32_t* out, size_t count) {
+
+    typedef typename V::type T;
+    const size_t lanes = V::lanes;
+    alignas(64) uint32_t buffer[SHA256_MESSAGE_BLOCK_WC * V::lanes];
+    alignas(64) uint32_t blocks[V::lanes];
+
+    for (size_t n = 0U; n < count; n += lanes){
+        // Count the blocks in each lane
+        const size_t active = ((count - n) < lanes) ? (count - n) : lanes;
+        uint32_t least = 0U, most = 0U;
+        for (size_t l = 0U; l < lanes; ++l){
+            blocks[l] = (l < active) ? static_cast<uint32_t>( sha256_block_count( sizes[n + l] ) ) : 0U;
+            least = ((l == 0U) || (blocks[l] < least)) ? blocks[l] : least;
+            most = (blocks[l] > most) ? blocks[l] : most;
+        }
+        const T N = V::Load( blocks );
+
+        // Process each block in every lane, leaving the state of any
+        // lanes which have run out of blocks untouched
+        T S[SHA256_WC], W[SHA256_MESSAGE_BLOCK_WC];
+        for (uint32_t k = 0U; k < SHA256_WC; ++k){
+            S[k] = V::Set1( c_sha256Initial[k] );
+        }
+        for (uint32_t i = 0U; i < most; ++i){
+            for (size_t l = 0U; l < lanes; ++l){
+                if (i < blocks[l]){
+                    sha256_block( data[n + l], sizes[n + l], i, buffer + l, lanes );
+                }else{
+                    for (uint32_t w = 0U; w < SHA256_MESSAGE_BLOCK_WC; ++w){
+                        buffer[(w * lanes) + l] = 0U;
+                    }
+                }
+            }
+            for (uint32_t w = 0U; w < SHA256_MESSAGE_BLOCK_WC; ++w){
+                W[w] = V::Load( buffer + (w * lanes) );
+            }
+            if (i < least){
+                sha256_mb_compress<V>( S, W );
+                continue;
+            }
+
+            T H[SHA256_WC];
+            for (uint32_t k = 0U; k < SHA256_WC; ++k){
+                H[k] = S[k];
+            }
+            sha256_mb_compress<V>( S, W );
+            const typename V::mask_type mask = V::Active( N, i );
+            for (uint32_t k = 0U; k < SHA256_WC; ++k){
+                S[k] = V::Select( mask, S[k], H[k] );
+            }
+        }
+
+        // Apply the second round of hashing, and transpose back out
+        sha256_mb_rehash<V>( S );
+        sha256_mb_store<V>( S, buffer, out + (n * SHA256_WC), active );
+    }
+}
+
+// Each of the following is parameterised by a function which applies the compression function
+// to a single message block, as for CpuSha256Kernels::compress, and/or one which applies it
+// to the block of padding which follows a 64-byte message, per c_sha256PaddingSchedule
+
+// Computes the SHA-256 of the given (final) hash value(s), as big-endian bytes
+template <void (*compress)(uint32_t*, const uint32_t*)>
+inline void sha256_rehash_1(const uint32_t* H, uint32_t* out) {
+
+    uint32_t M[SHA256_MESSAGE_BLOCK_WC] = { 0U };
+    ::std::memcpy( M, H, sizeof( uint32_t ) * SHA256_WC );
+    M[SHA256_WC] = 0x80000000;
+    M[SHA256_MESSAGE_BLOCK_WC - 1U] = SHA256_WC * 32U;
+
+    ::std::memcpy( out, c_sha256Initial, sizeof( uint32_t ) * SHA256_WC );
+    compress( out, M );
+}
+
+// Computes the SHA-256d of each of the given number of 64-byte messages, one at a time
+template <void (*compress)(uint32_t*, const uint32_t*), void (*compress_padding)(uint32_t*)>
+void sha256d_64_1(const uint32_t* in, uint32_t* out, size_t count) {
+
+    for (size_t n = 0U; n < count; ++n, in += SHA256_MESSAGE_BLOCK_WC, out += SHA256_WC){
+        uint32_t H[SHA256_WC];
+        ::std::memcpy( H, c_sha256Initial, sizeof( H ) );
+        compress( H, in );
+        compress_padding( H );
+        sha256_rehash_1<compress>( H, out );
+    }
+}
+
+// Computes the SHA-256d of each of the given number of messages, one at a time
+template <void (*compress)(uint32_t*, const uint32_t*)>
+void sha256d_n_1(const uint8_t* const* data, const size_t* sizes, uint32_t* out, size_t count) {
+
+    for (size_t n = 0U; n < count; ++n, out += SHA256_WC){
+        uint32_t H[SHA256_WC];
+        ::std::memcpy( H, c_sha256Initial, sizeof( H ) );
+
+        const size_t N = sha256_block_count( sizes[n] );
+        for (size_t i = 0U; i < N; ++i){
+            uint32_t M[SHA256_MESSAGE_BLOCK_WC];
+            sha256_block( data[n], sizes[n], i, M );
+            compress( H, M );
+        }
+        sha256_rehash_1<compress>( H, out );
+    }
+}
+
+} // namespace vkmr
+
+#endif // __VKMR_SHA_256_LANES_H__
@@ -0,0 +1,131 @@
+// SHA-256mb.h: declares the types and functions for computing SHA-256 hashes of multiple buffers at once
+//
+
+#ifndef __VKMR_SHA_256_MB_H__
+#define __VKMR_SHA_256_MB_H__
+
+// Includes
+//
+
+// C Standard Library Headers
+#include <stdint.h>
+#include <stddef.h>
+
+// C++ Standard Library Headers
+#include <cstring>
+
+// Local Project Headers
+#include "../common/SHA-256defs.h"
+
+// Macros
+//
+
+#if defined (_M_X64) || defined (_M_IX86) || defined (__x86_64__) || defined (__i386__)
+#define _VKMR_X86_
+#elif defined (_M_ARM64) || defined (__aarch64__)
+#define _VKMR_ARM64_
+#endif
+
+// Bracket code which is to use a given instruction set, so that GCC and Clang will
+// emit those instructions without needing per-file compiler flags (MSVC always will)
+#if defined (__clang__)
+#define _VKMR_PRAGMA_(x) _Pragma( #x )
+#define _VKMR_TARGET_BEGIN_(isa) _VKMR_PRAGMA_( clang attribute push (__attribute__((target(isa))), apply_to = function) )
+#define _VKMR_TARGET_END_ _VKMR_PRAGMA_( clang attribute pop )
+#elif defined (__GNUC__)
+#define _VKMR_PRAGMA_(x) _Pragma( #x )
+#define _VKMR_TARGET_BEGIN_(isa) _VKMR_PRAGMA_( GCC push_options ) _VKMR_PRAGMA_( GCC target( isa ) )
+#define _VKMR_TARGET_END_ _VKMR_PRAGMA_( GCC pop_options )
+#else
+#define _VKMR_TARGET_BEGIN_(isa)
+#define _VKMR_TARGET_END_
+#endif
+
+namespace vkmr {
+
+// Types
+//
+
+// A table of kernels which each compute the SHA-256d of a number of messages,
+// as many at a time as there are lanes
+struct CpuSha256Kernels {
+    // Gives the name of the instruction set
+    const char* name;
+
+    // Gives the number of messages processed at a time
+    size_t lanes;
+
+    // Applies the compression function to a single message block (of big-endian
+    // words) and accumulates the result into the given hash value(s); this is
+    // null for kernels which only work across lanes
+    void (*compress)(uint32_t*, const uint32_t*);
+
+    // Computes the SHA-256d of each of the given number of 64-byte messages,
+    // given as 16 (big-endian) words apiece, and writes out 8 words apiece;
+    // the output may overwrite the input, so as to reduce a level in place
+    void (*sha256d_64)(const uint32_t*, uint32_t*, size_t);
+
+    // Computes the SHA-256d of each of the given number of messages, given as
+    // pointers and sizes, and writes out 8 (big-endian) words apiece
+    void (*sha256d_n)(const uint8_t* const*, const size_t*, uint32_t*, size_t);
+};
+
+// Constants
+//
+
+extern const uint32_t c_sha256Constants[64];
+extern const uint32_t c_sha256Initial[SHA256_WC];
+
+// Gives the constants plus the message schedule of the block of padding which follows any 64-byte
+// message (i.e. the second block compressed for every node above the leaves), for skipping both
+extern const uint32_t c_sha256PaddingSchedule[64];
+
+// Functions
+//
+
+// Return the kernels for the given instruction set, or null if they are not available in this build
+const CpuSha256Kernels* cpu_sha256_sse2_kernels(void);
+const CpuSha256Kernels* cpu_sha256_avx2_kernels(void);
+const CpuSha256Kernels* cpu_sha256_avx512_kernels(void);
+const CpuSha256Kernels* cpu_sha256_shani_kernels(void);
+const CpuSha256Kernels* cpu_sha256_armv8_kernels(void);
+
+// Returns the number of message blocks in the padded form of a message of the given size
+static inline size_t sha256_block_count(size_t size) {
+    return (size + 8U + SHA256_MESSAGE_BLOCK_BYTE_SIZE) / SHA256_MESSAGE_BLOCK_BYTE_SIZE;
+}
+
+// Fills in the i-th block of the padded form of the given message, as
+// big-endian words, each the given number of words apart
+static inline void sha256_block(const uint8_t* p, size_t size, size_t i, uint32_t* W, size_t stride = 1U) {
+
+    const size_t offset = i * SHA256_MESSAGE_BLOCK_BYTE_SIZE;
+    const uint8_t* q = p + offset;
+    uint8_t B[SHA256_MESSAGE_BLOCK_BYTE_SIZE];
+    if ((offset + SHA256_MESSAGE_BLOCK_BYTE_SIZE) > size){
+        // At least some of this block is padding
+        ::std::memset( B, 0, sizeof( B ) );
+        if (offset <= size){
+            if (offset < size){
+                ::std::memcpy( B, q, size - offset );
+            }
+            B[size - offset] = 0x80;
+        }
+
+        // The last block ends with the size of the message, in bits
+        if ((i + 1U) == sha256_block_count( size )){
+            const uint64_t bits = static_cast<uint64_t>( size ) << 3;
+            for (uint32_t k = 0U; k < 8U; ++k){
+                B[sizeof( B ) - (k + 1U)] = static_cast<uint8_t>( bits >> (k << 3) );
+            }
+        }
+        q = B;
+    }
+    for (uint32_t w = 0U; w < SHA256_MESSAGE_BLOCK_WC; ++w, q += 4){
+        W[w * stride] = (uint32_t( q[0] ) << 24) | (uint32_t( q[1] ) << 16) | (uint32_t( q[2] ) << 8) | uint32_t( q[3] );
+    }
+}
+
+} // namespace vkmr
+
+#endif // __VKMR_SHA_256_MB_H__
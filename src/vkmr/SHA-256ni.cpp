@@ -0,0 +1,253 @@
+// SHA-256ni.cpp: defines the function(s) for computing SHA-256 hashes with the Intel SHA extensions
+//
+
+// Includes
+//
+
+// Local Project Headers
+#include "SHA-256mb.h"
+
+#if defined (_VKMR_X86_)
+// Intrinsics
+#include <immintrin.h>
+
+_VKMR_TARGET_BEGIN_( "sha,sse4.1" )
+
+// Local Project Headers
+#include "SHA-256lanes.h"
+
+namespace {
+
+// Functions
+//
+
+// Applies the i-th four rounds to each of the given number of states, given the corresponding
+// current, previous and next four words of the message schedule (extending it as it goes)
+template <uint32_t i, size_t streams>
+inline void sha256_rounds_ni(__m128i* state0, __m128i* state1, __m128i* current, __m128i* previous, __m128i* next) {
+
+    const __m128i k = _mm_loadu_si128( reinterpret_cast<const __m128i*>( vkmr::c_sha256Constants + (i << 2) ) );
+    for (size_t s = 0U; s < streams; ++s){
+        __m128i msg = _mm_add_epi32( current[s], k );
+        state1[s] = _mm_sha256rnds2_epu32( state1[s], state0[s], msg );
+        if ((i >= 3U) && (i < 15U)){
+            next[s] = _mm_add_epi32( next[s], _mm_alignr_epi8( current[s], previous[s], 4 ) );
+            next[s] = _mm_sha256msg2_epu32( next[s], current[s] );
+        }
+        msg = _mm_shuffle_epi32( msg, 0x0E );
+        state0[s] = _mm_sha256rnds2_epu32( state0[s], state1[s], msg );
+        if ((i >= 1U) && (i < 13U)){
+            previous[s] = _mm_sha256msg1_epu32( previous[s], current[s] );
+        }
+    }
+}
+
+// Loads the given hash value(s) and shuffles them into the order which the instructions expect: ABEF and CDGH
+inline void sha256_load_ni(const uint32_t* H, __m128i& state0, __m128i& state1) {
+
+    const __m128i tmp = _mm_shuffle_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( H ) ), 0xB1 );
+    state1 = _mm_shuffle_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( H + 4 ) ), 0x1B );
+    state0 = _mm_alignr_epi8( tmp, state1, 8 );
+    state1 = _mm_blend_epi16( state1, tmp, 0xF0 );
+}
+
+// Shuffles the given state back into the order of the hash value(s), and stores them
+inline void sha256_store_ni(__m128i state0, __m128i state1, uint32_t* H) {
+
+    const __m128i tmp = _mm_shuffle_epi32( state0, 0x1B );
+    state1 = _mm_shuffle_epi32( state1, 0xB1 );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( H ), _mm_blend_epi16( tmp, state1, 0xF0 ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( H + 4 ), _mm_alignr_epi8( state1, tmp, 8 ) );
+}
+
+// Applies the compression function to each of the given number of message blocks (of big-endian
+// words) and accumulates the results into the corresponding hash value(s); interleaving them
+// hides the latency of the round instructions
+template <size_t streams>
+inline void sha256_compress_ni_n(uint32_t* const* H, const uint32_t* const* M) {
+
+    __m128i state0[streams], state1[streams], abef[streams], cdgh[streams];
+    __m128i W0[streams], W1[streams], W2[streams], W3[streams];
+    for (size_t s = 0U; s < streams; ++s){
+        sha256_load_ni( H[s], state0[s], state1[s] );
+        abef[s] = state0[s];
+        cdgh[s] = state1[s];
+
+        // Load the message block; its words are already big-endian values
+        W0[s] = _mm_loadu_si128( reinterpret_cast<const __m128i*>( M[s] ) );
+        W1[s] = _mm_loadu_si128( reinterpret_cast<const __m128i*>( M[s] + 4 ) );
+        W2[s] = _mm_loadu_si128( reinterpret_cast<const __m128i*>( M[s] + 8 ) );
+        W3[s] = _mm_loadu_si128( reinterpret_cast<const __m128i*>( M[s] + 12 ) );
+    }
+
+    // Apply the rounds, four at a time
+    sha256_rounds_ni<0U, streams>( state0, state1, W0, W3, W1 );
+    sha256_rounds_ni<1U, streams>( state0, state1, W1, W0, W2 );
+    sha256_rounds_ni<2U, streams>( state0, state1, W2, W1, W3 );
+    sha256_rounds_ni<3U, streams>( state0, state1, W3, W2, W0 );
+    sha256_rounds_ni<4U, streams>( state0, state1, W0, W3, W1 );
+    sha256_rounds_ni<5U, streams>( state0, state1, W1, W0, W2 );
+    sha256_rounds_ni<6U, streams>( state0, state1, W2, W1, W3 );
+    sha256_rounds_ni<7U, streams>( state0, state1, W3, W2, W0 );
+    sha256_rounds_ni<8U, streams>( state0, state1, W0, W3, W1 );
+    sha256_rounds_ni<9U, streams>( state0, state1, W1, W0, W2 );
+    sha256_rounds_ni<10U, streams>( state0, state1, W2, W1, W3 );
+    sha256_rounds_ni<11U, streams>( state0, state1, W3, W2, W0 );
+    sha256_rounds_ni<12U, streams>( state0, state1, W0, W3, W1 );
+    sha256_rounds_ni<13U, streams>( state0, state1, W1, W0, W2 );
+    sha256_rounds_ni<14U, streams>( state0, state1, W2, W1, W3 );
+    sha256_rounds_ni<15U, streams>( state0, state1, W3, W2, W0 );
+
+    // Accumulate
+    for (size_t s = 0U; s < streams; ++s){
+        sha256_store_ni( _mm_add_epi32( state0[s], abef[s] ), _mm_add_epi32( state1[s], cdgh[s] ), H[s] );
+    }
+}
+
+// Applies the compression function to the block of padding which follows a 64-byte message, per
+// c_sha256PaddingSchedule, and accumulates the results into each of the given number of hash value(s)
+template <size_t streams>
+inline void sha256_compress_padding_ni_n(uint32_t* const* H) {
+
+    __m128i state0[streams], state1[streams], abef[streams], cdgh[streams];
+    for (size_t s = 0U; s < streams; ++s){
+        sha256_load_ni( H[s], state0[s], state1[s] );
+        abef[s] = state0[s];
+        cdgh[s] = state1[s];
+    }
+
+    // Apply the rounds, four at a time, with no message schedule to extend
+    for (uint32_t i = 0U; i < 16U; ++i){
+        const __m128i msg = _mm_loadu_si128( reinterpret_cast<const __m128i*>( vkmr::c_sha256PaddingSchedule + (i << 2) ) );
+        const __m128i next = _mm_shuffle_epi32( msg, 0x0E );
+        for (size_t s = 0U; s < streams; ++s){
+            state1[s] = _mm_sha256rnds2_epu32( state1[s], state0[s], msg );
+            state0[s] = _mm_sha256rnds2_epu32( state0[s], state1[s], next );
+        }
+    }
+
+    // Accumulate
+    for (size_t s = 0U; s < streams; ++s){
+        sha256_store_ni( _mm_add_epi32( state0[s], abef[s] ), _mm_add_epi32( state1[s], cdgh[s] ), H[s] );
+    }
+}
+
+void sha256_compress_ni(uint32_t* H, const uint32_t* M) {
+    sha256_compress_ni_n<1U>( &H, &M );
+}
+
+void sha256_compress_padding_ni(uint32_t* H) {
+    sha256_compress_padding_ni_n<1U>( &H );
+}
+
+// Computes the SHA-256d of each of the given number of 64-byte messages, two at a time
+void sha256d_64_ni(const uint32_t* in, uint32_t* out, size_t count) {
+
+    size_t n = 0U;
+    for ( ; (n + 2U) <= count; n += 2U){
+        uint32_t H0[SHA256_WC], H1[SHA256_WC];
+        ::std::memcpy( H0, vkmr::c_sha256Initial, sizeof( H0 ) );
+        ::std::memcpy( H1, vkmr::c_sha256Initial, sizeof( H1 ) );
+        uint32_t* H[] = { H0, H1 };
+
+        const uint32_t* M[] = { in + (n * SHA256_MESSAGE_BLOCK_WC), in + ((n + 1U) * SHA256_MESSAGE_BLOCK_WC) };
+        sha256_compress_ni_n<2U>( H, M );
+        sha256_compress_padding_ni_n<2U>( H );
+
+        // Hash the hashes
+        uint32_t M0[SHA256_MESSAGE_BLOCK_WC] = { 0U }, M1[SHA256_MESSAGE_BLOCK_WC] = { 0U };
+        ::std::memcpy( M0, H0, sizeof( H0 ) );
+        ::std::memcpy( M1, H1, sizeof( H1 ) );
+        M0[SHA256_WC] = M1[SHA256_WC] = 0x80000000;
+        M0[SHA256_MESSAGE_BLOCK_WC - 1U] = M1[SHA256_MESSAGE_BLOCK_WC - 1U] = SHA256_WC * 32U;
+        H[0] = out + (n * SHA256_WC);
+        H[1] = out + ((n + 1U) * SHA256_WC);
+        ::std::memcpy( H[0], vkmr::c_sha256Initial, sizeof( H0 ) );
+        ::std::memcpy( H[1], vkmr::c_sha256Initial, sizeof( H1 ) );
+        M[0] = M0;
+        M[1] = M1;
+        sha256_compress_ni_n<2U>( H, M );
+    }
+    if (n < count){
+        vkmr::sha256d_64_1<sha256_compress_ni, sha256_compress_padding_ni>( in + (n * SHA256_MESSAGE_BLOCK_WC), out + (n * SHA256_WC), count - n );
+    }
+}
+
+// Computes the SHA-256d of each of the given number of messages, two at a time
+void sha256d_n_ni(const uint8_t* const* data, const size_t* sizes, uint32_t* out, size_t count) {
+
+    size_t n = 0U;
+    for ( ; (n + 2U) <= count; n += 2U){
+        uint32_t H0[SHA256_WC], H1[SHA256_WC];
+        ::std::memcpy( H0, vkmr::c_sha256Initial, sizeof( H0 ) );
+        ::std::memcpy( H1, vkmr::c_sha256Initial, sizeof( H1 ) );
+        uint32_t* H[] = { H0, H1 };
+
+        // Compress the blocks the two messages have in common side-by-side,
+        // and then any left over from the longer one by itself
+        uint32_t M0[SHA256_MESSAGE_BLOCK_WC], M1[SHA256_MESSAGE_BLOCK_WC];
+        const uint32_t* M[] = { M0, M1 };
+        const size_t N0 = vkmr::sha256_block_count( sizes[n] ), N1 = vkmr::sha256_block_count( sizes[n + 1U] );
+        size_t i = 0U;
+        for ( ; (i < N0) && (i < N1); ++i){
+            vkmr::sha256_block( data[n], sizes[n], i, M0 );
+            vkmr::sha256_block( data[n + 1U], sizes[n + 1U], i, M1 );
+            sha256_compress_ni_n<2U>( H, M );
+        }
+        for ( ; i < N0; ++i){
+            vkmr::sha256_block( data[n], sizes[n], i, M0 );
+            sha256_compress_ni( H0, M0 );
+        }
+        for ( ; i < N1; ++i){
+            vkmr::sha256_block( data[n + 1U], sizes[n + 1U], i, M1 );
+            sha256_compress_ni( H1, M1 );
+        }
+
+        // Hash the hashes
+        ::std::memset( M0, 0, sizeof( M0 ) );
+        ::std::memset( M1, 0, sizeof( M1 ) );
+        ::std::memcpy( M0, H0, sizeof( H0 ) );
+        ::std::memcpy( M1, H1, sizeof( H1 ) );
+        M0[SHA256_WC] = M1[SHA256_WC] = 0x80000000;
+        M0[SHA256_MESSAGE_BLOCK_WC - 1U] = M1[SHA256_MESSAGE_BLOCK_WC - 1U] = SHA256_WC * 32U;
+        H[0] = out + (n * SHA256_WC);
+        H[1] = out + ((n + 1U) * SHA256_WC);
+        ::std::memcpy( H[0], vkmr::c_sha256Initial, sizeof( H0 ) );
+        ::std::memcpy( H[1], vkmr::c_sha256Initial, sizeof( H1 ) );
+        sha256_compress_ni_n<2U>( H, M );
+    }
+    if (n < count){
+        vkmr::sha256d_n_1<sha256_compress_ni>( data + n, sizes + n, out + (n * SHA256_WC), count - n );
+    }
+}
+
+} // namespace
+
+_VKMR_TARGET_END_
+
+namespace vkmr {
+
+// Functions
+//
+
+const CpuSha256Kernels* cpu_sha256_shani_kernels(void) {
+
+    static const CpuSha256Kernels kernels = {
+        "SHA-NI",
+        1U,
+        sha256_compress_ni,
+        sha256d_64_ni,
+        sha256d_n_ni
+    };
+    return &kernels;
+}
+
+} // namespace vkmr
+
+#else
+namespace vkmr {
+
+const CpuSha256Kernels* cpu_sha256_shani_kernels(void) { return nullptr; }
+
+} // namespace vkmr
+#endif // defined (_VKMR_X86_)
@@ -12,16 +12,34 @@
 #endif // defined (_WIN32)
 
 // C++ Headers
+#include <cstdlib>
 #include <cstring>
 #include <iomanip>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <new>
 
 // Local Project Headers
 #include "Debug.h"
+#include "Workers.h"
+#include "StopWatch.h"
+#include "SHA-256lanes.h"
 #include "../common/SHA-256defs.h"
 
+// Intrinsics & Feature Detection
+#if defined (_VKMR_X86_)
+#if defined (_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined (_VKMR_ARM64_) && defined (__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif // defined (_VKMR_X86_)
+
 // Definitions & declarations
 #include "SHA-256plus.h"
 
@@ -43,34 +61,10 @@
 #define GET_U32_BE(x) (x)
 #endif
 
-#define SWOP_ENDS_U64(x) \
-	(((x) >> 56) & 0x00000000000000FF)	| \
-	(((x) >> 40) & 0x000000000000FF00)	| \
-	(((x) >> 24) & 0x0000000000FF0000)	| \
-	(((x) >> 8) & 0x00000000FF000000)	| \
-	(((x) << 8) & 0x000000FF00000000)	| \
-	(((x) << 24) & 0x0000FF0000000000)	| \
-	(((x) << 40) & 0x00FF000000000000)	| \
-	(((x) << 56) & 0xFF00000000000000)
-
-#ifdef __LITTLE_ENDIAN__ 
-#define GET_U64_BE(x) SWOP_ENDS_U64(x)
-#else
-#define GET_U64_BE(x) (x)
-#endif
-
-#define clear_message_block(M, words) \
-	do { \
-		volatile uint32_t* volatile m = M; \
-		for (auto w = 0; w < words; ++w){ \
-			(*m++) = 0U; \
-		} \
-	} while (0)
-
 // Constants
 //
 
-static const uint32_t c_constants[] = { 0x428a2f98, 0x71374491, 0xb5c0fbcf,
+const uint32_t vkmr::c_sha256Constants[64] = { 0x428a2f98, 0x71374491, 0xb5c0fbcf,
 										0xe9b5dba5, 0x3956c25b, 0x59f111f1,
 										0x923f82a4, 0xab1c5ed5, 0xd807aa98,
 										0x12835b01, 0x243185be, 0x550c7dc3,
@@ -93,184 +87,256 @@ static const uint32_t c_constants[] = { 0x428a2f98, 0x71374491, 0xb5c0fbcf,
 										0x90befffa, 0xa4506ceb, 0xbef9a3f7,
 										0xc67178f2 };
 
+const uint32_t vkmr::c_sha256Initial[SHA256_WC] = {
+	0x6a09e667,
+	0xbb67ae85,
+	0x3c6ef372,
+	0xa54ff53a,
+	0x510e527f,
+	0x9b05688c,
+	0x1f83d9ab,
+	0x5be0cd19
+};
+
+const uint32_t vkmr::c_sha256PaddingSchedule[64] = {
+	0xc28a2f98, 0x71374491, 0xb5c0fbcf,
+	0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+	0x923f82a4, 0xab1c5ed5, 0xd807aa98,
+	0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+	0xc19bf374, 0x649b69c1, 0xf0fe4786,
+	0x0fe1edc6, 0x240cf254, 0x4fe9346f,
+	0x6cc984be, 0x61b9411e, 0x16f988fa,
+	0xf2c65152, 0xa88e5a6d, 0xb019fc65,
+	0xb9d99ec7, 0x9a1231c3, 0xe70eeaa0,
+	0xfdb1232b, 0xc7353eb0, 0x3069bad5,
+	0xcb976d5f, 0x5a0f118f, 0xdc1eeefd,
+	0x0a35b689, 0xde0b7a04, 0x58f4ca9d,
+	0xe15d5b16, 0x007f3e86, 0x37088980,
+	0xa507ea32, 0x6fab9537, 0x17406110,
+	0x0d8cd6f1, 0xcdaa3b6d, 0xc0bbbe37,
+	0x83613bda, 0xdb48a363, 0x0b02e931,
+	0x6fd15ca7, 0x521afaca, 0x31338431,
+	0x6ed41a95, 0x6d437890, 0xc39c91f2,
+	0x9eccabbd, 0xb5c9a0e6, 0x532fb63c,
+	0xd2c741c6, 0x07237ea3, 0xa4954b68,
+	0x4c191d76
+};
+
+// The number of messages handed to the kernels at a time
+static const size_t c_messagesPerCall = 64U;
+
 // Functions
 //
 
-static void append_message_block(uint32_t* M, uint32_t size, size_t bytes) {
+// Applies the rounds of the compression function, given the sums of the constants and
+// the message schedule, and accumulates the result into the given hash value(s)
+static void cpu_sha256_rounds(uint32_t* H, const uint32_t* KW) {
 
-	const auto bits = GET_U64_BE( static_cast<uint64_t>( bytes ) << 3 );
-
-	uint32_t bottom = 0;
-	bottom |= (((uint32_t) (bits >> 56)) & 0xFF) << 24;
-	bottom |= (((uint32_t) (bits >> 48)) & 0xFF) << 16;
-	bottom |= (((uint32_t) (bits >> 40)) & 0xFF) << 8;
-	bottom |= (((uint32_t) (bits >> 32)) & 0xFF);
+	// Initialise the working variables
+	uint32_t a = H[0];
+	uint32_t b = H[1];
+	uint32_t c = H[2];
+	uint32_t d = H[3];
+	uint32_t e = H[4];
+	uint32_t f = H[5];
+	uint32_t g = H[6];
+	uint32_t h = H[7];
 
-	uint32_t top = 0;
-	top |= (((uint32_t) (bits >> 24)) & 0xFF) << 24;
-	top |= (((uint32_t) (bits >> 16)) & 0xFF) << 16;
-	top |= (((uint32_t) (bits >> 8)) & 0xFF) << 8;
-	top |= (((uint32_t) bits) & 0xFF);
+	// Loop
+	for (auto t = 0; t < 64; ++t){
+		auto T1 = h + Sigma1( e ) + Ch( e, f, g ) + KW[t];
+		auto T2 = Sigma0( a ) + Maj( a, b, c );
+		h = g;
+		g = f;
+		f = e;
+		e = d + T1;
+		d = c;
+		c = b;
+		b = a;
+		a = T1 + T2;
+	}
 
-	M[size-1] = bottom;
-	M[size-2] = top;
+	// Compute the intermediate hash value
+	H[0] = a + H[0];
+	H[1] = b + H[1];
+	H[2] = c + H[2];
+	H[3] = d + H[3];
+	H[4] = e + H[4];
+	H[5] = f + H[5];
+	H[6] = g + H[6];
+	H[7] = h + H[7];
 }
 
-static std::vector<uint32_t> cpu_sha256_n(const std::string& s) {
-
-	// Set the initial hash value(s)
-	uint32_t H[] = {
-		0x6a09e667,
-		0xbb67ae85,
-		0x3c6ef372,
-		0xa54ff53a,
-		0x510e527f,
-		0x9b05688c,
-		0x1f83d9ab,
-		0x5be0cd19
-	};
-
-	const auto block_size = (512 / 8);
-	const auto words = (block_size / sizeof( uint32_t ));
+// Applies the compression function to the given message block (of big-endian
+// words) and accumulates the result into the given hash value(s)
+static void cpu_sha256_compress_scalar(uint32_t* H, const uint32_t* M) {
 
-	// Get 'N', the number of blocks
-	const auto size = s.size( );
-	auto N = static_cast<uint32_t>( size / block_size );
-	if (size % block_size){
-		N++;
+	// Prep the message schedule, plus the constants
+	uint32_t W[64], KW[64];
+	for (auto t = 0; t < 64; ++t){
+		if (t < SHA256_MESSAGE_BLOCK_WC){
+			W[t] = M[t];
+		}else{
+			W[t] = sigma1( W[t-2] ) + W[t-7] + sigma0( W[t-15] ) + W[t-16];
+		}
+		KW[t] = vkmr::c_sha256Constants[t] + W[t];
 	}
+	cpu_sha256_rounds( H, KW );
+}
 
-	// If the supplementary block isn't large enough to
-	// accomodate the trailing size footer..
-	const auto delta = ((N * block_size) - size);
-	if (delta <= 8){
-		N++;
-	}
+// Applies the compression function to the block of padding which follows a 64-byte message
+static void cpu_sha256_compress_padding_scalar(uint32_t* H) {
+	cpu_sha256_rounds( H, vkmr::c_sha256PaddingSchedule );
+}
 
-	// Process each block
-	auto ptr = s.data( );
-	for (uint32_t i = 0; i < N; ++i){
-		// Initialise an empty block
-		uint32_t M[words];
-		clear_message_block( M, words );
+static const vkmr::CpuSha256Kernels c_scalarKernels = {
+	"scalar",
+	1U,
+	cpu_sha256_compress_scalar,
+	vkmr::sha256d_64_1<cpu_sha256_compress_scalar, cpu_sha256_compress_padding_scalar>,
+	vkmr::sha256d_n_1<cpu_sha256_compress_scalar>
+};
+
+#if defined (_VKMR_X86_)
+// Gets the given leaf of CPUID into EAX, EBX, ECX and EDX, in that order
+static void cpu_id(uint32_t leaf, uint32_t regs[4]) {
+#if defined (_MSC_VER)
+	int r[4];
+	__cpuidex( r, static_cast<int>( leaf ), 0 );
+	for (auto k = 0; k < 4; ++k){
+		regs[k] = static_cast<uint32_t>( r[k] );
+	}
+#else
+	__cpuid_count( leaf, 0U, regs[0], regs[1], regs[2], regs[3] );
+#endif
+}
 
-		// Prep it
-		const auto offset = (i * block_size);
-		if (offset >= size){
-			if (size == offset){
-#ifdef __LITTLE_ENDIAN__
-				M[0] = 0x00000080;
+// Returns the register state which the OS saves and restores, per XCR0
+static uint64_t cpu_xcr0(void) {
+#if defined (_MSC_VER)
+	return _xgetbv( 0 );
 #else
-				M[0] = 0x80000000;
+	uint32_t eax = 0, edx = 0;
+	__asm__ __volatile__ ( "xgetbv" : "=a" (eax), "=d" (edx) : "c" (0) );
+	return (static_cast<uint64_t>( edx ) << 32) | eax;
 #endif
-			}
-			append_message_block( M, words, size );
-		}else{
-			const char* p = ptr + offset;
-			//debug_print( p, static_cast<unsigned>( min( block_size, size - offset ) ) );
-
-			const auto next = (offset + block_size);
-			if (next < size){
-				// Fill the words with the bytes in the current block
-				for (uint32_t w = 0; w < words; ++w){
-					// Fill the current word with the next four bytes
-					uint32_t word = 0;
-					for (uint32_t x = 0; x < 32; x += 8){
-						const uint32_t y = static_cast<uint32_t>( *p++ );
-						word |= ((y << x) & (0xFF << x));
-					}
-					M[w] = word;
-				}
-			}else{
-				const uint32_t bytes = static_cast<uint32_t>( size - offset );
-				const uint32_t wr = (bytes % sizeof( uint32_t ));
-				uint32_t w1 = bytes / sizeof( uint32_t );
-				if (wr){
-					w1 += 1;
-				}
-
-				// w1: the number of whole or partial words to be filled
-				// wr: the number of bytes filled in the last word (w1-1)
-				for (uint32_t w0 = 0, wb = bytes; w0 < w1; ++w0){
-					uint32_t word = 0;
-					const uint32_t xb = min( 32, wb << 3 );
-					for (uint32_t x = 0; x < xb; x += 8, --wb){
-						const uint32_t y = static_cast<uint32_t>( *p++ );
-						word |= ((y << x) & (0xFF << x));
-					}
-					M[w0] = word;
-				}
-
-				auto delta = (block_size - bytes);
-				if (delta > 0){
-					// The word to be selected is the last partially-filled
-					// one or the next one after the last fully-filled one
-					const uint32_t w0 = (wr) ? (w1 - 1) : w1;
-					uint32_t word = M[w0];
-
-					// Raise the leading bit on the indicated byte within
-					// the word, and apply
-					const uint32_t x = (wr << 3);
-					word |= ((0x80 << x) & (0xFF << x));
-					M[w0] = word;
-
-					delta--;
-				}else{
-					// It'll be handled in the next block..
-					;
-				}
-				if (delta >= 8){
-					append_message_block( M, words, size );
-				}
-			}
-		}
-		// debug_print_bits_and_bytes( M, words );
-
-		// Initialise the working variables
-		uint32_t a = H[0];
-		uint32_t b = H[1];
-		uint32_t c = H[2];
-		uint32_t d = H[3];
-		uint32_t e = H[4];
-		uint32_t f = H[5];
-		uint32_t g = H[6];
-		uint32_t h = H[7];
-
-		// Loop
-		uint32_t W[64];
-		for (auto t = 0; t < 64; ++t){
-			// Prep the message schedule
-			if (t < words){
-#ifdef __LITTLE_ENDIAN__
-				W[t] = SWOP_ENDS_U32( M[t] );
+}
+#elif defined (_VKMR_ARM64_)
+// Returns true if the CPU supports the SHA-256 instructions of the ARMv8 Cryptographic Extension
+static bool cpu_has_sha2(void) {
+#if defined (_WIN32)
+	return IsProcessorFeaturePresent( PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE ) != 0;
+#elif defined (__APPLE__)
+	return true;
+#elif defined (__linux__)
+	return (getauxval( AT_HWCAP ) & HWCAP_SHA2) != 0;
 #else
-				W[t] = M[t];
+	return false;
 #endif
-			}else{
-				W[t] = sigma1( W[t-2] ) + W[t-7] + sigma0( W[t-15] ) + W[t-16];
-			}
+}
+#endif // defined (_VKMR_X86_)
+
+// Returns the kernels which the CPU (and OS) supports, fastest first
+static std::vector<const vkmr::CpuSha256Kernels*> cpu_sha256_candidates(void) {
+
+	std::vector<const vkmr::CpuSha256Kernels*> candidates;
+#if defined (_VKMR_X86_)
+	uint32_t r0[4] = { 0 }, r1[4] = { 0 }, r7[4] = { 0 };
+	cpu_id( 0, r0 );
+	if (r0[0] >= 1){
+		cpu_id( 1, r1 );
+	}
+	if (r0[0] >= 7){
+		cpu_id( 7, r7 );
+	}
+	const uint64_t xcr0 = (r1[2] & (1U << 27)) ? cpu_xcr0( ) : 0U;
+	if ((r7[1] & (1U << 16)) && ((xcr0 & 0xE6) == 0xE6)){
+		candidates.push_back( vkmr::cpu_sha256_avx512_kernels( ) );
+	}
+	if ((r7[1] & (1U << 29)) && (r1[2] & (1U << 19)) && (r1[2] & (1U << 9))){
+		candidates.push_back( vkmr::cpu_sha256_shani_kernels( ) );
+	}
+	if ((r7[1] & (1U << 5)) && ((xcr0 & 0x06) == 0x06)){
+		candidates.push_back( vkmr::cpu_sha256_avx2_kernels( ) );
+	}
+	if (r1[3] & (1U << 26)){
+		candidates.push_back( vkmr::cpu_sha256_sse2_kernels( ) );
+	}
+#elif defined (_VKMR_ARM64_)
+	if (cpu_has_sha2( )){
+		candidates.push_back( vkmr::cpu_sha256_armv8_kernels( ) );
+	}
+#endif // defined (_VKMR_X86_)
+	candidates.push_back( &c_scalarKernels );
+
+	// Drop any which weren't built
+	candidates.erase( std::remove( candidates.begin( ), candidates.end( ), nullptr ), candidates.end( ) );
+	return candidates;
+}
 
-			auto T1 = h + Sigma1( e ) + Ch( e, f, g ) + c_constants[t] + W[t];
-			auto T2 = Sigma0( a ) + Maj( a, b, c );
-			h = g;
-			g = f;
-			f = e;
-			e = d + T1;
-			d = c;
-			c = b;
-			b = a;
-			a = T1 + T2;
+// Picks the fastest kernels which the CPU (and OS) supports, unless
+// others are asked for by name, via VKMR_CPU_KERNELS
+static const vkmr::CpuSha256Kernels& cpu_sha256_select_kernels(void) {
+
+	const auto candidates = cpu_sha256_candidates( );
+	const char* name = std::getenv( "VKMR_CPU_KERNELS" );
+	for (auto it = candidates.cbegin( ), end = candidates.cend( ); it != end; ++it){
+		const auto kernels = *it;
+		if ((name == nullptr) || (*name == 0) || (std::strcmp( name, kernels->name ) == 0)){
+			return *kernels;
 		}
+	}
+	return c_scalarKernels;
+}
+
+static const vkmr::CpuSha256Kernels& cpu_sha256_kernels(void) {
+
+	static const vkmr::CpuSha256Kernels& kernels = cpu_sha256_select_kernels( );
+	return kernels;
+}
+
+// Picks the fastest compression function which the CPU supports, for hashing one message block at a time
+static void (*cpu_sha256_select_compress(void))(uint32_t*, const uint32_t*) {
 
-		// Compute the i-th intermediate hash value
-		H[0] = a + H[0];
-		H[1] = b + H[1];
-		H[2] = c + H[2];
-		H[3] = d + H[3];
-		H[4] = e + H[4];
-		H[5] = f + H[5];
-		H[6] = g + H[6];
-		H[7] = h + H[7];
+	const auto& kernels = cpu_sha256_kernels( );
+	if (kernels.compress){
+		return kernels.compress;
+	}
+
+	const auto candidates = cpu_sha256_candidates( );
+	for (auto it = candidates.cbegin( ), end = candidates.cend( ); it != end; ++it){
+		if ((*it)->compress){
+			return (*it)->compress;
+		}
+	}
+	return cpu_sha256_compress_scalar;
+}
+
+// Applies the compression function to the given message block (of big-endian
+// words) and accumulates the result into the given hash value(s)
+static void cpu_sha256_compress(uint32_t* H, const uint32_t* M) {
+
+	static const auto compress = cpu_sha256_select_compress( );
+	compress( H, M );
+}
+
+static std::vector<uint32_t> cpu_sha256_n(const std::string& s) {
+
+	// Set the initial hash value(s)
+	uint32_t H[SHA256_WC];
+	std::memcpy( H, vkmr::c_sha256Initial, sizeof( H ) );
+
+	// Process each block of the padded message
+	const auto ptr = reinterpret_cast<const uint8_t*>( s.data( ) );
+	const auto size = s.size( );
+	const auto N = vkmr::sha256_block_count( size );
+	for (size_t i = 0; i < N; ++i){
+		uint32_t M[SHA256_MESSAGE_BLOCK_WC];
+		vkmr::sha256_block( ptr, size, i, M );
+		// debug_print_bits_and_bytes( M, SHA256_MESSAGE_BLOCK_WC );
+
+		cpu_sha256_compress( H, M );
 	}
 	return std::vector<uint32_t>( H, H + 8 );
 }
@@ -291,162 +357,14 @@ static std::vector<uint32_t> cpu_sha256_1(const std::vector<uint32_t>& u) {
 	for (auto w = half; w < words; ++w){
 		(*m++) = 0U;
 	}
-#ifdef __LITTLE_ENDIAN__
 	M[half] = 0x80000000;
 	M[words-1] = 256;
-#else
-	M[8] = 0x00000080;
-	append_message_block( M, words, 32 );
-#endif
-	//debug_print_bits_and_bytes( M, words );
-
-	// Set the initial hash value(s)
-	uint32_t H[] = {
-		0x6a09e667,
-		0xbb67ae85,
-		0x3c6ef372,
-		0xa54ff53a,
-		0x510e527f,
-		0x9b05688c,
-		0x1f83d9ab,
-		0x5be0cd19
-	};
-
-	// Initialise the working variables
-	uint32_t a = H[0];
-	uint32_t b = H[1];
-	uint32_t c = H[2];
-	uint32_t d = H[3];
-	uint32_t e = H[4];
-	uint32_t f = H[5];
-	uint32_t g = H[6];
-	uint32_t h = H[7];
-
-	// Loop
-	uint32_t W[64];
-	for (auto t = 0; t < 64; ++t){
-		// Prep the message schedule
-		if (t < words){
-			W[t] = M[t];
-		}else{
-			W[t] = sigma1( W[t-2] ) + W[t-7] + sigma0( W[t-15] ) + W[t-16];
-		}
-
-		auto T1 = h + Sigma1( e ) + Ch( e, f, g ) + c_constants[t] + W[t];
-		auto T2 = Sigma0( a ) + Maj( a, b, c );
-		h = g;
-		g = f;
-		f = e;
-		e = d + T1;
-		d = c;
-		c = b;
-		b = a;
-		a = T1 + T2;
-	}
-
-	// Accumulate and return
-	std::vector<uint32_t> v;
-	v.push_back( a + H[0] );
-	v.push_back( b + H[1] );
-	v.push_back( c + H[2] );
-	v.push_back( d + H[3] );
-	v.push_back( e + H[4] );
-	v.push_back( f + H[5] );
-	v.push_back( g + H[6] );
-	v.push_back( h + H[7] );
-	return v;
-}
-
-static std::vector<uint32_t> cpu_sha256_2(const std::vector<uint32_t>& u1, const std::vector<uint32_t>& u2) {
-
-	const auto block_size = (512 / 8);
-	const auto words = (block_size / sizeof( uint32_t ));
-
-	// Fill the first message block 
-	uint32_t M[words];
-	clear_message_block( M, words );
-	auto count = min( words - 1, u1.size( ) );
-	std::memcpy(
-		M,
-		u1.data( ),
-		sizeof( std::vector<uint32_t>::value_type ) * count
-	);
-	std::memcpy(
-		M + count,
-		u2.data( ),
-		sizeof( std::vector<uint32_t>::value_type ) * min( u2.size( ), words - count )
-	);
 	//debug_print_bits_and_bytes( M, words );
 
-	// Set the initial hash value(s)
-	uint32_t H[] = {
-		0x6a09e667,
-		0xbb67ae85,
-		0x3c6ef372,
-		0xa54ff53a,
-		0x510e527f,
-		0x9b05688c,
-		0x1f83d9ab,
-		0x5be0cd19
-	};
-	for (auto i = 0; true; ){
-		// Initialise the working variables
-		uint32_t a = H[0];
-		uint32_t b = H[1];
-		uint32_t c = H[2];
-		uint32_t d = H[3];
-		uint32_t e = H[4];
-		uint32_t f = H[5];
-		uint32_t g = H[6];
-		uint32_t h = H[7];
-
-		// Loop
-		uint32_t W[64];
-		for (auto t = 0; t < 64; ++t){
-			// Prep the message schedule
-			if (t < words){
-				W[t] = M[t];
-			}else{
-				W[t] = sigma1( W[t-2] ) + W[t-7] + sigma0( W[t-15] ) + W[t-16];
-			}
-
-			auto T1 = h + Sigma1( e ) + Ch( e, f, g ) + c_constants[t] + W[t];
-			auto T2 = Sigma0( a ) + Maj( a, b, c );
-			h = g;
-			g = f;
-			f = e;
-			e = d + T1;
-			d = c;
-			c = b;
-			b = a;
-			a = T1 + T2;
-		}
-
-		// Compute the i-th intermediate hash value
-		H[0] = a + H[0];
-		H[1] = b + H[1];
-		H[2] = c + H[2];
-		H[3] = d + H[3];
-		H[4] = e + H[4];
-		H[5] = f + H[5];
-		H[6] = g + H[6];
-		H[7] = h + H[7];
-
-		// Prepare the next block?
-		if (++i >= 2){
-			// Nope..
-			break;
-		}
-		clear_message_block( M, words );
-#ifdef __LITTLE_ENDIAN__
-		M[0] = 0x80000000;
-		M[words-1] = 512;
-#else
-		M[0] = 0x00000080;
-		append_message_block( M, words, 64 );
-#endif
-		//debug_print_bits_and_bytes( M, words );
-	}
+	// Set the initial hash value(s), and accumulate
+	uint32_t H[SHA256_WC];
+	std::memcpy( H, vkmr::c_sha256Initial, sizeof( H ) );
+	cpu_sha256_compress( H, M );
 	return std::vector<uint32_t>( H, H + 8 );
 }
 
@@ -468,6 +386,59 @@ static std::string hash_to_string(const std::vector<uint32_t>& v) {
 	return result;
 }
 
+// Reduces the given range of pairs of nodes in one level of the tree to the corresponding
+// nodes in the next level, which may be written over the front of the level itself
+static void cpu_sha256d_pairs(const VkSha256Result* in, size_t count, VkSha256Result* out, size_t begin, size_t end) {
+
+	static_assert( sizeof( VkSha256Result ) == (sizeof( uint32_t ) * SHA256_WC), "Nodes are not packed" );
+	const auto& kernels = cpu_sha256_kernels( );
+
+	// Each whole pair is already a 64-byte message, in place
+	const auto whole = min( end, count >> 1 );
+	if (begin < whole){
+		kernels.sha256d_64( reinterpret_cast<const uint32_t*>( in + (begin << 1) ), reinterpret_cast<uint32_t*>( out + begin ), whole - begin );
+	}
+
+	// If there's an odd number of nodes, then the last is paired with itself
+	if (whole < end){
+		uint32_t M[SHA256_MESSAGE_BLOCK_WC];
+		std::memcpy( M, in[count - 1].data, sizeof( VkSha256Result ) );
+		std::memcpy( M + SHA256_WC, in[count - 1].data, sizeof( VkSha256Result ) );
+		kernels.sha256d_64( M, out[whole].data, 1U );
+	}
+}
+
+// Returns the node for the given 32-byte hash, as big-endian words
+static VkSha256Result hash_to_node(const char* hash) {
+
+	VkSha256Result node;
+	auto p = reinterpret_cast<const uint8_t*>( hash );
+	for (uint32_t w = 0U; w < SHA256_WC; ++w, p += sizeof( uint32_t )){
+		node.data[w] = (uint32_t( p[0] ) << 24) | (uint32_t( p[1] ) << 16) | (uint32_t( p[2] ) << 8) | uint32_t( p[3] );
+	}
+	return node;
+}
+
+// Computes the SHA-256d of each of the given number of inputs, stored back
+// to back with the given sizes, into the given leaves
+static void cpu_sha256d_leaves(const char* inputs, const size_t* sizes, size_t count, VkSha256Result* leaves) {
+
+	const auto& kernels = cpu_sha256_kernels( );
+
+	const uint8_t* data[c_messagesPerCall];
+	auto p = reinterpret_cast<const uint8_t*>( inputs );
+	for (size_t i = 0; i < count; ){
+		const size_t n = min( c_messagesPerCall, count - i );
+		for (size_t k = 0; k < n; ++k){
+			data[k] = p;
+			p += sizes[i + k];
+		}
+
+		kernels.sha256d_n( data, sizes + i, reinterpret_cast<uint32_t*>( leaves + i ), n );
+		i += n;
+	}
+}
+
 namespace vkmr {
 
 ::std::string cpu_sha256(const ::std::string& s) {
@@ -488,16 +459,22 @@ namespace vkmr {
 // Classes
 //
 
+CpuSha256D::CpuSha256D(): CpuSha256D( "CPU" ) { }
+
+CpuSha256D::CpuSha256D(const ISha256D::name_type& name):
+	ISha256D( name + " (" + cpu_sha256_kernels( ).name + ")" ) { }
+
 ISha256D::out_type CpuSha256D::Root(void) {
 
 	// Look for an early out
+	this->Hash( );
 	if (m_leaves.empty( )){
 		return "";
 	}
 
-	auto be_to_string = [=](const ::std::vector<uint32_t>& be) -> ::std::string {
+	auto be_to_string = [=](const node_type& be) -> ::std::string {
 		::std::string result;
-		for (auto it = be.cbegin( ), end = be.cend( ); it != end; ++it){
+		for (auto it = be.data, end = be.data + SHA256_WC; it != end; ++it){
 			const auto u = *it;
 			for (uint32_t k = 0; k < sizeof( uint32_t ); ++k){
 				uint32_t c = (u >> (k << 3)) & 0xFF;
@@ -507,57 +484,369 @@ ISha256D::out_type CpuSha256D::Root(void) {
 		return result;
 	};
 
-	::std::vector<::std::vector<uint32_t>> v;
-	v.reserve( m_leaves.size( ) );
-
-	// Loop until we've reduced to a single element
-	auto pin = &m_leaves, pout = &v;
+	// Reduce the leaves in place, one level at a time, until we've reduced to a single node
+	auto count = m_leaves.size( );
 	do {
-		// Get the number of pairs of elements in the current run
-		const auto count = pin->size( );
-		auto pairs = count >> 1;
-		if (count % 2 != 0){
-			++pairs;
-		}
-
-		// Loop through them
-		pout->clear( );
-		for (auto it = pin->cbegin( ), end = pin->cend( ); pairs > 0; --pairs ){
-			const auto& l = *(it++);
-			const auto& r = (it == end ? l : (*it++));
-
-			// Accumulate the hash of the hash of the concatenation
-			const auto h = cpu_sha256_1(
-				cpu_sha256_2( l, r )
-			);
-			pout->push_back( h );
-
-			/*
-			::std::ostringstream oss;
-			oss << "(" << pairs << "/" << count << "): ";
-			debug_print_label( oss.str( ) );
-			debug_print_bytes( be_to_string( h ) );
-			*/
-		}
-
-		// Swop the pointers for the next iteration
-		auto tmp = pin;
-		pin = pout;
-		pout = tmp;
-	} while (pin->size( ) > 1);
+		this->ReduceLevel( m_leaves.data( ), count );
+		count = (count + 1U) >> 1;
+	} while (count > 1U);
 
 	/*
 	debug_print_label( "B/E: " );
-	debug_print_bytes( be_to_string( pin->front( ) ) );
+	debug_print_bytes( be_to_string( m_leaves.front( ) ) );
 	*/
 
-	auto root = hash_to_string( pin->front( ) );
+	const auto& node = m_leaves.front( );
+	auto root = hash_to_string( ::std::vector<uint32_t>( node.data, node.data + SHA256_WC ) );
 	return print_bytes( root ).str( );
 }
 
-bool CpuSha256D::Add(const ISha256D::arg_type& arg) {
-	m_leaves.push_back( cpu_sha256d_int( arg ) );
+bool CpuSha256D::Add(const char* data, size_t size) {
+
+	m_pending.Push( data, size );
+	if (m_pending.Count( ) >= c_messagesPerCall){
+		this->Hash( );
+	}
+	return true;
+}
+
+bool CpuSha256D::AddLeaf(const char* hash) {
+
+	// Keep the leaves in order, behind any inputs still to be hashed
+	if (m_pending.Count( ) > 0U){
+		this->Hash( );
+	}
+	m_leaves.push_back( hash_to_node( hash ) );
+	return true;
+}
+
+void CpuSha256D::Hash(void) {
+
+	const auto size = m_leaves.size( );
+	m_leaves.resize( size + m_pending.Count( ) );
+	cpu_sha256d_leaves( m_pending.data.data( ), m_pending.sizes.data( ), m_pending.Count( ), m_leaves.data( ) + size );
+	m_pending.Clear( );
+}
+
+void CpuSha256D::ReduceLevel(node_type* nodes, size_t count) {
+	cpu_sha256d_pairs( nodes, count, nodes, 0U, (count + 1U) >> 1 );
+}
+
+CpuMtSha256D::CpuMtSha256D(unsigned threads):
+	CpuSha256D( "CPU-MT" ),
+	m_threads( threads ) {
+
+	m_block.sizes.reserve( c_blockSize );
+}
+
+CpuMtSha256D::~CpuMtSha256D() {
+
+	// Drain the workers before the blocks they write into go away
+	m_workers.reset( );
+}
+
+ISha256D::out_type CpuMtSha256D::Root(void) {
+
+	// Hand off whatever is left over, and wait for all of the leaves
+	this->Flush( );
+	if (m_workers){
+		m_workers->WaitFor( );
+	}
+
+	// Gather the leaves, in order
+	size_t count = m_leaves.size( );
+	for (auto it = m_blocks.cbegin( ), end = m_blocks.cend( ); it != end; ++it){
+		count += it->leaves.size( );
+	}
+	m_leaves.reserve( count );
+	while (!m_blocks.empty( )){
+		const auto& leaves = m_blocks.front( ).leaves;
+		m_leaves.insert( m_leaves.end( ), leaves.cbegin( ), leaves.cend( ) );
+		m_blocks.pop_front( );
+	}
+	return CpuSha256D::Root( );
+}
+
+bool CpuMtSha256D::Add(const char* data, size_t size) {
+
+	m_block.Push( data, size );
+	if (m_block.Count( ) >= c_blockSize){
+		this->Flush( );
+	}
 	return true;
 }
 
+bool CpuMtSha256D::AddLeaf(const char* hash) {
+
+	// Hand off any inputs ahead of it, and then append it
+	// to a block of its own kind (which is never submitted)
+	this->Flush( );
+	if (m_blocks.empty( ) || !m_blocks.back( ).hashed){
+		m_blocks.push_back( Block( ) );
+		m_blocks.back( ).hashed = true;
+	}
+	m_blocks.back( ).leaves.push_back( hash_to_node( hash ) );
+	return true;
+}
+
+bool CpuMtSha256D::Reset(void) {
+
+	if (m_workers){
+		m_workers->WaitFor( );
+	}
+	m_blocks.clear( );
+	m_block.Clear( );
+	m_scratch.clear( );
+	return CpuSha256D::Reset( );
+}
+
+void CpuMtSha256D::ReduceLevel(node_type* nodes, size_t count) {
+
+	// Look for an early out
+	const auto pairs = (count + 1U) >> 1;
+	if (pairs <= c_pairsGrain){
+		CpuSha256D::ReduceLevel( nodes, count );
+		return;
+	}
+
+	// Chunks can't be reduced in place in parallel (as one chunk's output overlaps
+	// another's input), so reduce into the scratch level and then copy it back
+	m_scratch.resize( pairs );
+	auto out = m_scratch.data( );
+	GetWorkers( ).ForEach( pairs, c_pairsGrain, [=](size_t begin, size_t end) {
+		cpu_sha256d_pairs( nodes, count, out, begin, end );
+	} );
+	std::memcpy( nodes, out, pairs * sizeof( node_type ) );
+}
+
+void CpuMtSha256D::Flush(void) {
+
+	// Look for an early out
+	if (m_block.Count( ) == 0U){
+		return;
+	}
+
+	// Move the inputs into a new block, and queue it up for hashing
+	// (elements of a deque stay put as it grows at the back)
+	m_blocks.push_back( Block( ) );
+	auto& block = m_blocks.back( );
+	::std::swap( block.inputs, m_block );
+	m_block.data.reserve( block.inputs.data.size( ) );
+	m_block.sizes.reserve( c_blockSize );
+
+	auto pBlock = &block;
+	GetWorkers( ).Submit( [pBlock]() {
+		const auto& inputs = pBlock->inputs;
+		pBlock->leaves.resize( inputs.Count( ) );
+		cpu_sha256d_leaves( inputs.data.data( ), inputs.sizes.data( ), inputs.Count( ), pBlock->leaves.data( ) );
+		pBlock->inputs = Messages( );
+	} );
+}
+
+Workers& CpuMtSha256D::GetWorkers(void) {
+
+	if (!m_workers){
+		m_workers.reset( new Workers( m_threads ) );
+	}
+	return *m_workers;
+}
+
+// A slice of leaves being hashed (a block of inputs at a time) and then reduced, by the workers
+struct CpuSlices::Job {
+	number_type number;
+	::std::unique_ptr<node_type[]> leaves;
+	size_t count;
+
+	// The number of tasks for the slice yet to finish, plus one until it is handed off,
+	// and the time (across all of the threads) taken by those which have
+	::std::atomic<size_t> tasks;
+	double elapsed;
+};
+
+CpuSlices::CpuSlices(size_t capacity, unsigned threads):
+	m_capacity( capacity ),
+	m_workers( new Workers( threads ) ),
+	m_pCurrent( nullptr ),
+	m_first( 0U ),
+	m_pending( 0U ),
+	m_reduced( 0U ),
+	m_elapsed( 0.0 ) {
+
+	m_sizes.reserve( c_blockSize );
+}
+
+CpuSlices::~CpuSlices() {
+
+	// Drain the workers before the slices they write into go away
+	m_workers.reset( );
+}
+
+bool CpuSlices::Shard(number_type number) {
+
+	this->Seal( );
+
+	// Leave the leaves uninitialised (rather than touching the whole slice up-front)
+	::std::unique_ptr<Job> job( new Job );
+	job->number = number;
+	job->leaves.reset( new (::std::nothrow) node_type[m_capacity] );
+	job->count = 0U;
+	job->tasks = 1U;
+	job->elapsed = 0.0;
+	if (!job->leaves){
+		return false;
+	}
+	m_pCurrent = job.get( );
+	m_jobs.push_back( ::std::move( job ) );
+	m_first = 0U;
+
+	::std::lock_guard<::std::mutex> lock( m_mutex );
+	m_pending++;
+	return true;
+}
+
+bool CpuSlices::Add(const char* data, size_t size) {
+
+	// Look for an early out
+	if (m_pCurrent == nullptr){
+		return false;
+	}
+	auto& job = *m_pCurrent;
+	if (job.count >= m_capacity){
+		return false;
+	}
+
+	m_data.insert( m_data.end( ), data, data + size );
+	m_sizes.push_back( size );
+	job.count++;
+	if (m_sizes.size( ) >= c_blockSize){
+		this->Flush( );
+	}
+	return true;
+}
+
+bool CpuSlices::AddLeaf(const char* hash) {
+
+	// Look for an early out
+	if (m_pCurrent == nullptr){
+		return false;
+	}
+	auto& job = *m_pCurrent;
+	if (job.count >= m_capacity){
+		return false;
+	}
+
+	// Hand off any inputs ahead of it (which have their places in the slice
+	// already), and then write it into its own
+	this->Flush( );
+	job.leaves[job.count++] = hash_to_node( hash );
+	m_first = job.count;
+	return true;
+}
+
+size_t CpuSlices::Threads(void) const {
+	return m_workers->Count( );
+}
+
+size_t CpuSlices::Pending(void) const {
+
+	::std::lock_guard<::std::mutex> lock( m_mutex );
+	return m_pending;
+}
+
+double CpuSlices::PerSlice(void) const {
+
+	::std::lock_guard<::std::mutex> lock( m_mutex );
+	return (m_reduced > 0U) ? (m_elapsed / m_reduced) : 0.0;
+}
+
+const ::std::map<CpuSlices::number_type, CpuSlices::node_type>& CpuSlices::Roots(void) {
+
+	this->Seal( );
+	m_workers->WaitFor( );
+	return m_roots;
+}
+
+void CpuSlices::Flush(void) {
+
+	// Look for an early out
+	if (m_sizes.empty( )){
+		return;
+	}
+
+	// Move the inputs into a block of their own, and queue it up for
+	// hashing straight into their places in the slice
+	auto pJob = m_pCurrent;
+	auto block = ::std::make_shared<::std::pair<::std::vector<char>, ::std::vector<size_t>>>( );
+	::std::swap( block->first, m_data );
+	::std::swap( block->second, m_sizes );
+	m_data.reserve( block->first.size( ) );
+	m_sizes.reserve( c_blockSize );
+
+	auto leaves = pJob->leaves.get( ) + m_first;
+	m_first = pJob->count;
+	pJob->tasks++;
+	m_workers->Submit( [this, pJob, block, leaves]() {
+		StopWatch sw;
+		sw.Start( );
+		cpu_sha256d_leaves( block->first.data( ), block->second.data( ), block->second.size( ), leaves );
+		this->Done( pJob, sw.Elapsed( ) );
+	} );
+}
+
+void CpuSlices::Seal(void) {
+
+	// Look for an early out
+	if (m_pCurrent == nullptr){
+		return;
+	}
+
+	// Reduce it on the workers now if all of its leaves have been hashed already,
+	// or else leave it to whichever task hashes the last of them
+	this->Flush( );
+	auto pJob = m_pCurrent;
+	m_pCurrent = nullptr;
+	if (--(pJob->tasks) == 0U){
+		m_workers->Submit( [this, pJob]() {
+			this->Reduce( pJob );
+		} );
+	}
+}
+
+void CpuSlices::Done(Job* pJob, double elapsed) {
+
+	{
+		::std::lock_guard<::std::mutex> lock( m_mutex );
+		pJob->elapsed += elapsed;
+	}
+	if (--(pJob->tasks) == 0U){
+		this->Reduce( pJob );
+	}
+}
+
+void CpuSlices::Reduce(Job* pJob) {
+
+	StopWatch sw;
+	sw.Start( );
+
+	// Reduce the leaves in place, one level at a time: the first slice (being the only one
+	// which may be reduced as-is) down to a single node, and the rest for as many levels
+	// as it takes to reduce a full slice
+	auto nodes = pJob->leaves.get( );
+	auto count = pJob->count;
+	auto levels = m_capacity;
+	do {
+		cpu_sha256d_pairs( nodes, count, nodes, 0U, (count + 1U) >> 1 );
+		count = (count + 1U) >> 1;
+		levels >>= 1;
+	} while ((pJob->number == 1U) ? (count > 1U) : (levels > 1U));
+	const auto root = nodes[0];
+	pJob->leaves.reset( );
+
+	::std::lock_guard<::std::mutex> lock( m_mutex );
+	m_roots[pJob->number] = root;
+	m_elapsed += pJob->elapsed + sw.Elapsed( );
+	m_pending--;
+	m_reduced++;
+}
+
 } // namespace vkmr
@@ -7,14 +7,27 @@
 // Includes
 //
 
+// C Standard Library Headers
+#include <stdint.h>
+
 // Local Project Headers
 #include "ISha256D.h"
+#include "../common/SHA-256defs.h"
 
 // C++ Standard Library Headers
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 namespace vkmr {
 
+// Forward Declarations
+//
+
+class Workers;
+
 // Functions
 //
 
@@ -27,25 +40,180 @@ namespace vkmr {
 // Classes
 //
 
+// Calculates the root serially, naming the instruction set(s) it uses to do so
 class CpuSha256D : public ISha256D {
 public:
-    CpuSha256D(): ISha256D("CPU") { }
+    CpuSha256D();
+    virtual ~CpuSha256D() = default;
 
     ISha256D::out_type Root(void);
 
-    bool Add(const ISha256D::arg_type& arg);
+    bool Add(const ISha256D::arg_type& arg) { return this->Add( arg.data( ), arg.size( ) ); }
+    bool Add(const char*, size_t);
+    bool AddLeaf(const char*);
 
     bool Reset(void) {
+        m_pending.Clear( );
         m_leaves.clear( );
         return true;
     }
 
 protected:
-    typedef ::std::vector<uint32_t> node_type;
+    // Nodes are kept in one flat array of (big-endian) hashes, laid out
+    // as the GPU(s) write them, so that each pair is one 64-byte message
+    typedef VkSha256Result node_type;
+
+    // A run of inputs, kept back to back rather than in a string apiece
+    struct Messages {
+        ::std::vector<char> data;
+        ::std::vector<size_t> sizes;
+
+        void Push(const char* p, size_t size) {
+            data.insert( data.end( ), p, p + size );
+            sizes.push_back( size );
+        }
+
+        size_t Count(void) const { return sizes.size( ); }
+
+        void Clear(void) {
+            data.clear( );
+            sizes.clear( );
+        }
+    };
+
+    CpuSha256D(const ISha256D::name_type&);
+
+    // Hashes the pending inputs into leaves
+    void Hash(void);
+
+    // Reduces the given number of nodes in one level of the tree, in place, into the
+    // front of the same array
+    virtual void ReduceLevel(node_type*, size_t);
 
+    Messages m_pending;
     ::std::vector<node_type> m_leaves;
 };
 
+// Hashes the leaves on a pool of worker threads as they are added,
+// and reduces each level of the tree in parallel chunks
+class CpuMtSha256D : public CpuSha256D {
+public:
+    CpuMtSha256D(unsigned threads = 0U);
+    CpuMtSha256D(CpuMtSha256D const&) = delete;
+    virtual ~CpuMtSha256D();
+
+    CpuMtSha256D& operator=(CpuMtSha256D const&) = delete;
+
+    ISha256D::out_type Root(void);
+
+    bool Add(const ISha256D::arg_type& arg) { return this->Add( arg.data( ), arg.size( ) ); }
+    bool Add(const char*, size_t);
+    bool AddLeaf(const char*);
+
+    bool Reset(void);
+
+protected:
+    void ReduceLevel(node_type*, size_t);
+
+private:
+    // A run of consecutive inputs, hashed as one task, or
+    // else of leaves which were added already hashed
+    struct Block {
+        Messages inputs;
+        ::std::vector<node_type> leaves;
+        bool hashed = false;
+    };
+
+    // Hands off the current block to the workers
+    void Flush(void);
+
+    // Returns the workers, starting them up if needed
+    Workers& GetWorkers(void);
+
+    unsigned m_threads;
+    ::std::unique_ptr<Workers> m_workers;
+    ::std::deque<Block> m_blocks;
+    Messages m_block;
+    ::std::vector<node_type> m_scratch;
+
+    // The number of inputs per block
+    static const size_t c_blockSize = 1024U;
+
+    // The smallest number of pairs worth reducing on another thread
+    static const size_t c_pairsGrain = 512U;
+};
+
+// Hashes and reduces whole slices of the leaves of a tree, sharded across devices, to their roots
+// on a pool of worker threads: every slice but the first is reduced as if it were full (as the
+// GPUs reduce theirs), so that the roots of the slices are the leaves of the tree above them
+class CpuSlices {
+public:
+    typedef VkSha256Result node_type;
+    typedef uint32_t number_type;
+
+    // Creates slices of the given (power of 2) number of leaves, reduced on the
+    // given number of threads, or one per hardware thread if zero
+    CpuSlices(size_t, unsigned threads = 0U);
+    CpuSlices(CpuSlices const&) = delete;
+    ~CpuSlices();
+
+    CpuSlices& operator=(CpuSlices const&) = delete;
+
+    // Starts the slice with the given number, handing the current one (if any) off to be reduced
+    bool Shard(number_type);
+
+    // Hands off the current slice (if any), to be reduced once all of its leaves have been hashed
+    void Seal(void);
+
+    bool Add(const char*, size_t);
+    bool AddLeaf(const char*);
+
+    // Returns the number of threads which the slices are hashed and reduced on
+    size_t Threads(void) const;
+
+    // Returns the number of slices started which are yet to be reduced
+    size_t Pending(void) const;
+
+    // Returns the mean time (across all of the threads) taken to hash and reduce
+    // each slice so far, in ms, or 0 if none have been
+    double PerSlice(void) const;
+
+    // Hands off the current slice, and waits for all of them to be
+    // reduced, returning their roots by slice number
+    const ::std::map<number_type, node_type>& Roots(void);
+
+private:
+    struct Job;
+
+    // Hands off the current block of inputs to be hashed into the current slice
+    void Flush(void);
+
+    // Counts one of the tasks of the given slice as done, having taken the
+    // given time, and reduces the slice if it was the last
+    void Done(Job*, double);
+
+    // Reduces the given slice to its root
+    void Reduce(Job*);
+
+    size_t m_capacity;
+    ::std::unique_ptr<Workers> m_workers;
+    ::std::deque<::std::unique_ptr<Job>> m_jobs;
+    Job* m_pCurrent;
+
+    // The current block of inputs, and the place of the first of them in the current slice
+    ::std::vector<char> m_data;
+    ::std::vector<size_t> m_sizes;
+    size_t m_first;
+
+    mutable ::std::mutex m_mutex;
+    size_t m_pending, m_reduced;
+    double m_elapsed;
+    ::std::map<number_type, node_type> m_roots;
+
+    // The number of inputs per block
+    static const size_t c_blockSize = 1024U;
+};
+
 } // namespace vkmr
 
 #endif // __SHA_256plus_H__
@@ -0,0 +1,82 @@
+// SHA-256sse2.cpp: defines the function(s) for computing SHA-256 hashes of 4 buffers at once, with SSE2
+//
+
+// Includes
+//
+
+// Local Project Headers
+#include "SHA-256mb.h"
+
+#if defined (_VKMR_X86_)
+// Intrinsics
+#include <emmintrin.h>
+
+_VKMR_TARGET_BEGIN_( "sse2" )
+
+// Local Project Headers
+#include "SHA-256lanes.h"
+
+namespace {
+
+// Types
+//
+
+struct Sse2Lanes {
+    typedef __m128i type;
+    typedef __m128i mask_type;
+
+    static const size_t lanes = 4U;
+
+    static inline type Set1(uint32_t u) { return _mm_set1_epi32( static_cast<int>( u ) ); }
+    static inline type Load(const uint32_t* p) { return _mm_load_si128( reinterpret_cast<const __m128i*>( p ) ); }
+    static inline void Store(uint32_t* p, type x) { _mm_store_si128( reinterpret_cast<__m128i*>( p ), x ); }
+
+    static inline type Add(type x, type y) { return _mm_add_epi32( x, y ); }
+    static inline type Xor(type x, type y) { return _mm_xor_si128( x, y ); }
+    static inline type Xor3(type x, type y, type z) { return Xor( Xor( x, y ), z ); }
+    static inline type And(type x, type y) { return _mm_and_si128( x, y ); }
+    static inline type Or(type x, type y) { return _mm_or_si128( x, y ); }
+
+    template <int n>
+    static inline type Shr(type x) { return _mm_srli_epi32( x, n ); }
+
+    template <int n>
+    static inline type Rotr(type x) { return Or( _mm_srli_epi32( x, n ), _mm_slli_epi32( x, 32 - n ) ); }
+
+    static inline type Choose(type x, type y, type z) { return Xor( And( x, y ), _mm_andnot_si128( x, z ) ); }
+    static inline type Majority(type x, type y, type z) { return Or( And( x, y ), And( z, Or( x, y ) ) ); }
+
+    static inline mask_type Active(type n, uint32_t i) { return _mm_cmpgt_epi32( n, Set1( i ) ); }
+    static inline type Select(mask_type m, type x, type y) { return Or( And( m, x ), _mm_andnot_si128( m, y ) ); }
+};
+
+} // namespace
+
+_VKMR_TARGET_END_
+
+namespace vkmr {
+
+// Functions
+//
+
+const CpuSha256Kernels* cpu_sha256_sse2_kernels(void) {
+
+    static const CpuSha256Kernels kernels = {
+        "SSE2",
+        Sse2Lanes::lanes,
+        nullptr,
+        sha256d_64_mb<Sse2Lanes>,
+        sha256d_n_mb<Sse2Lanes>
+    };
+    return &kernels;
+}
+
+} // namespace vkmr
+
+#else
+namespace vkmr {
+
+const CpuSha256Kernels* cpu_sha256_sse2_kernels(void) { return nullptr; }
+
+} // namespace vkmr
+#endif // defined (_VKMR_X86_)
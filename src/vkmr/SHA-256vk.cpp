@@ -6,8 +6,11 @@
 
 // C++ Standard Headers
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#include <string>
 #include <utility>
 
 // Vulkan Headers
@@ -22,6 +25,16 @@
 
 static const uint32_t MegaX = (256 * 1024 * 1024);
 
+// The number (and size) of the inputs with which each choice is benchmarked when tuning,
+// i.e. enough to fill a slice of 32MB, and the number of times each is run
+static const size_t TuningInputCount = (1024 * 1024);
+static const size_t TuningInputSize = 64U;
+static const uint32_t TuningRuns = 2U;
+
+// The size (in bytes) of the biggest inputs whose words are interleaved with those of the
+// inputs next to them in the batches, if they are (i.e. up to 16 message blocks apiece)
+static const uint32_t InterleavedInputSize = 1024U;
+
 // Globals
 //
 
@@ -29,12 +42,16 @@ static const uint32_t MegaX = (256 * 1024 * 1024);
 PFN_vkGetPhysicalDeviceProperties2KHR g_pVkGetPhysicalDeviceProperties2KHR;
 PFN_vkGetPhysicalDeviceMemoryProperties2KHR g_pVkGetPhysicalDeviceMemoryProperties2KHR;
 PFN_vkCmdPipelineBarrier2KHR g_pVkCmdPipelineBarrier2KHR;
+PFN_vkWaitSemaphoresKHR g_pVkWaitSemaphoresKHR;
+PFN_vkGetSemaphoreCounterValueKHR g_pVkGetSemaphoreCounterValueKHR;
 
 namespace vkmr {
 
 // Class(es)
 //
 
+const char* const VkSha256D::c_szAll = "All";
+
 VkSha256D::VkSha256D(): m_instance( VK_NULL_HANDLE ) {
 
     using ::std::endl;
@@ -92,11 +109,25 @@ VkSha256D::VkSha256D(): m_instance( VK_NULL_HANDLE ) {
         g_pVkCmdPipelineBarrier2KHR = (PFN_vkCmdPipelineBarrier2KHR)(
             ::vkGetInstanceProcAddr( m_instance, "vkCmdPipelineBarrier2KHR" )
         );
+        g_pVkWaitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR)(
+            ::vkGetInstanceProcAddr( m_instance, "vkWaitSemaphoresKHR" )
+        );
+        g_pVkGetSemaphoreCounterValueKHR = (PFN_vkGetSemaphoreCounterValueKHR)(
+            ::vkGetInstanceProcAddr( m_instance, "vkGetSemaphoreCounterValueKHR" )
+        );
 
         // Count
         uint32_t vkPhysicalDeviceCount = 0;
         ::vkEnumeratePhysicalDevices( m_instance, &vkPhysicalDeviceCount, VK_NULL_HANDLE );
 
+        // Create each device as many times over as asked to, if any (e.g. to shard a tree
+        // across "devices" with only the one to hand)
+        uint32_t copies = 1U;
+        const char* szCopies = ::std::getenv( "VKMR_DEVICE_COPIES" );
+        if ((szCopies != nullptr) && (::std::strtoul( szCopies, nullptr, 10 ) > 0UL)){
+            copies = static_cast<uint32_t>( ::std::strtoul( szCopies, nullptr, 10 ) );
+        }
+
         // Retrieve
         VkPhysicalDevice* vkPhysicalDevices = new VkPhysicalDevice[vkPhysicalDeviceCount];
         ::vkEnumeratePhysicalDevices( m_instance, &vkPhysicalDeviceCount, vkPhysicalDevices );
@@ -124,7 +155,7 @@ VkSha256D::VkSha256D(): m_instance( VK_NULL_HANDLE ) {
             ::vkGetPhysicalDeviceQueueFamilyProperties( vkPhysicalDevice, &vkQueueFamilyCount, vkQueueFamilyProperties );
             
             // Iterate
-            uint32_t queueCount = 0, queueFamily = vkQueueFamilyCount;
+            uint32_t queueCount = 0, queueFamily = vkQueueFamilyCount, transferFamily = vkQueueFamilyCount;
             for (decltype(vkQueueFamilyCount) j = 0; j < vkQueueFamilyCount; ++j){
                 VkQueueFamilyProperties*  vkQueueFamilyProps = (vkQueueFamilyProperties + j);
                 oss << "Queue family #" << j << " supports ";
@@ -143,6 +174,17 @@ VkSha256D::VkSha256D(): m_instance( VK_NULL_HANDLE ) {
                 }
                 oss << "(0x" << ::std::hex << int(vkQueueFamilyProps->queueFlags) << ::std::dec << ") on " << vkQueueFamilyProps->queueCount << " queue(s)." << endl;
             }
+
+            // Look for another family to upload inputs on, preferring one which does nothing but transfers (i.e. a DMA engine)
+            for (decltype(vkQueueFamilyCount) j = 0; j < vkQueueFamilyCount; ++j){
+                const auto queueFlags = vkQueueFamilyProperties[j].queueFlags;
+                if ((j == queueFamily) || !(queueFlags & VK_QUEUE_TRANSFER_BIT)){
+                    continue;
+                }
+                if (!(queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) || (transferFamily == vkQueueFamilyCount)){
+                    transferFamily = j;
+                }
+            }
             delete[] vkQueueFamilyProperties;
 
             // Look for an early out
@@ -152,17 +194,31 @@ VkSha256D::VkSha256D(): m_instance( VK_NULL_HANDLE ) {
                 continue;
             }
             oss << "Selected queue family #" << queueFamily << endl;
+            if (transferFamily < vkQueueFamilyCount){
+                oss << "Selected queue family #" << transferFamily << " for uploads" << endl;
+            }
             ::std::cout << oss.str( ) << endl;
 
             // Create us a device to do the computation
-            ComputeDevice device( vkPhysicalDevice, queueFamily, queueCount );
-            if (static_cast<VkResult>( device ) == VK_SUCCESS){
-                // Wrap up and accumulate
-                const auto deviceName = ::std::string( vkPhysicalDeviceProperties.deviceName );
-                m_devices.insert( { deviceName, ::std::move( device ) } );
-                continue;
+            for (uint32_t copy = 0U; copy < copies; ++copy){
+                ComputeDevice device(
+                    vkPhysicalDevice,
+                    queueFamily,
+                    queueCount,
+                    (transferFamily < vkQueueFamilyCount) ? transferFamily : uint32_t(-1)
+                );
+                if (static_cast<VkResult>( device ) == VK_SUCCESS){
+                    // Wrap up and accumulate, numbering any which share a name with another
+                    auto deviceName = ::std::string( vkPhysicalDeviceProperties.deviceName );
+                    for (uint32_t n = 2U; m_devices.count( deviceName ) > 0U; ++n){
+                        deviceName = ::std::string( vkPhysicalDeviceProperties.deviceName ) + " #" + ::std::to_string( n );
+                    }
+                    m_devices.insert( { deviceName, ::std::move( device ) } );
+                    continue;
+                }
+                ::std::cerr << "Failed to create a logical compute device on Vulkan" << std::endl;
+                break;
             }
-            ::std::cerr << "Failed to create a logical compute device on Vulkan" << std::endl;
         }
 
         // Cleanup
@@ -221,13 +277,179 @@ bool VkSha256D::Has(const ISha256D::name_type& name) const {
     return (found != m_devices.end( ));
 }
 
-VkSha256D::Instance VkSha256D::Get(const ISha256D::name_type& name) {
+VkSha256D::Instance VkSha256D::Get(const ISha256D::name_type& name, Upload upload) {
     const auto found = m_devices.find( name );
-    auto instance = VkSha256D::Instance( found->first, ::std::move( found->second ) );
+    auto instance = VkSha256D::Instance( found->first, ::std::move( found->second ), upload );
     m_devices.erase( found );
     return instance;
 }
 
+VkSha256D::Sharded VkSha256D::GetSharded(const ISha256D::name_type& name, Upload upload, Sharding sharding, bool hybrid) {
+
+    // Take the named device, or else all of them (in order of name)
+    ::std::map<ISha256D::name_type, ComputeDevice> devices;
+    for (auto it = m_devices.begin( ); it != m_devices.end( ); ){
+        if ((name == c_szAll) || (it->first == name)){
+            devices.insert( { it->first, ::std::move( it->second ) } );
+            it = m_devices.erase( it );
+        }else{
+            ++it;
+        }
+    }
+
+    // Have every device (and the CPU) hold the same number of leaves in each slice, i.e. the most which all can
+    VkDeviceSize vkSliceSize = MegaX;
+    for (auto it = devices.cbegin( ), end = devices.cend( ); it != end; ++it){
+        const auto& device = it->second;
+        const Slices<VkSha256Result> slices( device.MaxStorageBufferSize( MegaX ) );
+        vkSliceSize = ::std::min( vkSliceSize, slices.SliceSize( device ) );
+    }
+
+    ::std::vector<Instance> instances;
+    for (auto it = devices.begin( ), end = devices.end( ); it != end; ++it){
+        instances.emplace_back( it->first, ::std::move( it->second ), upload, static_cast<uint32_t>( vkSliceSize ) );
+    }
+    return Sharded(
+        hybrid ? (name + " + CPU") : name,
+        ::std::move( instances ),
+        static_cast<size_t>( vkSliceSize / sizeof( VkSha256Result ) ),
+        sharding,
+        hybrid
+    );
+}
+
+bool VkSha256D::Tune(const ISha256D::name_type& name, Upload upload) {
+
+    using ::std::cout;
+    using ::std::endl;
+
+    // Generate the synthetic inputs (deterministically, via xorshift),
+    // and get their root on the CPU to check each choice against
+    ::std::vector<char> inputs( TuningInputCount * TuningInputSize );
+    uint32_t x = 0x9E3779B9U;
+    for (auto it = inputs.begin( ), end = inputs.end( ); it != end; ++it){
+        x ^= (x << 13);
+        x ^= (x >> 17);
+        x ^= (x << 5);
+        (*it) = static_cast<char>( x );
+    }
+    CpuSha256D cpu;
+    for (size_t i = 0U; i < TuningInputCount; ++i){
+        cpu.Add( inputs.data( ) + (i * TuningInputSize), TuningInputSize );
+    }
+    const auto expected = cpu.Root( );
+
+    // Gives the time taken to add the inputs and get their root with the given choices, in ms, going
+    // by the clock (as a run would, so time spent on the host counts too), or a negative value if they
+    // fail to
+    auto measure = [&](const ISha256D::name_type& deviceName, ComputeDevice& device, const Tuning& tuning) -> double {
+        double best = -1.0;
+        for (uint32_t run = 0U; run < TuningRuns; ++run){
+            device.SetTuning( tuning );
+            Instance instance( deviceName, ::std::move( device ), upload, static_cast<uint32_t>( TuningInputCount * sizeof( VkSha256Result ) ) );
+
+            StopWatch sw;
+            sw.Start( );
+            auto ok = true;
+            for (size_t i = 0U; ok && (i < TuningInputCount); ++i){
+                ok = instance.Add( inputs.data( ) + (i * TuningInputSize), TuningInputSize );
+            }
+            const auto root = ok ? instance.Root( ) : ISha256D::out_type( );
+            const auto elapsed = sw.Elapsed( );
+            device = instance.Detach( );
+            if (root != expected){
+                ::std::cerr << "Tuning: " << tuning.Describe( ) << " computed the wrong root; ruling it out." << endl;
+                return -1.0;
+            }
+            if ((best < 0.0) || (elapsed < best)){
+                best = elapsed;
+            }
+        }
+        cout << "Tuning: " << tuning.Describe( ) << " took " << best << "ms" << endl;
+        return best;
+    };
+
+    auto tuned = false;
+    for (auto it = m_devices.begin( ), end = m_devices.end( ); it != end; ++it){
+        if ((name != c_szAll) && (it->first != name)){
+            continue;
+        }
+        auto& device = it->second;
+        cout << "Tuning " << it->first << ".." << endl;
+
+        // First, pick how to reduce the slices: pair-by-pair, by workgroups (in shared memory) of a few
+        // sizes, or by subgroups of each of the sizes which can be required
+        ::std::vector<Tuning> candidates( 1U );
+        candidates.back( ).reduction = Tuning::ReductionBasic;
+        const auto maxWorkgroupSize = Reductions::MaxWorkgroupSize( device );
+        for (uint32_t size = 64U; (size <= 256U) && (size <= maxWorkgroupSize); size <<= 1){
+            candidates.push_back( Tuning( ) );
+            candidates.back( ).reduction = Tuning::ReductionShared;
+            candidates.back( ).reductionWorkgroupSize = size;
+        }
+        const auto subgroupSizes = Reductions::SubgroupSizes( device );
+        for (auto size = subgroupSizes.cbegin( ); size != subgroupSizes.cend( ); ++size){
+            candidates.push_back( Tuning( ) );
+            candidates.back( ).reduction = Tuning::ReductionSubgroups;
+            candidates.back( ).subgroupSize = (*size);
+        }
+        Tuning best;
+        double bestElapsed = -1.0;
+        for (auto candidate = candidates.cbegin( ); candidate != candidates.cend( ); ++candidate){
+            const auto elapsed = measure( it->first, device, *candidate );
+            if ((elapsed >= 0.0) && ((bestElapsed < 0.0) || (elapsed < bestElapsed))){
+                best = (*candidate);
+                bestElapsed = elapsed;
+            }
+        }
+        if (bestElapsed < 0.0){
+            ::std::cerr << "Failed to find any choices which work on " << it->first << "; leaving it untuned." << endl;
+            device.SetTuning( Tuning( ) );
+            continue;
+        }
+
+        // Then, with that, how big to make the workgroups of the mappings (which, if not
+        // folding the leaves, have the largest which the device allows, by default)
+        VkPhysicalDeviceProperties vkPhysicalDeviceProperties = {};
+        ::vkGetPhysicalDeviceProperties( device.PhysicalDevice( ), &vkPhysicalDeviceProperties );
+        const auto& limits = vkPhysicalDeviceProperties.limits;
+        const auto maxMappingWorkgroupSize = ::std::min( limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations );
+        const auto reduction = best;
+        for (uint32_t size = 32U; size <= maxMappingWorkgroupSize; size <<= 1){
+            auto candidate = reduction;
+            candidate.fusedMapping = false;
+            candidate.mappingWorkgroupSize = size;
+            const auto elapsed = measure( it->first, device, candidate );
+            if ((elapsed >= 0.0) && (elapsed < bestElapsed)){
+                best = candidate;
+                bestElapsed = elapsed;
+            }
+        }
+
+        // Lastly, whether to interleave the inputs in the batches, by subgroups of each of the sizes
+        // which the device can have (as each reads a word of each of its inputs at a time)
+        auto lanes = Reductions::SubgroupSizes( device );
+        if (lanes.empty( )){
+            lanes.push_back( 32U );
+        }
+        const auto mapping = best;
+        for (auto size = lanes.cbegin( ); size != lanes.cend( ); ++size){
+            auto candidate = mapping;
+            candidate.mappingLanes = (*size);
+            const auto elapsed = measure( it->first, device, candidate );
+            if ((elapsed >= 0.0) && (elapsed < bestElapsed)){
+                best = candidate;
+                bestElapsed = elapsed;
+            }
+        }
+
+        // Keep the fastest, for this run and those after it
+        device.SetTuning( best );
+        tuned = device.SaveTuning( ) || tuned;
+    }
+    return tuned;
+}
+
 ::std::vector<ISha256D::name_type> VkSha256D::Available(void) const {
 
     ::std::vector<ISha256D::name_type> names;
@@ -238,18 +460,66 @@ VkSha256D::Instance VkSha256D::Get(const ISha256D::name_type& name) {
             names.push_back( pair.first );
         }
     );
+    if (names.size( ) > 1U){
+        names.push_back( c_szAll );
+    }
     return names;
 }
 
-VkSha256D::Instance::Instance(const ::std::string& name, ComputeDevice&& device):
+VkSha256D::Instance::Instance(const ::std::string& name, ComputeDevice&& device, Upload upload, uint32_t sliceSize):
     IVkSha256DInstance( name ),
     m_device( ::std::move( device ) ),
-    m_slices( m_device.MaxStorageBufferSize( MegaX ) ),
+    m_slices( m_device.MaxStorageBufferSize( (sliceSize > 0U) ? sliceSize : MegaX ) ),
     m_batches( m_device.MaxStorageBufferSize( MegaX )) {
 
+    // Upload the inputs before mapping them, if asked to or (by default) if they would otherwise
+    // be read across the bus, and there's a queue to upload them on alongside the mappings
+    VkPhysicalDeviceProperties vkPhysicalDeviceProperties = {};
+    ::vkGetPhysicalDeviceProperties( m_device.PhysicalDevice( ), &vkPhysicalDeviceProperties );
+    const auto discrete = (vkPhysicalDeviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+    if ((upload == UploadOn) || ((upload == UploadAuto) && discrete && m_device.HasTransferQueue( ))){
+        ::std::cout << "Uploading inputs " << (m_device.HasTransferQueue( ) ? "on a transfer queue." : "on the compute queue(s).") << ::std::endl;
+        m_batches.Upload( true );
+    }
+
+    // Interleave the words of the (smaller) inputs in the batches, by groups of as many as found
+    // (by autotuning) to be fastest, or as asked to (via VKMR_INTERLEAVED_BATCHES, 0 for none)
+    auto lanes = m_device.GetTuning( ).mappingLanes;
+    const char* interleaved = ::std::getenv( "VKMR_INTERLEAVED_BATCHES" );
+    if (interleaved != nullptr){
+        lanes = static_cast<uint32_t>( ::std::strtoul( interleaved, nullptr, 10 ) );
+    }
+    if (lanes > 1U){
+        ::std::cout << "Interleaving inputs of up to " << InterleavedInputSize << " byte(s) by groups of " << lanes << "." << ::std::endl;
+        m_batches.Interleave( lanes, InterleavedInputSize );
+    }
+
+    // Keep to a fixed set of batches and slices, recycling them as mappings
+    // and reductions complete, rather than allocating as we go
+    const auto batchCount = m_batches.MaxBatchCount( m_device );
+    const auto sliceCount = m_slices.MaxSliceCount( m_device );
+    m_batches.Cap( ::std::max( batchCount, 2U ) );
+    m_slices.Cap( sliceCount );
+
     m_slices.New( m_device );
-    m_mappings = Mappings::New( m_device, m_batches.MaxBatchCount( m_device ) );
-    m_reductions = Reductions::New( m_device, m_slices.MaxSliceCount( m_device ) );
+    m_reductions = Reductions::New( m_device, sliceCount );
+
+    // Have the mappings fold the leaves in place of the first pass of the reductions, unless asked
+    // not to (via VKMR_FUSED_MAPPING=0, or by the device's tuning) or the groups of them would not
+    // be aligned within the slices
+    auto foldSize = m_reductions ? m_reductions->FoldSize( ) : 0U;
+    const char* fused = ::std::getenv( "VKMR_FUSED_MAPPING" );
+    if (((fused != nullptr) && (::std::strcmp( fused, "0" ) == 0)) || !m_device.GetTuning( ).fusedMapping){
+        foldSize = 0U;
+    }
+    const auto aligned = static_cast<uint32_t>( m_slices.Current( ).AlignedReservationSize( ) );
+    if ((aligned == 0U) || ((foldSize % aligned) != 0U)){
+        foldSize = 0U;
+    }
+    m_mappings = Mappings::New( m_device, batchCount, foldSize );
+    if (m_reductions && m_mappings){
+        m_reductions->Folded( m_mappings->FoldSize( ) > 0U );
+    }
 }
 
 VkSha256D::Instance::Instance(VkSha256D::Instance&& instance):
@@ -260,7 +530,7 @@ VkSha256D::Instance::Instance(VkSha256D::Instance&& instance):
     m_batches( ::std::move( instance.m_batches ) ),
     m_mappings( ::std::move( instance.m_mappings ) ),
     m_reductions( ::std::move( instance.m_reductions ) ),
-    m_buffer( ::std::move( instance.m_buffer) ) {
+    m_leaves( ::std::move( instance.m_leaves ) ) {
 }
 
 VkSha256D::Instance::~Instance() {
@@ -269,7 +539,7 @@ VkSha256D::Instance::~Instance() {
     m_batch = Batch( );
     m_mappings.reset( );
     m_reductions.reset( );
-    m_buffer.clear( );
+    m_leaves.clear( );
 }
 
 VkSha256D::Instance& VkSha256D::Instance::operator=(VkSha256D::Instance&& instance) {
@@ -281,151 +551,497 @@ VkSha256D::Instance& VkSha256D::Instance::operator=(VkSha256D::Instance&& instan
     m_batches = ::std::move( instance.m_batches );
     m_mappings = ::std::move( instance.m_mappings );
     m_reductions = ::std::move( instance.m_reductions );
-    m_buffer = ::std::move( instance.m_buffer );
+    m_leaves = ::std::move( instance.m_leaves );
     return (*this);
 }
 
 ISha256D::out_type VkSha256D::Instance::Root(void) {
 
-    // Flush the buffer
-    this->Flush( );
+    // Flush any leaves
+    this->FlushLeaves( );
 
-    // If the current batch is not empty, then send it off for mapping
-    // And then wait for all such mappings to finish
-    auto& current = m_slices.Current( );
-    if (!m_batch.Empty( )){
-        m_mappings->Map( ::std::move( m_batch ), current.Sub( ), m_device.Queue( ) );
-    }
-    m_mappings->WaitFor( );
+    // Send the current batch off for mapping, as the last into the current slice
+    this->Map( ::std::move( m_batch ), true );
 
-    // Apply the reduction to all of the slices and wait for all to finish
+    // Apply the reduction to all of the slices (each once its mappings
+    // have completed, on the device) and wait for all to finish
     while (m_slices.Has( )){
         const auto& slice = m_slices.Any( );
         if (slice){
             auto number = slice.Number( );
             m_reductions->Reduce(
                 m_slices.Remove( number ),
-                m_device
+                m_device,
+                m_mappings->Pending( number )
             );
         }
     }
-    return m_reductions->WaitFor( );
+    const auto root = m_reductions->WaitFor( m_device, m_slices );
+    m_mappings->WaitFor( m_batches );
+
+    // Report how much memory was allocated from the device, and how often it was handed out
+    const auto stats = m_device.MemoryStats( );
+    ::std::cout << "Memory: " << stats.blockCount << " block(s) (" << stats.vkBlockSize << " byte(s)) allocated; ";
+    ::std::cout << stats.allocationCount << " range(s) handed out, " << stats.freeCount << " handed back." << ::std::endl;
+    return root;
 }
 
-bool VkSha256D::Instance::Add(const ISha256D::arg_type& arg) {
+bool VkSha256D::Instance::Add(const char* data, size_t size) {
+
+    // Update the state of any in-flight operations
+    this->Update( );
+
+    // Keep the leaves and inputs in the order in which they were added
+    if (!m_leaves.empty( ) && !this->FlushLeaves( )){
+        return false;
+    }
+
+    while (true){
+        auto& slice = m_slices.Current( );
+        if (slice.Available( ) == 0U){
+            // Need to kick off a new mapping op and then create new slice + batch
+            if (!this->MapBatch( ) || !this->ReduceCurrent( ) || !this->NewSlice( )){
+                return false;
+            }
+            continue;
+        }
+
+        // Try and add the input straight into the current batch
+        if (m_batch.Push( data, size )){
+            return slice.Reserve( );
+        }
+
+        // If we get here, then the batch may be full, in which case
+        // send it off for mapping and try again with a new one
+        if (m_batch && m_batch.Empty( )){
+            // Won't fit in any batch
+            return false;
+        }
+        if (!this->MapBatch( )){
+            return false;
+        }
+    }
+}
+
+bool VkSha256D::Instance::AddLeaf(const char* leaf) {
+
+    // Update the state of any in-flight operations
+    this->Update( );
+
+    // Convert to the layout of the result(s) of the mapping op (i.e. big-endian words)
+    const auto p = reinterpret_cast<const uint8_t*>( leaf );
+    VkSha256Result result = {};
+    for (uint32_t i = 0U; i < SHA256_WC; ++i){
+        result.data[i] = (uint32_t( p[i*4] ) << 24) | (uint32_t( p[i*4+1] ) << 16) | (uint32_t( p[i*4+2] ) << 8) | uint32_t( p[i*4+3] );
+    }
+    m_leaves.push_back( result );
+    if (m_leaves.size( ) == m_slices.Current( ).AlignedReservationSize( )){
+        return this->FlushLeaves( );
+    }
+    return true;
+}
+
+bool VkSha256D::Instance::Shard(Slice<VkSha256Result>::number_type number) {
+
+    // Have the root of every slice read back, rather than reduced with the others
+    m_reductions->Sharded( true );
+
+    // Send off the current slice, if it has been filled (i.e. as the shard before this one),
+    // and then number the one after it as given
+    if (!m_leaves.empty( ) && !this->FlushLeaves( )){
+        return false;
+    }
+    if (!m_slices.Current( )){
+        // It was sent off already, when handed on from
+        if (!this->NewSlice( )){
+            return false;
+        }
+    }else if (m_slices.Current( ).Available( ) == 0U){
+        if (!this->MapBatch( ) || !this->ReduceCurrent( ) || !this->NewSlice( )){
+            return false;
+        }
+    }
+    return m_slices.Renumber( number );
+}
+
+bool VkSha256D::Instance::Submit(void) {
+
+    if (!m_leaves.empty( ) && !this->FlushLeaves( )){
+        return false;
+    }
+    const auto& slice = m_slices.Current( );
+    if (!slice || (slice.Available( ) > 0U)){
+        return true;
+    }
+    return this->MapBatch( ) && this->ReduceCurrent( );
+}
+
+const ::std::map<Slice<VkSha256Result>::number_type, VkSha256Result>& VkSha256D::Instance::Roots(void) {
+
+    this->Root( );
+    return m_reductions->Roots( );
+}
+
+ComputeDevice VkSha256D::Instance::Detach(void) {
+
+    m_slices = Slices<VkSha256Result>( );
+    m_batch = Batch( );
+    m_mappings.reset( );
+    m_reductions.reset( );
+    m_batches = Batches( 0U );
+    m_leaves.clear( );
+    return ::std::move( m_device );
+}
+
+void VkSha256D::Instance::Update(void) {
 
     // Update the state of any in-flight reductions
-    m_reductions->Update( );
+    m_reductions->Update( m_device, m_slices );
 
     // Update the state of any in-flight mappings
-    auto mapped = m_mappings->Update( );
-    while (!mapped.empty( )){
-        auto sub = ::std::move( mapped.back( ) );
-        mapped.pop_back( );
+    m_mappings->Update( m_batches );
+}
+
+Batch VkSha256D::Instance::NewBatch(void) {
+
+    auto batch = m_batches.New( m_device );
+    while (!batch && m_mappings->Has( )){
+        // Wait for an in-flight mapping to hand its batch back
+        m_mappings->WaitForAny( m_batches );
+        batch = m_batches.New( m_device );
+    }
+    return batch;
+}
 
-        const auto number = sub.Number( );
-        auto& slice = m_slices[number];
-        slice += ::std::move( sub );
-        if (slice.IsFilled( )){
-            std::cout << "Slice #" << slice.Number( ) << " has been filled." << ::std::endl;
+bool VkSha256D::Instance::NewSlice(void) {
 
-            // Kick off a new reduction
-            m_reductions->Reduce( m_slices.Remove( number ), m_device );
+    while (!m_slices.New( m_device )){
+        // Slices are handed back by reductions as they complete
+        if (!m_reductions->Has( )){
+            return false;
         }
+        m_reductions->WaitForAny( m_device, m_slices );
     }
+    return true;
+}
 
-    // Add to the buffer, and check it if can be flushed
-    m_buffer.push_back( arg );
-    auto& slice = m_slices.Current( );
-    if (m_buffer.size( ) == slice.AlignedReservationSize( )){
-        return this->Flush( );
+bool VkSha256D::Instance::ReduceCurrent(void) {
+
+    const auto number = m_slices.Current( ).Number( );
+    std::cout << "Slice #" << number << " has been filled." << ::std::endl;
+
+    // Chain the reduction onto the mappings (on the device), rather than waiting for them here
+    const auto vkResult = m_reductions->Reduce(
+        m_slices.Remove( number ),
+        m_device,
+        m_mappings->Pending( number )
+    );
+    return (vkResult == VK_SUCCESS);
+}
+
+bool VkSha256D::Instance::MapBatch(void) {
+
+    // Get a new batch to follow this one
+    auto next = this->NewBatch( );
+    if (!next){
+        return false;
     }
 
-    // We presume it will be able to..
+    if (!m_batch.Empty( )){
+        // Unless this batch fills up the rest of the slice, the sub-slice it's mapped
+        // into must end on an aligned boundary, so carry any inputs after that over
+        auto& slice = m_slices.Current( );
+        const auto tail = (slice.Available( ) > 0U)
+            ? (slice.Reserved( ) % slice.AlignedReservationSize( ))
+            : 0U;
+        if ((tail > 0U) && (tail < slice.Reserved( ))){
+            if (!m_batch.Carry( tail, next )){
+                return false;
+            }
+            slice.Unreserve( tail );
+        }
+        if (!this->Map( ::std::move( m_batch ), (slice.Available( ) == 0U) )){
+            return false;
+        }
+        slice.Reserve( next.Count( ) );
+    }
+    m_batch = ::std::move( next );
     return true;
 }
 
-bool VkSha256D::Instance::Flush(void) {
+bool VkSha256D::Instance::Map(Batch&& batch, bool last) {
 
-    // Look for an early out
-    if (m_buffer.empty( )){
+    // Figure out where the batch falls among the groups of leaves folded by the mappings, if they
+    // are: those in the slice ahead of it in its group are mapped (again) with it, to be folded in
+    auto& slice = m_slices.Current( );
+    const auto foldSize = m_mappings->FoldSize( );
+    Fold fold = {};
+    fold.last = last;
+    if (foldSize > 0U){
+        fold.head = static_cast<uint32_t>( slice.Count( ) % foldSize );
+        fold.applicable = static_cast<uint32_t>( (slice.Number( ) > 1U)
+            ? slice.Capacity( )
+            : (slice.Count( ) + slice.Reserved( )) );
+    }
+
+    // Nothing to map, unless the last mapping into the slice left any leaves to be folded
+    if (batch.Empty( ) && (!batch || !last || (fold.head == 0U))){
         return true;
     }
+    const auto vkResult = m_mappings->Map( ::std::move( batch ), slice.Sub( fold.head ), m_device.Queue( ), m_device.TransferQueue( ), fold );
+    return (vkResult == VK_SUCCESS);
+}
 
-    auto flush = [&]() -> bool {
-        // Setup
-        const auto count = m_buffer.size( );
-        auto& slice = m_slices.Current( );
-        auto reserve = [&](void) -> bool {
-            if (slice.Reserve( count )){
-                // Happy days
-                m_buffer.clear( );
-                return true;
-            }else{
-                m_batch.Pop( count );
+bool VkSha256D::Instance::FlushLeaves(void) {
+
+    while (!m_leaves.empty( )){
+        auto& current = m_slices.Current( );
+        const auto available = current.Available( );
+        if (available == 0U){
+            // Need to kick off a new mapping op and then create new slice + batch
+            if (!this->MapBatch( ) || !this->ReduceCurrent( ) || !this->NewSlice( )){
                 return false;
             }
-        };
+            continue;
+        }
+
+        // Try and add as many of the leaves as will fit in the current slice to the current batch,
+        // and if it won't take them (i.e. because it's full, or holds inputs), send it off for mapping
+        const auto count = ::std::min( available, m_leaves.size( ) );
+        if (!m_batch.Push( m_leaves.data( ), count )){
+            if (m_batch && m_batch.Empty( )){
+                return false;
+            }
+            if (!this->MapBatch( )){
+                return false;
+            }
+            continue;
+        }
+        if (!current.Reserve( count )){
+            m_batch.Pop( count );
+            return false;
+        }
+        m_leaves.erase( m_leaves.begin( ), m_leaves.begin( ) + count );
+    }
+    return true;
+}
+
+VkSha256D::Sharded::Sharded(const ISha256D::name_type& name, ::std::vector<Instance>&& instances, size_t capacity, Sharding sharding, bool hybrid):
+    IVkSha256DInstance( name ),
+    m_instances( ::std::move( instances ) ),
+    m_cpu( hybrid ? new CpuSlices( capacity ) : nullptr ),
+    m_sharding( sharding ),
+    m_capacity( capacity ),
+    m_count( 0U ),
+    m_number( 0U ),
+    m_current( 0U ),
+    m_shards( m_instances.size( ) + 1U, 0U ),
+    m_elapsed( m_instances.size( ) + 1U, 0.0 ) {
+
+    ::std::cout << "Sharding slices of " << m_capacity << " leaves across " << m_instances.size( ) << " device(s)";
+    if (m_cpu){
+        ::std::cout << " and " << m_cpu->Threads( ) << " CPU thread(s)";
+    }
+    ::std::cout << ((m_sharding == ShardThroughput) ? ", by throughput." : ", in turn.") << ::std::endl;
+}
 
-        // Try and add the strings to the current batch
-        if (m_batch.Push( m_buffer )){
-            return reserve( );
+ISha256D::out_type VkSha256D::Sharded::Root(void) {
+
+    // Look for an early out
+    if (m_number == 0U){
+        return "";
+    }
+    m_elapsed[m_current] += m_stopWatch.Elapsed( );
+
+    // Gather the roots of the slices from every instance (and the CPU) which took any
+    ::std::map<number_type, VkSha256Result> roots;
+    for (size_t i = 0U; i < m_shards.size( ); ++i){
+        if (m_shards[i] == 0U){
+            continue;
+        }
+        if (i < m_instances.size( )){
+            auto& instance = m_instances[i];
+            const auto& shards = instance.Roots( );
+            roots.insert( shards.cbegin( ), shards.cend( ) );
+            ::std::cout << instance.Name( ) << ": took " << m_shards[i] << " slice(s)";
+        }else{
+            const auto& shards = m_cpu->Roots( );
+            roots.insert( shards.cbegin( ), shards.cend( ) );
+            ::std::cout << "CPU: took " << m_shards[i] << " slice(s)";
         }
+        ::std::cout << ", adding to them for " << m_elapsed[i] << "ms";
+        const auto perSlice = this->PerSlice( i );
+        if (perSlice > 0.0){
+            ::std::cout << ", taking ~" << perSlice << "ms over each";
+        }
+        ::std::cout << "." << ::std::endl;
+    }
+    if (roots.size( ) != m_number){
+        return "";
+    }
 
-        // If we get here, then the batch may be full,
-        // in which case, immediately send it off for mapping..
-        if (m_batch){
-            m_mappings->Map( ::std::move( m_batch ), slice.Sub( ), m_device.Queue( ) );
+    // The first slice is only ever reduced as-is when it's the only one, in which case
+    // its root is that of the whole tree; convert it to little endianess for output
+    if (m_number == 1U){
+        auto vkSha256Result = roots.cbegin( )->second;
+        for (auto u = 0U; u < SHA256_WC; ++u){
+            const uint32_t w = vkSha256Result.data[u];
+            vkSha256Result.data[u] = SWOP_ENDS_U32( w );
         }
+        return print_bytes_ex( vkSha256Result.data, SHA256_WC ).str( );
+    }
 
-        // And, try again with a new batch
-        m_batch = m_batches.New( m_device );
-        if (m_batch.Push( m_buffer )){
-            return reserve( );
+    // Otherwise, the roots of the slices are the leaves of the tree above them, in slice order
+    CpuSha256D above;
+    for (auto it = roots.cbegin( ), end = roots.cend( ); it != end; ++it){
+        char hash[sizeof( VkSha256Result )];
+        for (uint32_t w = 0U; w < SHA256_WC; ++w){
+            const uint32_t u = it->second.data[w];
+            hash[w*4] = char( u >> 24 );
+            hash[w*4+1] = char( u >> 16 );
+            hash[w*4+2] = char( u >> 8 );
+            hash[w*4+3] = char( u );
         }
+        above.AddLeaf( hash );
+    }
+    return above.Root( );
+}
+
+bool VkSha256D::Sharded::Add(const char* data, size_t size) {
+
+    if (!this->Next( )){
         return false;
-    };
+    }
+    const auto added = (m_current < m_instances.size( ))
+        ? m_instances[m_current].Add( data, size )
+        : m_cpu->Add( data, size );
+    if (!added){
+        return false;
+    }
+    m_count++;
+    return true;
+}
 
-    const auto available = m_slices.Current( ).Available( );
-    if (available == 0U){
-        // Need to kick off a new mapping op and then create new slice + batch
-        auto& current = m_slices.Current( );
-        m_mappings->Map( ::std::move( m_batch ), current.Sub( ), m_device.Queue( ) );
+bool VkSha256D::Sharded::AddLeaf(const char* leaf) {
 
-        // Allocate a new slice
-        auto& slice = m_slices.New( m_device );
-        if (!slice){
-            return false;
+    if (!this->Next( )){
+        return false;
+    }
+    const auto added = (m_current < m_instances.size( ))
+        ? m_instances[m_current].AddLeaf( leaf )
+        : m_cpu->AddLeaf( leaf );
+    if (!added){
+        return false;
+    }
+    m_count++;
+    return true;
+}
+
+bool VkSha256D::Sharded::Next(void) {
+
+    if ((m_number > 0U) && (m_count < m_capacity)){
+        return true;
+    }
+
+    // Count the time spent adding to the slice just filled against whichever took it, and
+    // send it off now (rather than once the same one takes another, or at the end)
+    if (m_number > 0U){
+        m_elapsed[m_current] += m_stopWatch.Elapsed( );
+        if (m_current < m_instances.size( )){
+            if (!m_instances[m_current].Submit( )){
+                return false;
+            }
+        }else{
+            m_cpu->Seal( );
+        }
+    }
+
+    // Pick whichever is to take the next slice: either the next in turn, or whichever would get
+    // through all of the slices it has yet to reduce, plus this one, soonest at its rate so far
+    // (i.e. any yet to take one, first; any yet to reduce one going by the mean rate of those
+    // which have; and, if none has reduced any yet, the least behind)
+    const auto count = m_cpu ? (m_instances.size( ) + 1U) : m_instances.size( );
+    if (m_sharding == ShardThroughput){
+        for (auto it = m_instances.begin( ), end = m_instances.end( ); it != end; ++it){
+            it->Update( );
         }
 
-        // And a new batch
-        m_batch = m_batches.New( m_device );
-        return flush( );
-    }else if (available >= m_buffer.size( )){
-        // Don't need to make any special accomodations..
-        return flush( );
+        ::std::vector<double> perSlices( count, 0.0 );
+        double known = 0.0;
+        size_t knownCount = 0U;
+        for (size_t i = 0U; i < count; ++i){
+            if (m_shards[i] > 0U){
+                perSlices[i] = this->PerSlice( i );
+                if (perSlices[i] > 0.0){
+                    known += perSlices[i];
+                    knownCount++;
+                }
+            }
+        }
+        const auto mean = (knownCount > 0U) ? (known / knownCount) : 0.0;
+
+        auto picked = count;
+        double least = 0.0;
+        for (size_t i = 0U; i < count; ++i){
+            auto projected = 0.0;
+            if (m_shards[i] > 0U){
+                const auto perSlice = (perSlices[i] > 0.0) ? perSlices[i] : mean;
+                if (perSlice == 0.0){
+                    continue;
+                }
+                projected = perSlice * (this->Outstanding( i ) + 1U);
+            }
+            if ((picked == count) || (projected < least)){
+                least = projected;
+                picked = i;
+            }
+        }
+        if (picked == count){
+            picked = 0U;
+            for (size_t i = 1U; i < count; ++i){
+                if (this->Outstanding( i ) < this->Outstanding( picked )){
+                    picked = i;
+                }
+            }
+        }
+        m_current = picked;
     }else{
-        // Capture the overflow
-        decltype( m_buffer ) overflow;
-        overflow.reserve( m_buffer.size( ) );
-        do {
-            overflow.push_back( ::std::move( m_buffer.back( ) ) );
-            m_buffer.pop_back( );
-        } while (m_buffer.size( ) > available);
-        ::std::cout << "Overflow: " << overflow.size( ) << "." << ::std::endl;
+        m_current = m_number % count;
+    }
+    m_number++;
+    m_count = 0U;
+    m_shards[m_current]++;
+
+    m_stopWatch.Start( );
+    return (m_current < m_instances.size( ))
+        ? m_instances[m_current].Shard( m_number )
+        : m_cpu->Shard( m_number );
+}
+
+size_t VkSha256D::Sharded::Outstanding(size_t i) const {
+
+    if (i < m_instances.size( )){
+        return m_shards[i] - m_instances[i].Reduced( );
+    }
+    return m_cpu->Pending( );
+}
 
-        // Now, try and flush
-        auto result = flush( );
+double VkSha256D::Sharded::PerSlice(size_t i) const {
 
-        // Regardless of the outcome, put back what we removed from the buffer
-        while (!overflow.empty( )){
-            m_buffer.push_back( ::std::move( overflow.back( ) ) );
-            overflow.pop_back( );
+    // Going by the time spent on the device by the mappings and reductions, by their timers, if
+    // it has any; or else by the time spent adding to its slices (i.e. held up waiting on it)
+    if (i < m_instances.size( )){
+        const auto& instance = m_instances[i];
+        const auto reduced = instance.Reduced( );
+        if (reduced == 0U){
+            return 0.0;
         }
-        return result;
+        const auto elapsed = instance.Elapsed( );
+        return (elapsed > 0.0) ? (elapsed / reduced) : (m_elapsed[i] / m_shards[i]);
     }
 
-    return false;
+    // The CPU gets through as many slices at once as it has threads
+    return m_cpu->PerSlice( ) / m_cpu->Threads( );
 }
 
 } // namespace vkmr
@@ -9,11 +9,14 @@
 
 // C++ Standard Library Headers
 #include <functional>
+#include <map>
 #include <unordered_map>
 
 // Local Project Headers
 #include "ISha256D.h"
 #include "Ops.h"
+#include "StopWatch.h"
+#include "SHA-256plus.h"
 
 namespace vkmr {
 
@@ -31,6 +34,26 @@ public:
 class VkSha256D {
 public:
     class Instance;
+    class Sharded;
+
+    // Whether inputs are uploaded into device-local memory (on a transfer queue) before being
+    // mapped, rather than read by the mapping from host memory; by default, only by discrete
+    // devices with a queue family to upload on
+    enum Upload {
+        UploadAuto,
+        UploadOff,
+        UploadOn
+    };
+
+    // How the slices of a tree sharded across devices are handed out: in turn, or to whichever
+    // looks to get through another one soonest, going by how long those it has reduced took
+    enum Sharding {
+        ShardRoundRobin,
+        ShardThroughput
+    };
+
+    // The name under which all of the devices are available together, sharding the tree
+    static const char* const c_szAll;
 
     VkSha256D();
     ~VkSha256D();
@@ -40,7 +63,15 @@ public:
 
     bool Has(const ISha256D::name_type&) const;
 
-    Instance Get(const ISha256D::name_type&);
+    Instance Get(const ISha256D::name_type&, Upload = UploadAuto);
+
+    // Returns the named device, or else all of them together, each taking whole slices of
+    // the leaves, along with the CPU (hashing and reducing slices on threads of its own) if so given
+    Sharded GetSharded(const ISha256D::name_type&, Upload = UploadAuto, Sharding = ShardRoundRobin, bool = false);
+
+    // Benchmarks the choices for the pipelines of the named device (or all of them) on a synthetic
+    // slice, and saves the fastest to the device's profile, for later runs to load at startup
+    bool Tune(const ISha256D::name_type&, Upload = UploadAuto);
 
     ::std::vector<ISha256D::name_type> Available(void) const;
 
@@ -56,7 +87,7 @@ public:
     typedef ::std::string arg_type;
     typedef ::std::string out_type;
 
-    Instance(const ::std::string&, ComputeDevice&&);
+    Instance(const ::std::string&, ComputeDevice&&, Upload = UploadAuto, uint32_t = 0U);
     Instance(Instance&&);
     Instance(Instance const&) = delete;
     virtual ~Instance();
@@ -66,12 +97,59 @@ public:
 
     ISha256D::out_type Root(void);
 
-    bool Add(const ISha256D::arg_type&);
+    bool Add(const ISha256D::arg_type& arg) { return this->Add( arg.data( ), arg.size( ) ); }
+    bool Add(const char*, size_t);
+    bool AddLeaf(const char*);
+
+    // Starts the slice with the given number (once the current one, if any, has been filled) as
+    // one shard of a tree spread across devices, whose root is read back rather than reduced further
+    bool Shard(Slice<VkSha256Result>::number_type);
+
+    // Sends the current slice (as a shard, once it has been filled) off for mapping and reduction,
+    // so the device gets on with it while others take the slices after it; the next is started
+    // once the instance is given another shard
+    bool Submit(void);
+
+    // Returns the roots of all of the slices started as shards, once they have been reduced
+    const ::std::map<Slice<VkSha256Result>::number_type, VkSha256Result>& Roots(void);
+
+    // Returns the number of slices started as shards which have been reduced so far
+    size_t Reduced(void) const { return m_reductions->Roots( ).size( ); }
+
+    // Returns the time spent on the device by the mappings and reductions which
+    // have completed so far, in ms, going by their timers (if any)
+    double Elapsed(void) const { return m_mappings->Elapsed( ) + m_reductions->Elapsed( ); }
+
+    // Updates the state of any in-flight mappings and reductions
+    void Update(void);
+
+    // Releases everything allocated from the device, and hands the device itself back
+    ComputeDevice Detach(void);
 
 private:
-    // Flushes the contents of the buffer into
-    // the current batch/slice as appropriate
-    bool Flush(void);
+    // Returns a new batch, waiting for one to be handed back by an
+    // in-flight mapping if another can't be allocated
+    Batch NewBatch(void);
+
+    // Starts a new slice, waiting for one to be handed back by an
+    // in-flight reduction if another can't be allocated
+    bool NewSlice(void);
+
+    // Kicks off the reduction of the current slice, once all of the mappings
+    // into it have been, to start (on the device) once they have completed
+    bool ReduceCurrent(void);
+
+    // Sends the current batch off for mapping into the current
+    // slice, and replaces it with a new one
+    bool MapBatch(void);
+
+    // Sends the given batch off for mapping into the current slice,
+    // as the last into it if so given
+    bool Map(Batch&&, bool);
+
+    // Flushes the pending leaves into the current batch/slice,
+    // to be copied (rather than mapped) into the slice
+    bool FlushLeaves(void);
 
     ComputeDevice m_device;
     Slices<VkSha256Result> m_slices;
@@ -80,7 +158,46 @@ private:
 
     ::std::unique_ptr<Mappings> m_mappings;
     ::std::unique_ptr<Reductions> m_reductions;
-    ::std::vector<arg_type> m_buffer;
+    ::std::vector<VkSha256Result> m_leaves;
+};
+
+class VkSha256D::Sharded: public IVkSha256DInstance {
+public:
+    typedef Slice<VkSha256Result>::number_type number_type;
+
+    Sharded(const ISha256D::name_type&, ::std::vector<Instance>&&, size_t, Sharding, bool);
+
+    ISha256D::out_type Root(void);
+
+    bool Add(const ISha256D::arg_type& arg) { return this->Add( arg.data( ), arg.size( ) ); }
+    bool Add(const char*, size_t);
+    bool AddLeaf(const char*);
+
+private:
+    // Hands the next slice to whichever instance (or the CPU) is to take it, once the current one is full
+    bool Next(void);
+
+    // Returns the number of slices taken by the given instance (or, after the last, the CPU)
+    // which are yet to be reduced
+    size_t Outstanding(size_t) const;
+
+    // Estimates the time taken by the given instance (or the CPU) to get through each slice, in ms,
+    // going by those it has reduced so far, or returns 0 if it has yet to reduce any
+    double PerSlice(size_t) const;
+
+    ::std::vector<Instance> m_instances;
+    ::std::unique_ptr<CpuSlices> m_cpu;
+    Sharding m_sharding;
+
+    // The number of leaves in each slice, and in the current one, and its number and taker
+    size_t m_capacity, m_count;
+    number_type m_number;
+    size_t m_current;
+
+    // The number of slices taken by each instance (and the CPU), and the time spent adding to them
+    ::std::vector<number_type> m_shards;
+    ::std::vector<double> m_elapsed;
+    StopWatch m_stopWatch;
 };
 #endif // defined (VULKAN_SUPPORT)
 
@@ -8,32 +8,94 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <cstring>
 
 // Declarations
 #include "Shaders.h"
 
 namespace vkmr {
 
+// Globals
+//
+
+// The SPIR-V of each of the shaders, as compiled (by glslc -mfmt=num)
+// into the build directory ahead of the executable itself
+static const uint32_t c_sha256N[] = {
+#include "SHA-256-n.spv.inc"
+};
+static const uint32_t c_sha256NFused[] = {
+#include "SHA-256-n-fused.spv.inc"
+};
+static const uint32_t c_sha256TwoBE[] = {
+#include "SHA-256-2-be.spv.inc"
+};
+static const uint32_t c_sha256TwoBESubgroups[] = {
+#include "SHA-256-2-be-subgroups.spv.inc"
+};
+static const uint32_t c_sha256TwoBEShared[] = {
+#include "SHA-256-2-be-shared.spv.inc"
+};
+
+typedef struct {
+    const char* szName;
+    const uint32_t* pCode;
+    size_t codeSize;
+} EmbeddedShader;
+
+static const EmbeddedShader c_embeddedShaders[] = {
+    { "SHA-256-n.spv", c_sha256N, sizeof( c_sha256N ) },
+    { "SHA-256-n-fused.spv", c_sha256NFused, sizeof( c_sha256NFused ) },
+    { "SHA-256-2-be.spv", c_sha256TwoBE, sizeof( c_sha256TwoBE ) },
+    { "SHA-256-2-be-subgroups.spv", c_sha256TwoBESubgroups, sizeof( c_sha256TwoBESubgroups ) },
+    { "SHA-256-2-be-shared.spv", c_sha256TwoBEShared, sizeof( c_sha256TwoBEShared ) }
+};
+
+// Class(es)
+//
+
 const VkAllocationCallbacks* ShaderModule::pAllocator = VK_NULL_HANDLE;
 
-ShaderModule::ShaderModule(VkDevice vkDevice, const ::std::string& path):
+ShaderModule::ShaderModule(VkDevice vkDevice, const ::std::string& name):
     m_vkResult( VK_RESULT_MAX_ENUM ),
     m_vkDevice( vkDevice ),
     m_vkShaderModule( VK_NULL_HANDLE ) {
 
-    ::std::ifstream ifs( path, ::std::ios::binary | ::std::ios::ate );
-    const auto g = ifs.tellg( );
-    ifs.seekg( 0 );
-    std::vector<uint32_t> shaderCode( g / sizeof( uint32_t ) );
-    ifs.read( reinterpret_cast<char*>( shaderCode.data( ) ), g );
-    ifs.close( );
-    ::std::cout << "Loaded " << shaderCode.size() << " (32-bit) word(s) of shader code from " << path << ::std::endl;
+    // Look for the code among that embedded in the executable,
+    // and only go looking for a file if it's not there
+    const uint32_t* pCode = nullptr;
+    size_t codeSize = 0;
+    for (const auto& embedded : c_embeddedShaders){
+        if (::strcmp( embedded.szName, name.c_str( ) ) == 0){
+            pCode = embedded.pCode;
+            codeSize = embedded.codeSize;
+            break;
+        }
+    }
+
+    std::vector<uint32_t> shaderCode;
+    if (pCode == nullptr){
+        ::std::ifstream ifs( name, ::std::ios::binary | ::std::ios::ate );
+        const auto g = ifs.tellg( );
+        if (g <= 0){
+            ::std::cerr << "Failed to load shader code from " << name << ::std::endl;
+            m_vkResult = VK_ERROR_INITIALIZATION_FAILED;
+            return;
+        }
+        ifs.seekg( 0 );
+        shaderCode.resize( g / sizeof( uint32_t ) );
+        ifs.read( reinterpret_cast<char*>( shaderCode.data( ) ), g );
+        ifs.close( );
+        ::std::cout << "Loaded " << shaderCode.size() << " (32-bit) word(s) of shader code from " << name << ::std::endl;
+
+        pCode = shaderCode.data( );
+        codeSize = shaderCode.size( ) * sizeof( uint32_t );
+    }
 
     // Create the shader module
     VkShaderModuleCreateInfo vkShaderModuleCreateInfo = {};
     vkShaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    vkShaderModuleCreateInfo.codeSize = shaderCode.size( ) * sizeof( uint32_t );
-    vkShaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>( shaderCode.data( ) );
+    vkShaderModuleCreateInfo.codeSize = codeSize;
+    vkShaderModuleCreateInfo.pCode = pCode;
     m_vkResult = ::vkCreateShaderModule( vkDevice, &vkShaderModuleCreateInfo, pAllocator, &m_vkShaderModule );
 }
 
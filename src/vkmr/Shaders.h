@@ -21,6 +21,8 @@ namespace vkmr {
 // Encapsulates a shader module
 class ShaderModule {
 public:
+    // Creates the module from the named shader, as embedded in the
+    // executable or else, failing that, from the file of that name
     ShaderModule(VkDevice, const ::std::string&);
     ShaderModule(ShaderModule&&);
     ShaderModule(ShaderModule const&) = delete;
@@ -8,7 +8,9 @@
 //
 
 // C++ Standard Library Headers
+#include <algorithm>
 #include <unordered_map>
+#include <vector>
 
 // Nearby Project Headers
 #include "Utils.h"
@@ -41,7 +43,7 @@ public:
     Slice(Slice&& slice):
         m_vkDevice( slice.m_vkDevice ),
         m_vkBuffer( slice.m_vkBuffer ),
-        m_vkDeviceMemory( slice.m_vkDeviceMemory ),
+        m_memory( ::std::move( slice.m_memory ) ),
         m_vkSize( slice.m_vkSize ),
         m_sliced( slice.m_sliced ),
         m_reserved( slice.m_reserved ),
@@ -63,7 +65,7 @@ public:
 
             m_vkDevice = slice.m_vkDevice;
             m_vkBuffer = slice.m_vkBuffer;
-            m_vkDeviceMemory = slice.m_vkDeviceMemory;
+            m_memory = ::std::move( slice.m_memory );
             m_vkSize = slice.m_vkSize;
             m_sliced = slice.m_sliced;
             m_reserved = slice.m_reserved;
@@ -78,7 +80,7 @@ public:
     }
 
     Slice& operator=(Slice const&) = delete;
-    operator bool() const { return (m_vkDeviceMemory != VK_NULL_HANDLE); }
+    operator bool() const { return static_cast<bool>( m_memory ); }
 
     Slice& operator+=(Slice&& sub) {
         if (sub.Number( ) == Number( )){
@@ -133,6 +135,13 @@ public:
     // Return the number of reservations in the slice
     size_type Reserved(void) const { return m_reserved; }
 
+    // Counts the given number of elements as having been written
+    // into the slice directly (i.e. rather than via a sub slice)
+    void Fill(size_type count = 1U) {
+        m_sliced += count;
+        m_filled += count;
+    }
+
     // Returns the number of elements in the slice
     size_type Count(void) const { return m_sliced; }
 
@@ -140,12 +149,13 @@ public:
     size_type Capacity(void) const { return m_capacity; }
  
     // Gets the sub slice encompassing the reservations since the last 
-    // sub slice, if any
-    Slice Sub(void) {
+    // sub slice, if any, starting the given number of elements before them
+    Slice Sub(size_type behind = 0U) {
 
         // Start with an empty slice
         Slice slice;
-        if (m_reserved > 0U){
+        behind = ::std::min( behind, m_sliced );
+        if ((m_reserved > 0U) || (behind > 0U)){
             const VkAllocationCallbacks *pAllocator = VK_NULL_HANDLE;
 
             // Create the buffer
@@ -154,7 +164,7 @@ public:
             vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
             vkBufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             vkBufferCreateInfo.usage = c_vkBufferUsageFlags;
-            vkBufferCreateInfo.size = (m_reserved * sizeof( T ));
+            vkBufferCreateInfo.size = ((behind + m_reserved) * sizeof( T ));
             VkResult vkResult = ::vkCreateBuffer(
                 m_vkDevice,
                 &vkBufferCreateInfo,
@@ -166,14 +176,14 @@ public:
                 vkResult = ::vkBindBufferMemory(
                     m_vkDevice,
                     vkBuffer,
-                    m_vkDeviceMemory,
-                    (m_sliced * sizeof( T ))
+                    *m_memory,
+                    m_memory.Offset( ) + ((m_sliced - behind) * sizeof( T ))
                 );
             }else{
                 vkBuffer = VK_NULL_HANDLE;
             }
             if (vkResult == VK_SUCCESS){
-                slice = Slice( m_number, m_vkDevice, vkBuffer, VK_NULL_HANDLE, vkBufferCreateInfo.size );
+                slice = Slice( m_number, m_vkDevice, vkBuffer, MemoryRange( ), vkBufferCreateInfo.size );
                 slice.Reserve( m_reserved );
 
                 // Update our own internal state
@@ -196,10 +206,10 @@ public:
     }
 
 private:
-    Slice(number_type number, VkDevice vkDevice, VkBuffer vkBuffer, VkDeviceMemory vkDeviceMemory, VkDeviceSize vkSize):
+    Slice(number_type number, VkDevice vkDevice, VkBuffer vkBuffer, MemoryRange&& memory, VkDeviceSize vkSize):
         m_vkDevice( vkDevice ),
         m_vkBuffer( vkBuffer ),
-        m_vkDeviceMemory( vkDeviceMemory ),
+        m_memory( ::std::move( memory ) ),
         m_vkSize( vkSize ),
         m_sliced( 0U ),
         m_reserved( 0U ),
@@ -222,7 +232,7 @@ private:
 
         m_vkDevice = VK_NULL_HANDLE;
         m_vkBuffer = VK_NULL_HANDLE;
-        m_vkDeviceMemory = VK_NULL_HANDLE;
+        m_memory = MemoryRange( );
         m_vkSize = 0U;
         m_sliced = m_reserved = m_capacity = m_filled = m_alignedCount = 0U;
         m_number = 0U;
@@ -233,16 +243,15 @@ private:
         if (m_vkBuffer != VK_NULL_HANDLE){
             ::vkDestroyBuffer( m_vkDevice, m_vkBuffer, VK_NULL_HANDLE );
         }
-        if (m_vkDeviceMemory != VK_NULL_HANDLE){
-            ::vkFreeMemory( m_vkDevice, m_vkDeviceMemory, VK_NULL_HANDLE );
-            ::std::cout << "Deallocated memory for slice " << this->Number( ) << ".." << ::std::endl;
+        if (m_memory){
+            m_memory = MemoryRange( );
         }
         Reset( );
     }
 
     VkDevice m_vkDevice;
     VkBuffer m_vkBuffer;
-    VkDeviceMemory m_vkDeviceMemory;
+    MemoryRange m_memory;
     VkDeviceSize m_vkSize;
     size_type m_sliced, m_reserved, m_capacity, m_filled, m_alignedCount;
     number_type m_number;
@@ -256,13 +265,16 @@ public:
     typedef Slice<T> slice_type;
     typedef typename slice_type::number_type index_type;
 
-    Slices(VkDeviceSize vkSliceSize): m_vkPreferredSliceSize( vkSliceSize ), m_current( 0U ) { }
+    Slices(VkDeviceSize vkSliceSize): m_vkPreferredSliceSize( vkSliceSize ), m_current( 0U ), m_allocated( 0U ), m_cap( 0U ) { }
     Slices(): Slices( 0U ) { }
     Slices(Slices const&) = delete;
     Slices(Slices&& slices):
         m_vkPreferredSliceSize( slices.m_vkPreferredSliceSize ),
         m_current( slices.m_current ),
+        m_allocated( slices.m_allocated ),
+        m_cap( slices.m_cap ),
         m_container( ::std::move( slices.m_container ) ),
+        m_recycled( ::std::move( slices.m_recycled ) ),
         m_empty( ::std::move( slices.m_empty ) ) {
 
         slices.Reset( );
@@ -273,10 +285,14 @@ public:
 
         if (this != &slices){
             m_container.clear( );
+            m_recycled.clear( );
 
             m_vkPreferredSliceSize = slices.m_vkPreferredSliceSize;
             m_current = slices.m_current;
+            m_allocated = slices.m_allocated;
+            m_cap = slices.m_cap;
             m_container = ::std::move( slices.m_container );
+            m_recycled = ::std::move( slices.m_recycled );
             m_empty = ::std::move( slices.m_empty );
 
             slices.Reset( );
@@ -310,9 +326,47 @@ public:
         return slice;
     }
 
+    // Renumbers the current slice as given, so that it follows on from slices held elsewhere
+    // (e.g. by other devices), and those allocated after it from it; returns false if there
+    // isn't one, if anything has been reserved in it already, or if the number is taken
+    bool Renumber(index_type number) {
+
+        const auto found = m_container.find( m_current );
+        if ((found == m_container.end( )) || (found->second.Available( ) < found->second.Capacity( ))){
+            return false;
+        }
+        if (number == m_current){
+            return true;
+        }
+        if (m_container.count( number ) > 0U){
+            return false;
+        }
+
+        auto slice = ::std::move( found->second );
+        m_container.erase( found );
+        slice.m_number = number;
+        m_container.emplace( number, ::std::move( slice ) );
+        m_current = number;
+        return true;
+    }
+
+    // Caps the number of slices which will be allocated (or 0 for no cap)
+    void Cap(index_type cap) { m_cap = cap; }
+
+    // Takes back the given slice, once it is no longer needed, for reuse
+    void Recycle(slice_type&& slice) {
+
+        if (slice){
+            // Empty it, but keep the memory
+            slice.m_sliced = slice.m_reserved = slice.m_filled = 0U;
+            m_recycled.push_back( ::std::move( slice ) );
+        }
+    }
+
     // Allocates and returns a new slice of on-device memory from the
     // given device (GPU) which can hold some whole number of elements
-    // not smaller than a given minimum
+    // not smaller than a given minimum, reusing one which has been handed
+    // back, if any; returns an empty slice if at the cap
     slice_type& New(ComputeDevice& device) {
 
         // Look for an early out
@@ -320,6 +374,24 @@ public:
             return m_empty;
         }
 
+        // Prefer to reuse a slice which has been handed back
+        if (!m_recycled.empty( )){
+            const auto number = (m_current + 1);
+            auto emplaced = m_container.emplace( number, ::std::move( m_recycled.back( ) ) );
+            m_recycled.pop_back( );
+            if (emplaced.second){
+                m_current = number;
+                auto& slice = (emplaced.first)->second;
+                slice.m_number = number;
+                return slice;
+            }
+            return m_empty;
+        }
+        if ((m_cap > 0U) && (m_allocated >= m_cap)){
+            // Wait for one to be handed back
+            return m_empty;
+        }
+
         // Get the target slice size, adjusting for whole element size
         auto vkSliceSize = this->SliceSize( device );
         vkSliceSize = vkSliceSize - (vkSliceSize % sizeof( T ));
@@ -334,16 +406,16 @@ public:
         std::cout << "Looking for " << vkAllocationSize << " bytes of sliced memory.." << std::endl;
 
         // Iterate and try to allocate
-        VkDeviceMemory vkDeviceMemory = VK_NULL_HANDLE;
-        for (auto it = deviceMemoryBudgets.cbegin( ), end = deviceMemoryBudgets.cend( ); (vkDeviceMemory == VK_NULL_HANDLE) && (it != end); it++){
+        MemoryRange memory;
+        for (auto it = deviceMemoryBudgets.cbegin( ), end = deviceMemoryBudgets.cend( ); (!memory) && (it != end); it++){
             const auto& deviceMemoryBudget = *it;
             if (deviceMemoryBudget.vkMemoryBudget < vkAllocationSize){
                 // Nah, not interested
                 continue;
             }
-            vkDeviceMemory = device.Allocate( deviceMemoryBudget, vkAllocationSize );
+            memory = device.Allocate( deviceMemoryBudget, vkAllocationSize, vkMemoryRequirements.alignment );
         }
-        if (vkDeviceMemory != VK_NULL_HANDLE){
+        if (memory){
             const VkAllocationCallbacks *pAllocator = VK_NULL_HANDLE;
             auto vkDevice = *device;
 
@@ -362,7 +434,7 @@ public:
             );
             if (vkResult == VK_SUCCESS){
                 // Bind it to the memory
-                vkResult = ::vkBindBufferMemory( vkDevice, vkBuffer, vkDeviceMemory, 0U );
+                vkResult = ::vkBindBufferMemory( vkDevice, vkBuffer, *memory, memory.Offset( ) );
             }else{
                 ::vkDestroyBuffer( vkDevice, vkBuffer, pAllocator );
             }
@@ -371,14 +443,14 @@ public:
                 const auto number = (m_current + 1); 
                 auto emplaced = m_container.emplace(
                     number,
-                    slice_type( number, vkDevice, vkBuffer, vkDeviceMemory, vkSliceSize )
+                    slice_type( number, vkDevice, vkBuffer, ::std::move( memory ), vkSliceSize )
                 );
                 if (emplaced.second){
                     m_current = number;
+                    m_allocated++;
                     return (emplaced.first)->second;
                 }
             }
-            device.Free( vkDeviceMemory );
         }
         return m_empty;
     }
@@ -457,6 +529,11 @@ public:
         return !m_container.empty( );
     }
 
+    // Returns the number of the most recently-allocated slice, if any
+    index_type Newest(void) const {
+        return m_current;
+    }
+
     slice_type const& Any(void) const {
         return Has( )
             ? m_container.begin( )->second
@@ -466,13 +543,15 @@ public:
 private:
     void Reset(void) {
         m_vkPreferredSliceSize = 0U;
-        m_current = 0U;
+        m_current = m_allocated = m_cap = 0U;
         m_container.clear( );
+        m_recycled.clear( );
     }
 
     VkDeviceSize m_vkPreferredSliceSize;
-    index_type m_current;
+    index_type m_current, m_allocated, m_cap;
     ::std::unordered_map<index_type, slice_type> m_container;
+    ::std::vector<slice_type> m_recycled;
     slice_type m_empty;
 
     static const VkMemoryPropertyFlags c_vkMemoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -6,6 +6,7 @@
 
 // C Standard Library Headers
 #include <stdio.h>
+#include <stdlib.h>
 
 // C++ Standard Headers
 #include <iostream>
@@ -13,10 +14,13 @@
 #include <cstring>
 #include <vector>
 #include <string>
+#include <deque>
+#include <memory>
 
 // Local Project Headers
 #include "Debug.h"
 #include "Inputs.h"
+#include "Readers.h"
 #include "StopWatch.h"
 #include "SHA-256vk.h"
 #include "SHA-256plus.h"
@@ -25,38 +29,155 @@
 //
 
 // Gives the main loop for the application
-int run(vkmr::ISha256D& sha256D) {
+int run(vkmr::ISha256D& sha256D, const std::vector<std::string>& paths, const vkmr::Input::Format& format) {
 
     using std::cout;
     using std::endl;
 
-    // Loop over the inputs
-    vkmr::Input input( stdin );
+    // Read the inputs on other threads, from the given files in turn (if any) or else
+    // from stdin, a file or two ahead of adding them (on this thread) to the tree
+    const size_t readAhead = 2U;
+    const size_t n = paths.empty( ) ? 1U : paths.size( );
+    std::deque<std::unique_ptr<vkmr::Reader>> readers;
+    size_t started = 0U;
+
+    const bool hashed = (format.framing == vkmr::Input::Hashed);
     size_t size = 0U, count = 0U;
+    vkmr::Reader::Stats stats = { 0.0, 0.0, 0.0, 0.0 };
     StopWatch sw;
     sw.Start( );
-    while (input.Has( )){
-        const auto arg = input.Get( );
-        if (arg.empty( )){
-            std::cerr << "Read an empty string?" << endl;
-            continue;
+    bool ok = true;
+    for (size_t i = 0U; ok && (i < n); ++i){
+        while ((started < n) && (started < (i + readAhead))){
+            vkmr::Input input = paths.empty( ) ? vkmr::Input( stdin, false, format ) : vkmr::Input( paths[started], format );
+            if (!input){
+                std::cerr << "Failed to open " << paths[started] << "; aborting." << endl;
+                return 1;
+            }
+            readers.emplace_back( new vkmr::Reader( std::move( input ) ) );
+            started++;
+        }
+
+        auto& reader = *(readers.front( ));
+        vkmr::Records records;
+        while (ok && reader.Next( records )){
+            for (auto it = records.records.cbegin( ), end = records.records.cend( ); it != end; ++it){
+                ok = hashed ? sha256D.AddLeaf( it->data ) : sha256D.Add( it->data, it->size );
+                if (!ok){
+                    break;
+                }
+                size += it->size;
+                count++;
+            }
         }
-        bool ok = sha256D.Add( arg );
-        if (!ok){
-            break;
+        if (reader.Truncated( )){
+            std::cerr << "Input ended part-way through a record; aborting." << endl;
+            return 1;
         }
 
-        size += arg.size( );
-        count++;
+        const auto s = reader.GetStats( );
+        stats.reading += s.reading;
+        stats.stalled += s.stalled;
+        stats.starved += s.starved;
+        stats.occupancy += s.occupancy / n;
+        readers.pop_front( );
     }
     if (count > 0U){
         const auto root = sha256D.Root( );
         const auto elapsed = sw.Elapsed( );
         cout << sha256D.Name( ) << ": computed root (of " << count << " item(s), " << size << " byte(s)) => " << root << " in " << elapsed << endl;
+
+        // Report how busy each stage was, i.e. whichever is seldom waiting on the other is the bottleneck
+        cout << "Reading: " << (stats.reading - stats.stalled) << "ms busy, " << stats.stalled << "ms waiting on adding; ";
+        cout << "Adding: " << (elapsed - stats.starved) << "ms busy, " << stats.starved << "ms waiting on reading; ";
+        cout << "ring " << static_cast<int>( stats.occupancy * 100.0 ) << "% full on average" << endl;
     }
     return 0;
 }
 
+// Parses the framing of the input from the given argument (i.e. "--format=<framing>"),
+// returning false if it isn't one
+static bool parse_format(const std::string& arg, vkmr::Input::Format& format) {
+
+    using vkmr::Input;
+
+    const std::string prefix( "--format=" );
+    if (arg.compare( 0, prefix.size( ), prefix ) != 0){
+        return false;
+    }
+    const auto value = arg.substr( prefix.size( ) );
+    if (value == "lines"){
+        format = Input::Format( Input::Lines );
+    }else if (value == "u32"){
+        format = Input::Format( Input::Prefixed32 );
+    }else if (value == "u64"){
+        format = Input::Format( Input::Prefixed64 );
+    }else if (value == "hashed"){
+        format = Input::Format( Input::Hashed );
+    }else if (value.compare( 0, 6, "fixed:" ) == 0){
+        const auto width = std::strtoul( value.c_str( ) + 6, NULL, 10 );
+        if (width == 0U){
+            return false;
+        }
+        format = Input::Format( Input::Fixed, width );
+    }else{
+        return false;
+    }
+    return true;
+}
+
+// Parses whether to upload inputs to the (Vulkan) device from the given argument
+// (i.e. "--upload=auto|on|off"), returning false if it isn't that
+static bool parse_upload(const std::string& arg, vkmr::VkSha256D::Upload& upload) {
+
+    using vkmr::VkSha256D;
+
+    const std::string prefix( "--upload=" );
+    if (arg.compare( 0, prefix.size( ), prefix ) != 0){
+        return false;
+    }
+    const auto value = arg.substr( prefix.size( ) );
+    if (value == "auto"){
+        upload = VkSha256D::UploadAuto;
+    }else if (value == "on"){
+        upload = VkSha256D::UploadOn;
+    }else if (value == "off"){
+        upload = VkSha256D::UploadOff;
+    }else{
+        return false;
+    }
+    return true;
+}
+
+// Parses how to hand out the slices of the tree across all of the (Vulkan) devices from the given
+// argument (i.e. "--shard=round-robin|throughput"), returning false if it isn't that
+static bool parse_shard(const std::string& arg, vkmr::VkSha256D::Sharding& sharding) {
+
+    using vkmr::VkSha256D;
+
+    const std::string prefix( "--shard=" );
+    if (arg.compare( 0, prefix.size( ), prefix ) != 0){
+        return false;
+    }
+    const auto value = arg.substr( prefix.size( ) );
+    if (value == "round-robin"){
+        sharding = VkSha256D::ShardRoundRobin;
+    }else if (value == "throughput"){
+        sharding = VkSha256D::ShardThroughput;
+    }else{
+        return false;
+    }
+    return true;
+}
+
+// Returns true if the given name is that of the given instance, with or without the
+// parenthesised suffix (e.g. giving the instruction set used by the CPU)
+static bool is_named(const vkmr::ISha256D& sha256D, const std::string& name) {
+
+    const auto& full = sha256D.Name( );
+    return (full == name) || (full.compare( 0, full.find( " (" ), name ) == 0);
+}
+
 // Gives the entry-point for the application
 int main(int argc, const char* argv[]) {
 
@@ -64,18 +185,45 @@ int main(int argc, const char* argv[]) {
     using std::endl;
 
     vkmr::CpuSha256D mrc;
+    vkmr::CpuMtSha256D mrcmt;
     std::string arg1;
+    std::vector<std::string> paths;
+    vkmr::Input::Format format;
+    vkmr::VkSha256D::Upload upload = vkmr::VkSha256D::UploadAuto;
+    vkmr::VkSha256D::Sharding sharding = vkmr::VkSha256D::ShardRoundRobin;
+    bool hybrid = false, shardingGiven = false, autotune = false;
     vkmr::VkSha256D instances;
     if (argc > 1){
         arg1.append( argv[1] );
+        for (int i = 2; i < argc; ++i){
+            const std::string arg( argv[i] );
+            if (arg.compare( 0, 2, "--" ) != 0){
+                paths.push_back( arg );
+            }else if (arg == "--hybrid"){
+                hybrid = true;
+            }else if (arg == "--autotune"){
+                autotune = true;
+            }else if (parse_shard( arg, sharding )){
+                shardingGiven = true;
+            }else if (!parse_format( arg, format ) && !parse_upload( arg, upload )){
+                std::cerr << "Unrecognised option: " << arg << "; aborting." << endl;
+                return 1;
+            }
+        }
+
+        // Unless told otherwise, split the slices between the CPU and the GPU(s) by how fast each gets through them
+        if (hybrid && !shardingGiven){
+            sharding = vkmr::VkSha256D::ShardThroughput;
+        }
     }else{
         auto available = instances.Available( );
+        available.insert( available.begin( ), mrcmt.Name( ) );
         available.insert( available.begin( ), mrc.Name( ) );
         if (available.size( ) == 1){
             // Pick the only one available by default
             arg1 = available.front( );
         }else{
-            std::cerr << "Usage: " << std::string( argv[0] ) << " <name of compute device>" << endl;
+            std::cerr << "Usage: " << std::string( argv[0] ) << " <name of compute device> [--format=lines|u32|u64|fixed:<size>|hashed] [--upload=auto|on|off] [--shard=round-robin|throughput] [--hybrid] [--autotune] [<path of input file> ...]" << endl;
             std::cerr << "Available: " << endl;
             for (auto it = available.cbegin( ), end = available.cend( ); it != end; ++it){
                 std::cerr << "* " << *it << endl;
@@ -85,12 +233,27 @@ int main(int argc, const char* argv[]) {
     }
     cout << "Initializing for: " << arg1 << endl;
 
+    // Benchmark the choices for the named device (or all of them), in place of computing any root
+    if (autotune){
+        if (!instances.Has( arg1 ) && (arg1 != vkmr::VkSha256D::c_szAll)){
+            std::cerr << "Only Vulkan devices can be tuned; aborting." << endl;
+            return 1;
+        }
+        return instances.Tune( arg1, upload ) ? 0 : 1;
+    }
+
     // Look for the named instance
-    if (instances.Has( arg1 )){
-        auto vkSha256D = instances.Get( arg1 );
-        return run( vkSha256D );
-    }else if (mrc.Name( ) == arg1){
-        return run( mrc );
+    const auto all = (arg1 == vkmr::VkSha256D::c_szAll) && (instances.Available( ).size( ) > 1U);
+    if (all || (hybrid && instances.Has( arg1 ))){
+        auto sharded = instances.GetSharded( arg1, upload, sharding, hybrid );
+        return run( sharded, paths, format );
+    }else if (instances.Has( arg1 )){
+        auto vkSha256D = instances.Get( arg1, upload );
+        return run( vkSha256D, paths, format );
+    }else if (is_named( mrc, arg1 )){
+        return run( mrc, paths, format );
+    }else if (is_named( mrcmt, arg1 )){
+        return run( mrcmt, paths, format );
     }
     std::cerr << "No device selected; aborting." << endl;
     return 1;
@@ -0,0 +1,139 @@
+// Workers.cpp: defines the types, functions and classes for running tasks on a pool of CPU threads
+//
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <algorithm>
+#include <utility>
+
+// Declarations
+#include "Workers.h"
+
+namespace vkmr {
+
+// Classes
+//
+
+Workers::Workers(unsigned count):
+    m_busy( 0U ),
+    m_stopping( false ) {
+
+    if (count == 0U){
+        count = DefaultCount( );
+    }
+    m_threads.reserve( count );
+    for (unsigned u = 0U; u < count; ++u){
+        m_threads.push_back( ::std::thread( &Workers::Run, this ) );
+    }
+}
+
+Workers::~Workers(void) {
+
+    {
+        ::std::lock_guard<::std::mutex> lock( m_mutex );
+        m_stopping = true;
+    }
+    m_queued.notify_all( );
+    for (auto it = m_threads.begin( ), end = m_threads.end( ); it != end; ++it){
+        if (it->joinable( )){
+            it->join( );
+        }
+    }
+}
+
+void Workers::Submit(task_type&& task) {
+
+    {
+        ::std::lock_guard<::std::mutex> lock( m_mutex );
+        m_tasks.push_back( ::std::move( task ) );
+    }
+    m_queued.notify_one( );
+}
+
+void Workers::ForEach(size_t count, size_t grain, const range_type& fn) {
+
+    // Look for an early out
+    if (count == 0U){
+        return;
+    }
+
+    // Split the range into (up to) one chunk per thread, plus one for the
+    // calling thread, but never into chunks smaller than the given grain
+    const size_t threads = m_threads.size( ) + 1U;
+    size_t chunk = (count / threads) + (((count % threads) == 0U) ? 0U : 1U);
+    chunk = ::std::max( chunk, ::std::max( grain, static_cast<size_t>( 1U ) ) );
+    if (chunk >= count){
+        // Not worth the hand-off
+        fn( 0U, count );
+        return;
+    }
+
+    // Hand off all but the first chunk to the pool..
+    ::std::mutex mutex;
+    ::std::condition_variable done;
+    size_t remaining = 0U;
+    for (size_t begin = chunk; begin < count; begin += chunk){
+        const auto end = ::std::min( count, begin + chunk );
+        {
+            ::std::lock_guard<::std::mutex> lock( mutex );
+            remaining++;
+        }
+        this->Submit( [&, begin, end]() {
+            fn( begin, end );
+
+            ::std::lock_guard<::std::mutex> lock( mutex );
+            if (--remaining == 0U){
+                done.notify_one( );
+            }
+        } );
+    }
+
+    // .. do the first one ourselves, and then wait on the rest
+    fn( 0U, chunk );
+    ::std::unique_lock<::std::mutex> lock( mutex );
+    done.wait( lock, [&remaining]() { return (remaining == 0U); } );
+}
+
+void Workers::WaitFor(void) {
+
+    ::std::unique_lock<::std::mutex> lock( m_mutex );
+    m_finished.wait( lock, [this]() {
+        return m_tasks.empty( ) && (m_busy == 0U);
+    } );
+}
+
+unsigned Workers::DefaultCount(void) {
+
+    const auto count = ::std::thread::hardware_concurrency( );
+    return (count == 0U) ? 1U : count;
+}
+
+void Workers::Run(void) {
+
+    for (::std::unique_lock<::std::mutex> lock( m_mutex ); ; ){
+        m_queued.wait( lock, [this]() {
+            return m_stopping || !m_tasks.empty( );
+        } );
+        if (m_tasks.empty( )){
+            // We must be stopping
+            break;
+        }
+
+        // Take the task at the front of the queue, and run it unlocked
+        auto task = ::std::move( m_tasks.front( ) );
+        m_tasks.pop_front( );
+        m_busy++;
+        lock.unlock( );
+        task( );
+        lock.lock( );
+
+        // Let any waiters know if that was the last of them
+        if ((--m_busy == 0U) && m_tasks.empty( )){
+            m_finished.notify_all( );
+        }
+    }
+}
+
+} // namespace vkmr
@@ -0,0 +1,68 @@
+// Workers.h: declares the types, functions and classes for running tasks on a pool of CPU threads
+//
+
+#ifndef __VKMR_WORKERS_H__
+#define __VKMR_WORKERS_H__
+
+// Includes
+//
+
+// C++ Standard Library Headers
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace vkmr {
+
+// Class(es)
+//
+
+// Encapsulates a fixed-size pool of worker threads
+class Workers {
+public:
+    typedef ::std::function<void(void)> task_type;
+    typedef ::std::function<void(size_t, size_t)> range_type;
+
+    // Creates a pool with the given number of threads, or
+    // one per hardware thread if zero
+    Workers(unsigned count = 0U);
+    Workers(Workers const&) = delete;
+    ~Workers(void);
+
+    Workers& operator=(Workers const&) = delete;
+
+    // Returns the number of threads in the pool
+    size_t Count(void) const { return m_threads.size( ); }
+
+    // Queues the given task for execution on the next available thread
+    void Submit(task_type&&);
+
+    // Splits [0, count) into chunks of at least the given size, applies the
+    // given function to each chunk on the pool (and the calling thread) and
+    // waits for them all to finish
+    void ForEach(size_t count, size_t grain, const range_type&);
+
+    // Synchronously waits for all queued tasks to finish
+    void WaitFor(void);
+
+    // Returns the default number of threads for a pool
+    static unsigned DefaultCount(void);
+
+private:
+    void Run(void);
+
+    ::std::vector<::std::thread> m_threads;
+    ::std::deque<task_type> m_tasks;
+
+    ::std::mutex m_mutex;
+    ::std::condition_variable m_queued, m_finished;
+    size_t m_busy;
+    bool m_stopping;
+};
+
+} // namespace vkmr
+
+#endif // __VKMR_WORKERS_H__